@@ -0,0 +1,131 @@
+#ifndef APU_HEADER
+#define APU_HEADER
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "spsc.h"
+
+/* sound registers */
+#define NR10 0xFF10      // channel 1 sweep
+#define NR11 0xFF11      // channel 1 duty, length
+#define NR12 0xFF12      // channel 1 envelope
+#define NR13 0xFF13      // channel 1 frequency low
+#define NR14 0xFF14      // channel 1 trigger, length enable, frequency high
+#define NR21 0xFF16      // channel 2 duty, length
+#define NR22 0xFF17      // channel 2 envelope
+#define NR23 0xFF18      // channel 2 frequency low
+#define NR24 0xFF19      // channel 2 trigger, length enable, frequency high
+#define NR30 0xFF1A      // channel 3 DAC enable
+#define NR31 0xFF1B      // channel 3 length
+#define NR32 0xFF1C      // channel 3 output level
+#define NR33 0xFF1D      // channel 3 frequency low
+#define NR34 0xFF1E      // channel 3 trigger, length enable, frequency high
+#define NR41 0xFF20      // channel 4 length
+#define NR42 0xFF21      // channel 4 envelope
+#define NR43 0xFF22      // channel 4 frequency, LFSR width
+#define NR44 0xFF23      // channel 4 trigger, length enable
+#define NR50 0xFF24      // master volume
+#define NR51 0xFF25      // panning
+#define NR52 0xFF26      // power, channel status
+#define WAVE_RAM 0xFF30  // 16 bytes of 4-bit wave samples
+
+#define APU_REGS_SIZE 0x30  // NR10 through the end of wave RAM
+
+/* output: signed 16-bit stereo at exactly one sample every 64 T-cycles. the host
+resamples to whatever its device runs at */
+#define APU_CYCLES_PER_SAMPLE 64
+#define APU_SAMPLE_RATE (4194304 / APU_CYCLES_PER_SAMPLE)  // 65536 Hz
+
+#define APU_KERNEL_TAPS 16    // length of the band-limited step
+#define APU_KERNEL_PHASES 32  // sub-sample step positions (every 2 T-cycles)
+#define APU_CHUNK_SAMPLES 512  // most samples held before they go to the host
+#define APU_BUFFER_SIZE (APU_CHUNK_SAMPLES + APU_KERNEL_TAPS + 1)
+
+struct CPU;
+
+typedef struct apu_sample_t {
+    int16_t left;
+    int16_t right;
+} apu_sample_t;
+
+/* one sound channel. the square channels, wave and noise share the layout and
+only use the fields they need */
+typedef struct apu_channel_t {
+    bool enabled;        // playing (NR52 status bit)
+    bool dac;            // DAC on, otherwise the channel can't be enabled
+    bool length_enable;  // length counter stops the channel
+    uint16_t length;     // length counter (64, or 256 for the wave channel)
+
+    uint8_t volume;      // envelope volume, 0-15
+    uint8_t env_period;  // envelope period latched at trigger (0 = off)
+    uint8_t env_timer;
+    bool env_up;
+
+    uint16_t freq;       // 11-bit frequency (squares and wave)
+    uint8_t pos;         // duty step (0-7) or wave sample (0-31)
+    uint16_t lfsr;       // noise shift register
+
+    uint64_t next_time;  // cycle of the next waveform step
+    int16_t out_left;    // what the channel currently contributes to the mix
+    int16_t out_right;
+} apu_channel_t;
+
+/* output side of the synthesizer. not machine state: it is left alone by
+snapshots and re-anchored after a restore */
+typedef struct apu_output_t {
+    SpscQueue *queue;  // apu_sample_t ring to the host (NULL = discard)
+    bool muted;        // synthesize but don't push (hidden run-ahead frames)
+
+    uint64_t start;                      // cycle of buffer[][0]
+    int32_t buffer[2][APU_BUFFER_SIZE];  // left/right amplitude steps, Q15
+    int32_t level[2];                    // integrated output before start, Q15
+    int32_t dc[2];                       // high-pass filter state
+} apu_output_t;
+
+/* the APU is event driven: nothing runs per T-cycle. the channels are caught up
+to the CPU only when it touches a sound register and on every frame sequencer
+tick (512 Hz, from the falling edge of DIV bit 4), and even then the loop only
+visits the points where a channel's waveform steps. every change in amplitude
+is drawn into the output as a band-limited step, so a held note costs nothing
+and there is no aliasing from sampling the channels at 65536 Hz */
+typedef struct APU {
+    struct CPU *cpu;  // pointer to the CPU (the cycle counter is the APU clock)
+
+    uint8_t regs[APU_REGS_SIZE];  // NR10-NR52 as written, then wave RAM
+    bool power;                   // NR52 bit 7
+    uint8_t sequencer_step;       // frame sequencer step, 0-7
+
+    apu_channel_t ch[4];  // square 1, square 2, wave, noise
+
+    /* channel 1 frequency sweep */
+    uint8_t sweep_timer;
+    bool sweep_enabled;
+    uint16_t sweep_shadow;  // shadow frequency
+
+    uint64_t time;  // cycle the channels have been run up to
+
+    apu_output_t output;  // must stay last, everything before it is machine state
+} APU;
+
+void apu_init(APU *apu, struct CPU *cpu);
+void apu_reset(APU *apu);
+
+/* mmu helpers (0xFF10-0xFF3F) */
+uint8_t apu_read(APU *apu, uint16_t addr);
+void apu_write(APU *apu, uint16_t addr, uint8_t value);
+
+// DIV bit 4 fell: clock the frame sequencer and send finished samples to the host
+void apu_div_event(APU *apu);
+
+// run the channels up to the current CPU cycle
+void apu_sync(APU *apu);
+
+// where the samples go (NULL discards them)
+void apu_set_output(APU *apu, SpscQueue *queue);
+
+// the machine state was replaced (snapshot, rewind, state load): drop the pending
+// output and carry on from the restored time and channel levels
+void apu_output_restart(APU *apu);
+
+#endif
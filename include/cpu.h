@@ -2,6 +2,7 @@
 #define CPU_HEADER
 
 #include <stdarg.h>
+#include <stdbool.h>
 #include <stdint.h>
 #include <stdio.h>
 #include <stdlib.h>
@@ -13,15 +14,35 @@
 
 extern FILE *cpu_log;
 
+struct CPU;
 struct MMU;
 struct Timer;
 struct PPU;
 
+/* instruction trace hook: called with the state before every instruction, after
+any interrupt dispatch (which isn't an instruction), like cpu_log. off when NULL */
+typedef void (*cpu_trace_fn)(void *user, const struct CPU *cpu);
+extern cpu_trace_fn cpu_trace;
+extern void *cpu_trace_user;
+
+/* take the straightforward reference path wherever the core has a faster
+equivalent (e.g. HALT fast-forward), so gb-lockstep can check one against the
+other. the machine state must come out the same either way */
+extern bool gb_reference;
+
 typedef struct CPU {
     struct MMU *mmu;     /* pointer to the MMU */
     struct Timer *timer; /* pointer to the timer */
     struct PPU *ppu;     /* pointer to the PPU */
 
+    /* host settings, left out of the state hash with the pointers and kept when a
+    snapshot or save state is restored. where a HALT stretch stops fast-forwarding
+    (gb_run's budget), and whether to run on the M-cycle accurate tier (see
+    opcodes.h), 0 or 1: slower, for titles and tests that depend on when within an
+    instruction a read or write happens */
+    uint64_t halt_until;
+    int accurate;
+
     // a: accumulator; f: flags
     union {
         struct {
@@ -56,6 +77,7 @@ typedef struct CPU {
 
     // cpu cycle counter
     uint64_t cycles;
+    int pending; /* cycles the running instruction has taken, ticked when it ends */
 
     // interrupt enable register
     int ime;       /* 0 or 1, current state (READ ONLY) */
@@ -88,6 +110,12 @@ typedef struct CPU {
     /* OAM flag (interrupts not allowed) */
     int dma_flag; /* 0 or 1, current state */
 
+    /* 0 or 1: cpu_step has something to do before the next instruction, i.e. the
+    CPU is halted, or IME is set and an enabled interrupt is flagged. everything
+    that changes halt, ime, ifr or ier keeps it up to date (cpu_update_interrupts),
+    so the instruction loop looks at this one field instead */
+    int interrupt_check;
+
     // last opcode executed (debugging)
     uint8_t last_opcode;
 
@@ -98,4 +126,28 @@ void tick(CPU *cpu, int cycles);
 void cpu_init(CPU *cpu, struct MMU *mmu, struct Timer *timer, struct PPU *ppu);
 void cpu_step(CPU *cpu);
 
+// recompute interrupt_check, after writing halt, ime, ifr or ier directly
+void cpu_update_interrupts(CPU *cpu);
+
+// flag interrupts (IF bits), for the components that raise them
+void cpu_request_interrupt(CPU *cpu, uint8_t bits);
+
+/* the end of every instruction, in cpu_step and in compiled code (recomp.h): tick
+the cycles it took, then pass on the signal to IME from an EI before it
+(see https://gbdev.io/pandocs/Interrupts.html) */
+static inline void cpu_retire(CPU *cpu) {
+    if (cpu->pending) {
+        tick(cpu, cpu->pending);
+        cpu->pending = 0;
+    }
+
+    if (cpu->ime_delay) {
+        cpu->ime_delay--; /* 2 → 1   (during instr N+1 fetch) */
+        if (cpu->ime_delay == 0) {
+            cpu->ime = 1; /* becomes 1 *after* instr N+1 exec */
+            cpu_update_interrupts(cpu);
+        }
+    }
+}
+
 #endif
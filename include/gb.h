@@ -0,0 +1,57 @@
+#ifndef GB_HEADER
+#define GB_HEADER
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "apu.h"
+#include "cpu.h"
+#include "joyp.h"
+#include "mmu.h"
+#include "ppu.h"
+#include "serial.h"
+#include "timer.h"
+
+/* the whole machine in one block of memory. the components still talk to each
+other through their pointers, which gb_init (and gb_link) wire up to point
+inside this struct */
+typedef struct GB {
+    CPU cpu;
+    MMU mmu;
+    Timer timer;
+    PPU ppu;
+    Joypad joypad;
+    APU apu;
+    Serial serial;
+
+    /* host settings for gb_run, not machine state */
+    int breakpoint;         // pc to stop in front of, -1 (the default) for none
+    bool serial_stop;       // also stop when a serial transfer completes
+    struct Recomp *recomp;  // compiled ROM code to run where it can (recomp.h), or NULL
+} GB;
+
+/* why gb_run returned */
+typedef enum gb_stop_t {
+    GB_STOP_FRAME,       // the PPU completed a frame
+    GB_STOP_BUDGET,      // the cycle budget ran out
+    GB_STOP_BREAKPOINT,  // the next instruction is the one at gb->breakpoint
+    GB_STOP_SERIAL,      // a serial transfer completed (with gb->serial_stop set)
+} gb_stop_t;
+
+// initialize and reset every component of the machine
+void gb_init(GB *gb);
+
+// point every component at its siblings inside gb (needed after copying state in)
+void gb_link(GB *gb);
+
+/* run the CPU (which ticks every other component) for up to cycles T-cycles, and
+say what stopped it. instructions only start before the budget runs out, and a
+HALT stretch ends at it too. at least one instruction runs, so calling again
+after a breakpoint moves on past it. with gb->recomp set, stretches of ROM code
+run compiled, stopping at the same points */
+gb_stop_t gb_run(GB *gb, uint64_t cycles);
+
+// gb_run with no budget: until the PPU completes a frame (or a breakpoint or serial stop)
+gb_stop_t gb_run_frame(GB *gb);
+
+#endif
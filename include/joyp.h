@@ -38,6 +38,9 @@ void joypad_init(Joypad *joypad, struct MMU *mmu, struct CPU *cpu);
 void joypad_reset(Joypad *joypad);
 uint8_t joypad_read(Joypad *joypad);
 void joypad_write(Joypad *joypad, uint8_t value);
-void joypad_update(Joypad *joypad);
+
+// set the pressed buttons (JOYP_A..JOYP_START) and directions (JOYP_RIGHT..JOYP_DOWN),
+// active low like the register. the host polls its own input and calls this once per frame
+void joypad_set(Joypad *joypad, uint8_t buttons, uint8_t dpad);
 
 #endif
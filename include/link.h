@@ -0,0 +1,71 @@
+#ifndef LINK_HEADER
+#define LINK_HEADER
+
+#include <pthread.h>
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "gb.h"
+
+/* in-process link cable between two machines, each run on its own thread.
+
+the two sides are not kept in lockstep. every byte that crosses the cable is
+stamped with the sender's cycle counter and takes effect on the other side
+exactly LINK_LATENCY cycles later, in the receiver's own emulated time, and
+neither side may run more than LINK_LATENCY cycles past the other. so a side
+never reaches a point in time at which a message could still be on its way,
+and what happens is decided by emulated cycles alone: however the threads get
+scheduled, an exchange plays out the same, bit for bit.
+
+a transfer on the internal clock goes out as soon as SC is written. the other
+side takes it LINK_LATENCY cycles (4 bits) in, shifts the rest on its own bit
+clock and sends its byte back, which arrives another LINK_LATENCY later, just as
+the 8 bits would be through on real hardware (give or take one bit).
+
+savestates, rewind and run-ahead replace a machine's past behind the cable's
+back, they are not meant to be used on a linked machine */
+
+#define LINK_LATENCY 2048  // cycles, half a byte at 8192 Hz
+#define LINK_QUANTUM 1024  // most cycles run between two looks at the other side
+#define LINK_INBOX_SIZE 1024  // more than fit in the window even if SC is hammered
+
+typedef struct link_message_t {
+    uint64_t time;  // receiver cycle it takes effect at
+    uint8_t byte;
+    bool reply;  // answer to a transfer, otherwise a new one
+} link_message_t;
+
+typedef struct link_port_t {
+    GB *gb;
+    struct LinkCable *cable;
+    int side;
+
+    uint64_t time;  // cycle this side has run up to
+    bool closed;    // this side stopped running
+
+    link_message_t inbox[LINK_INBOX_SIZE];  // ring, in time order
+    uint32_t head, count;
+} link_port_t;
+
+typedef struct LinkCable {
+    pthread_mutex_t lock;
+    pthread_cond_t progress;  // a side moved forward or closed
+    link_port_t port[2];
+} LinkCable;
+
+// plug the serial ports of a and b together. returns false if the lock can't be made
+bool link_init(LinkCable *link, GB *a, GB *b);
+void link_free(LinkCable *link);
+
+// gb_run_frame for one side (0 = a, 1 = b), to be called from that side's thread.
+// waits whenever it gets too far ahead of the other side
+void link_run_frame(LinkCable *link, int side);
+
+// run one side for at least the given number of cycles (headless use)
+void link_run_cycles(LinkCable *link, int side, uint64_t cycles);
+
+// this side won't run again: the other one stops waiting for it and sees a cable
+// with nothing on the end
+void link_close(LinkCable *link, int side);
+
+#endif
@@ -0,0 +1,24 @@
+#ifndef LZ_HEADER
+#define LZ_HEADER
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+/* tiny LZ77 block codec used for save states. the format is a sequence of
+- token byte: high nibble = literal count, low nibble = match length - 4
+  (15 means "more length bytes follow", each adding up to 255)
+- literals
+- 16bit little-endian match offset (absent after the final literals)
+emulator memory is mostly zeros and repeated tiles, so this is plenty */
+
+// worst case compressed size for n input bytes
+size_t lz_compress_bound(size_t n);
+
+// compress src into dst, returns the compressed size or 0 if it does not fit in cap
+size_t lz_compress(const uint8_t *src, size_t n, uint8_t *dst, size_t cap);
+
+// decompress exactly out_n bytes into dst. returns false on corrupt input
+bool lz_decompress(const uint8_t *src, size_t n, uint8_t *dst, size_t out_n);
+
+#endif
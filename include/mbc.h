@@ -91,6 +91,7 @@ void mbc_write_control(MBC *mbc, uint16_t addr, uint8_t value);
 void mbc_write_ram(MBC *mbc, struct MMU *mmu, uint16_t addr, uint8_t value);
 
 /* helper functions */
+uint32_t mbc_rom_offset(MBC *mbc, uint16_t addr);  // where in the ROM image addr reads right now
 uint8_t mbc_get_current_rom_bank(MBC *mbc);
 uint8_t mbc_get_current_ram_bank(MBC *mbc);
 void mbc_update_rtc(MBC *mbc);
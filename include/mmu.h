@@ -2,6 +2,7 @@
 #define MMU_HEADER
 
 #include <stdbool.h>
+#include <stddef.h>
 #include <stdint.h>
 
 #include "mbc.h"
@@ -24,16 +25,37 @@
 #define BOOT 0xFF50  // boot ROM enable (write 1 to disable boot ROM)
 #define IE 0xFFFF    // IE register
 
+/* dirty page tracking. writable memory is split into 256-byte pages, numbered
+across the regions below. consumers (rewind, state hashing) each own a bit in
+dirty_mask: mmu_write sets the consumer bits of every page it touches and the
+consumer clears its own bit once it has looked at the page. with no consumers
+the only cost is one predictable branch per write */
+#define MMU_PAGE_SHIFT 8
+#define MMU_PAGE_SIZE (1 << MMU_PAGE_SHIFT)
+#define MMU_PAGE_VRAM 0   // 32 pages
+#define MMU_PAGE_WRAM 32  // 32 pages
+#define MMU_PAGE_OAM 64   // 1 page (160 bytes)
+#define MMU_PAGE_HRAM 65  // 1 page (127 bytes)
+#define MMU_PAGE_ERAM 66  // external RAM, up to 128 pages (32KB of cartridge RAM)
+#define MMU_PAGE_COUNT (MMU_PAGE_ERAM + 128)
+
+#define MMU_DIRTY_REWIND 0x01  // consumer bit of the rewind buffer
+#define MMU_DIRTY_HASH 0x02    // consumer bit of the incremental state hash (statehash.c)
+
 struct CPU;
 struct Timer;
 struct PPU;
 struct Joypad;
+struct APU;
+struct Serial;
 
 typedef struct MMU {
     struct CPU *cpu;        // pointer to the CPU
     struct Timer *timer;    // pointer to the timer
     struct PPU *ppu;        // pointer to the PPU
     struct Joypad *joypad;  // pointer to the joypad
+    struct APU *apu;        // pointer to the APU
+    struct Serial *serial;  // pointer to the serial port
 
     /* cartridge data */
     uint8_t *cartridge_rom;       // dynamically allocated ROM data
@@ -72,8 +94,24 @@ typedef struct MMU {
     /* high ram */
     uint8_t hram[0x007F];  // FF80h - FFFFh
 
+    /* dirty page tracking */
+    uint8_t dirty_mask;              // consumers currently tracking writes (0 = off)
+    uint8_t dirty[MMU_PAGE_COUNT];   // per page: consumers that haven't seen the last write
+
+    /* incremental state hash, kept by gb_state_hash (see statehash.h) */
+    uint64_t page_hash[MMU_PAGE_COUNT];  // hash of each page as of its last refresh
+    uint64_t memory_hash;                // all of page_hash[] xored together
+
+    bool ly_stub;  // LY always reads 0x90, as gameboy-doctor's truth logs expect
+
 } MMU;
 
+/* mark a page as written for every consumer that is tracking */
+static inline void mmu_mark_dirty(MMU *mmu, int page) {
+    if (mmu->dirty_mask)
+        mmu->dirty[page] |= mmu->dirty_mask;
+}
+
 // initialize and reset the MMU
 void mmu_init(MMU *mmu, struct CPU *cpu, struct Timer *timer, struct PPU *ppu,
               struct Joypad *joypad);
@@ -88,10 +126,28 @@ uint8_t mmu_read(MMU *mmu, uint16_t addr);
 // read a 16bit value from the memory bus
 uint16_t mmu_read16(MMU *mmu, uint16_t addr);
 
+/* where in the cartridge ROM image addr (0000-7FFF) reads from with the banks as
+they are mapped now, or MMU_NOT_ROM if it doesn't read the image (the boot ROM is
+mapped over it, no image is loaded, past its end or not ROM at all) */
+#define MMU_NOT_ROM UINT32_MAX
+uint32_t mmu_rom_offset(MMU *mmu, uint16_t addr);
+
 // write a 8bit value to the memory bus
 void mmu_write(MMU *mmu, uint16_t addr, uint8_t value);
 
 // write a 16bit value to the memory bus
 void mmu_write16(MMU *mmu, uint16_t addr, uint16_t value);
 
+// external RAM in use: cartridge RAM, or the legacy ERAM array if the cartridge has none
+uint8_t *mmu_ext_ram(const MMU *mmu);
+uint32_t mmu_ext_ram_size(const MMU *mmu);
+
+// memory behind a dirty-tracking page and its size (0 if the page doesn't exist,
+// e.g. past the end of this cartridge's RAM)
+uint8_t *mmu_page(MMU *mmu, int page);
+size_t mmu_page_size(const MMU *mmu, int page);
+
+// memory was replaced wholesale (state load): every page is dirty for every consumer
+void mmu_mark_all_dirty(MMU *mmu);
+
 #endif
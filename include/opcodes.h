@@ -29,13 +29,73 @@
 #undef mem_write
 #undef mem_write16
 
+/* two tiers are compiled from the opcode definitions below. the fast one
+(opcodes.c) does all of an instruction's bus accesses before its cycles are
+ticked. the accurate one (opcodes_accurate.c, which defines OPCODES_ACCURATE and
+builds opcodes.c again) puts every access on its own M-cycle: the machine is
+ticked 4 cycles up to each one, and up to each internal M-cycle (ADV_IDLE) that
+comes before one, so the timer and PPU see reads and writes when the hardware
+does. ADV_CYCLES then only ticks what is left of the instruction */
+#ifdef OPCODES_ACCURATE
+
+#define decode_and_execute decode_and_execute_accurate
+#define call_u16 call_u16_accurate
+#define ret ret_accurate
+
+static inline void accurate_idle(CPU *cpu) {
+    tick(cpu, 4);
+    cpu->pending -= 4;
+}
+
+static inline uint8_t accurate_read(CPU *cpu, uint16_t addr) {
+    accurate_idle(cpu);
+    return mmu_read(cpu->mmu, addr);
+}
+
+static inline void accurate_write(CPU *cpu, uint16_t addr, uint8_t v) {
+    accurate_idle(cpu);
+    mmu_write(cpu->mmu, addr, v);
+}
+
+static inline uint16_t accurate_read16(CPU *cpu, uint16_t addr) {
+    uint8_t low = accurate_read(cpu, addr);
+    return (uint16_t)(low | accurate_read(cpu, addr + 1) << 8);
+}
+
+#define mem_read(addr) accurate_read((cpu), (addr))
+#define mem_read16(addr) accurate_read16((cpu), (addr))
+#define mem_write(addr, v) accurate_write((cpu), (addr), (v))
+#define mem_write16(addr, v) \
+    (accurate_write((cpu), (addr), (v) & 0xFF), accurate_write((cpu), (addr) + 1, (v) >> 8))
+#define ADV_IDLE(cpu) accurate_idle(cpu)
+
+#else
+
 #define mem_read(addr) mmu_read((cpu)->mmu, (addr))
 #define mem_read16(addr) mmu_read16((cpu)->mmu, (addr))
 #define mem_write(addr, v) mmu_write((cpu)->mmu, (addr), (v))
 #define mem_write16(addr, v) mmu_write16((cpu)->mmu, (addr), (v))
+#define ADV_IDLE(cpu) ((void)0)
+
+#endif
+
+/* gb-recomp's output (see recomp.h) builds opcodes.c into itself on the fast tier
+with OPCODES_RECOMP defined. decode_and_execute is then private to it and always
+inlined, like decode_cb always is: each compiled instruction calls one of them
+with its opcode as a constant, and the switch folds down to that opcode's function */
+#ifdef OPCODES_RECOMP
+#define OPCODES_FOLD inline __attribute__((always_inline))
+#else
+#define OPCODES_FOLD
+#endif
 
 // decode and execute the opcode (switch statement)
+#ifdef OPCODES_RECOMP
+static OPCODES_FOLD void decode_and_execute(CPU *cpu, uint8_t op);
+#else
 void decode_and_execute(CPU *cpu, uint8_t op);
+void decode_and_execute_accurate(CPU *cpu, uint8_t op);  // same, on the accurate tier
+#endif
 
 // helper to advance the program counter
 inline void advance_pc(CPU *cpu, uint8_t n) { cpu->pc += n; }
@@ -70,7 +130,10 @@ inline void add_i8_to_u16(uint16_t sp, int8_t off, uint16_t *out, CPU *cpu) {
 
 /* other helpers -------------------------------- */
 #define ADV_PC(cpu, n) advance_pc((cpu), (n))
-#define ADV_CYCLES(cpu, n) tick((cpu), (n))
+/* instructions only count their cycles. cpu_step ticks the timer and PPU once with
+the total when the instruction is done, which is when they always saw them: every
+bus access of an instruction comes before its cycles */
+#define ADV_CYCLES(cpu, n) ((cpu)->pending += (n))
 
 inline void call_u16(CPU *cpu) {
     /* 1. fetch the target address (little‑endian) */
@@ -79,6 +142,7 @@ inline void call_u16(CPU *cpu) {
     /* 2. compute address to return to and skip operand */
     uint16_t ret_addr = cpu->pc + 2;
     advance_pc(cpu, 2);
+    ADV_IDLE(cpu);
 
     /* 3. push ret_addr (high byte first, then low byte) */
     cpu->sp--;
@@ -767,6 +831,7 @@ inline void ret(CPU *cpu) {
         uint8_t high = high_byte(cpu->R16);          \
         uint8_t low = low_byte(cpu->R16);            \
         /* 2. first, write the high, then the low */ \
+        ADV_IDLE(cpu);                               \
         cpu->sp--;                                   \
         mem_write(cpu->sp, high);                    \
         cpu->sp--;                                   \
@@ -991,6 +1056,7 @@ inline void ret(CPU *cpu) {
 #define DEF_RET_NC(OP)                       \
     static void op_##OP##_ret_nc(CPU *cpu) { \
         /* return if FLAG_C = 0 */           \
+        ADV_IDLE(cpu);                       \
         if (!get_flag(cpu, FLAG_C)) {        \
             /* use the RET helper */         \
             RET(cpu);                        \
@@ -1003,6 +1069,7 @@ inline void ret(CPU *cpu) {
 #define DEF_RET_NZ(OP)                       \
     static void op_##OP##_ret_nz(CPU *cpu) { \
         /* return if FLAG_Z = 0 */           \
+        ADV_IDLE(cpu);                       \
         if (!get_flag(cpu, FLAG_Z)) {        \
             /* use the RET helper */         \
             RET(cpu);                        \
@@ -1015,6 +1082,7 @@ inline void ret(CPU *cpu) {
 #define DEF_RET_C(OP)                       \
     static void op_##OP##_ret_c(CPU *cpu) { \
         /* return if FLAG_C = 1 */          \
+        ADV_IDLE(cpu);                      \
         if (get_flag(cpu, FLAG_C)) {        \
             /* use the RET helper */        \
             RET(cpu);                       \
@@ -1027,6 +1095,7 @@ inline void ret(CPU *cpu) {
 #define DEF_RET_Z(OP)                       \
     static void op_##OP##_ret_z(CPU *cpu) { \
         /* return if FLAG_Z = 1 */          \
+        ADV_IDLE(cpu);                      \
         if (get_flag(cpu, FLAG_Z)) {        \
             /* use the RET helper */        \
             RET(cpu);                       \
@@ -1042,12 +1111,14 @@ inline void ret(CPU *cpu) {
         RET(cpu);                          \
         /* 2. enable interrupts */         \
         cpu->ime = 1;                      \
+        cpu_update_interrupts(cpu);        \
         ADV_CYCLES(cpu, 16);               \
     }
 
 #define DEF_RST(OP, ADDR)                        \
     static void op_##OP##_rst_##ADDR(CPU *cpu) { \
         /* 1. push the return address */         \
+        ADV_IDLE(cpu);                           \
         cpu->sp--;                               \
         mem_write(cpu->sp, high_byte(cpu->pc));  \
         cpu->sp--;                               \
@@ -1072,6 +1143,7 @@ inline void ret(CPU *cpu) {
             cpu->halt_bug = 1;                                    \
         } else {                                                  \
             cpu->halt = 1;                                        \
+            cpu_update_interrupts(cpu);                           \
         }                                                         \
     }
 
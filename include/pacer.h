@@ -0,0 +1,43 @@
+#ifndef PACER_HEADER
+#define PACER_HEADER
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#define DMG_CLOCK_HZ 4194304.0  // T-cycles per second
+#define DMG_FRAME_CYCLES 70224  // T-cycles per frame (154 lines of 456), ~59.7275 Hz
+
+/* real-time pacing from emulated cycles. the deadline for any point of the
+emulation is origin + cycles / DMG_CLOCK_HZ on the monotonic clock, computed
+from the total cycle count every time, so rounding and late wake-ups never
+accumulate into drift. waiting sleeps until shortly before the deadline and spins the
+rest; the spin margin follows how late the host's sleeps actually wake up, so
+it stays as small as the host allows.
+
+if the emulator falls too far behind (a stall, a breakpoint, fast-forward) the
+schedule restarts from now instead of racing to catch up */
+
+typedef struct Pacer {
+    double origin;           // host seconds at origin_cycles
+    uint64_t origin_cycles;  // emulated cycles at origin
+    double oversleep;        // smoothed seconds a sleep wakes up past its request
+    double lateness;         // smoothed seconds past the deadline when wait returns
+    uint64_t resyncs;        // times the schedule was restarted
+} Pacer;
+
+// start pacing from the current cycle count
+void pacer_init(Pacer *p, uint64_t cycles);
+
+// restart the schedule from now (after fast-forward, loading a state, ...)
+void pacer_resync(Pacer *p, uint64_t cycles);
+
+// host time (pacer_now) at which the emulation is due to reach this cycle count
+double pacer_deadline(const Pacer *p, uint64_t cycles);
+
+// block until the host clock reaches the time of this cycle count
+void pacer_wait(Pacer *p, uint64_t cycles);
+
+// host monotonic time in seconds
+double pacer_now(void);
+
+#endif
@@ -0,0 +1,29 @@
+#ifndef PIXEL_HEADER
+#define PIXEL_HEADER
+
+#include <stddef.h>
+#include <stdint.h>
+
+/* conversion of 2-bit shades (0-3, one byte per pixel, what the PPU draws) into
+host pixel formats, one scanline at a time */
+
+typedef enum {
+    PIXEL_INDEXED  = 0,  // one byte per pixel, shade 0-3
+    PIXEL_2BPP     = 1,  // four pixels per byte, leftmost pixel in the top bits
+    PIXEL_RGB565   = 2,  // 16-bit 5:6:5, native endianness
+    PIXEL_RGBA8888 = 3,  // bytes R, G, B, A in memory order (raylib's R8G8B8A8)
+} pixel_format;
+
+// bytes needed for n pixels in a format
+size_t pixel_row_size(pixel_format format, int n);
+
+// RGB565 value of an RGBA8888 color
+uint16_t pixel_rgb565(const uint8_t *rgba);
+
+void pixel_to_2bpp(const uint8_t *shades, uint8_t *out, int n);  // n multiple of 4
+void pixel_to_rgb565(const uint8_t *shades, uint16_t *out, const uint16_t lut[4], int n);
+
+// lut holds each shade's color as 4 bytes in memory order (16 bytes)
+void pixel_to_rgba8888(const uint8_t *shades, uint8_t *out, const uint8_t *lut, int n);
+
+#endif
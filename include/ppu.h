@@ -5,6 +5,8 @@
 #include <stdint.h>
 #include <stdio.h>
 
+#include "pixel.h"
+
 #define LCD_HEIGHT 144
 #define LCD_WIDTH 160
 
@@ -70,13 +72,29 @@ typedef struct PPU {
                                                           // current scanline
     int num_scanline_sprites;  // number of sprites in the current scanline
 
-    /* framebuffer */
+    int frame_completed;  // flag to indicate if the frame (all scanlines) is
+                          // completed
+
+    /* framebuffer. everything above it is machine state and gets snapshotted,
+    the framebuffer and what follows are output and host settings (every visible
+    line is redrawn before the next frame completes) */
     uint8_t framebuffer[LCD_HEIGHT]
                        [LCD_WIDTH];  // framebuffer for the LCD
                                      // each pixel is a 0-3 shade of gray
 
-    int frame_completed;  // flag to indicate if the frame (all scanlines) is
-                          // completed
+    bool skip_render;  // don't draw scanlines (frames nobody will see, e.g. run-ahead)
+
+    /* host output: every drawn scanline is also written here in the host's pixel
+    format, so the frontend can upload it as is */
+    pixel_format output_format;
+    uint8_t *output;           // NULL = framebuffer only
+    size_t output_pitch;       // bytes from one line to the next
+    uint8_t palette_rgba[16];  // color of each shade, RGBA
+    uint16_t palette_rgb565[4];
+
+    /* lines whose picture changed since the host last looked (it clears them).
+    a drawn line is compared with what it replaces in the framebuffer */
+    bool line_dirty[LCD_HEIGHT];
 
 } PPU;
 
@@ -84,6 +102,12 @@ void ppu_init(PPU *ppu, struct MMU *mmu, struct CPU *cpu);
 void ppu_reset(PPU *ppu);
 void ppu_step(PPU *ppu, int cycles);
 
+/* select the host output: format and buffer (LCD_HEIGHT lines of pitch bytes, NULL for none) */
+void ppu_set_output(PPU *ppu, pixel_format format, void *buffer, size_t pitch);
+
+/* color of each shade in the RGB output formats, 4 colors of 4 bytes (R, G, B, A) */
+void ppu_set_palette(PPU *ppu, const uint8_t *rgba);
+
 /* helper to get current framebuffer data and pass it to the main game loop */
 const uint8_t (*ppu_get_framebuffer(PPU *ppu))[LCD_WIDTH];
 
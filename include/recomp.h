@@ -0,0 +1,86 @@
+#ifndef RECOMP_HEADER
+#define RECOMP_HEADER
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "gb.h"
+
+#define RECOMP_VERSION 1  // bump when what generated code expects of the runtime changes
+
+/* static recompilation. gb-recomp walks a ROM offline from its entry point and the
+RST and interrupt vectors, follows the bank switches it can work out and builds
+the control-flow graph of every function it reaches. each function comes out as
+one C function with a label per basic block, running its instructions one after
+the other through opcodes.c built in with OPCODES_RECOMP: exactly what the
+interpreter does, minus fetching and decoding, with branches inside the function
+turned into gotos.
+
+the C is built into a shared object that recomp_load maps in next to the ROM,
+and gb_run then enters compiled code wherever the CPU sits at the start of a
+block of cartridge ROM as it is currently banked in. the rest stays with the
+interpreter: RAM (so self-modifying code never runs compiled, and ROM itself
+can't be written), the boot ROM, anything the walk didn't find, and every step
+that dispatches an interrupt, runs HALT or needs the reference paths, the
+accurate tier or tracing.
+
+compiled code hands back to gb_run after any instruction at which gb_run would
+stop or cpu_step would have more to do than fetch the next one, and after any
+write that may have switched its bank out from under it */
+
+/* runs a compiled function from the block at gb->cpu.pc until it leaves the
+function or has to hand back. end is gb_run's budget end */
+typedef void (*recomp_fn)(GB *gb, uint64_t end);
+
+typedef struct RecompBlock {
+    uint32_t offset;  // ROM image offset of the block's first instruction
+    recomp_fn fn;     // the function it was compiled into
+} RecompBlock;
+
+/* what the shared object exports as recomp_table */
+typedef struct RecompTable {
+    uint32_t version;           // RECOMP_VERSION it was generated for
+    uint32_t gb_size;           // sizeof(GB) it was compiled against
+    uint64_t rom_hash;          // recomp_rom_hash of the image it was generated from
+    uint32_t count;             // blocks
+    const RecompBlock *blocks;  // every block any function can be entered at
+} RecompTable;
+
+typedef struct Recomp {
+    void *handle;               // from dlopen
+    const RecompTable *table;   // inside the shared object
+    RecompBlock *slots;         // the blocks again, open addressing on offset (fn NULL: free)
+    uint32_t mask;              // slot count - 1, a power of two
+    uint64_t entries;           // times gb_run entered compiled code
+} Recomp;
+
+// FNV-1a of a ROM image, what a table is matched against
+uint64_t recomp_rom_hash(const uint8_t *rom, uint32_t size);
+
+// map in compiled code for the ROM loaded in mmu. false (and nothing loaded) if it
+// can't be opened or was generated from another ROM or against other headers
+bool recomp_load(Recomp *r, const char *path, const MMU *mmu);
+void recomp_free(Recomp *r);
+
+// run compiled code from where gb is, as gb_run would. false, with nothing run, if
+// there is none for pc or this step needs the interpreter
+bool recomp_run(Recomp *r, GB *gb, uint64_t end);
+
+/* used by the generated code */
+
+// after each instruction: retire it like cpu_step, then true if compiled code has
+// to hand back to gb_run (the conditions gb_run stops on, or an interrupt to take)
+static inline bool recomp_next(GB *gb, uint64_t end) {
+    CPU *cpu = &gb->cpu;
+    cpu_retire(cpu);
+    return cpu->interrupt_check || cpu->cycles >= end || gb->ppu.frame_completed ||
+           cpu->pc == gb->breakpoint || (gb->serial.completed && gb->serial_stop);
+}
+
+// after a write that may have reached the MBC: is the next instruction still the
+// one at offset in the image
+static inline bool recomp_mapped(GB *gb, uint32_t offset) {
+    return mmu_rom_offset(&gb->mmu, gb->cpu.pc) == offset;
+}
+
+#endif
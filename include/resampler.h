@@ -0,0 +1,55 @@
+#ifndef RESAMPLER_HEADER
+#define RESAMPLER_HEADER
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include "apu.h"
+
+/* stereo windowed-sinc resampler from the APU's rate to the host's.
+
+each output sample is a 48-tap dot product against one of 256 precomputed
+phases of the filter, picked by the fractional input position, so any ratio
+(including one that drifts) costs the same. the filter cuts a little below the
+lower of the two Nyquist rates, which is what keeps the APU's band-limited
+output free of aliasing on the way down to 48 kHz.
+
+dynamic rate control: the emulator and the audio device run off different
+clocks, so whatever sits between them slowly fills up or runs dry. resampler_control
+nudges the ratio by up to RESAMPLER_MAX_ADJUST (0.5%, well below audible pitch
+change) to steer the fill level back to a target instead */
+
+#define RESAMPLER_TAPS 48
+#define RESAMPLER_PHASES 256
+#define RESAMPLER_MAX_INPUT 4096  // most input frames held at once
+#define RESAMPLER_MAX_ADJUST 0.005
+
+typedef struct Resampler {
+    double ratio;   // input frames per output frame, nominal
+    double adjust;  // rate control factor applied on top
+    uint64_t step;  // ratio * adjust, 32.32 fixed point
+    uint64_t pos;   // next output position in history, 32.32 fixed point
+
+    float *kernel;  // RESAMPLER_PHASES x RESAMPLER_TAPS
+    float history[(RESAMPLER_MAX_INPUT + RESAMPLER_TAPS) * 2];  // interleaved L/R
+    size_t count;  // frames in history
+} Resampler;
+
+// build the filter for in_rate -> out_rate (Hz). returns false if out of memory
+bool resampler_init(Resampler *rs, double in_rate, double out_rate);
+void resampler_free(Resampler *rs);
+
+// input frames resampler_run needs to produce out_frames more output frames
+size_t resampler_input_needed(const Resampler *rs, size_t out_frames);
+
+// append in_frames of input (at most RESAMPLER_MAX_INPUT minus what is still
+// held, the rest is dropped) and write up to out_max output frames. returns the
+// number of output frames written
+size_t resampler_run(Resampler *rs, const apu_sample_t *in, size_t in_frames, apu_sample_t *out,
+                     size_t out_max);
+
+// rate control: fill is how much input is waiting upstream, target where it should sit
+void resampler_control(Resampler *rs, size_t fill, size_t target);
+
+#endif
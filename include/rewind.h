@@ -0,0 +1,60 @@
+#ifndef REWIND_HEADER
+#define REWIND_HEADER
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include "gb.h"
+
+/* frame-granular rewind history inside a fixed memory budget.
+
+every frame pushes one record: the register block (gb_regs_t) plus only the
+memory pages written since the previous record, found through the MMU's dirty
+page tracking. every keyframe_interval frames (and whenever the chain is broken)
+the record holds every page instead, so any frame can be rebuilt from the
+nearest keyframe before it plus the deltas after it.
+
+records live back to back in a single arena used as a ring. when the arena is
+full the oldest keyframe is dropped together with the deltas that depend on it */
+
+typedef struct rewind_entry_t {
+    uint32_t offset;  // record position in the arena
+    uint32_t size;    // record size in bytes
+    bool keyframe;    // record holds every page
+} rewind_entry_t;
+
+typedef struct Rewind {
+    GB *gb;
+
+    uint8_t *arena;  // record storage
+    size_t budget;   // arena size in bytes
+
+    rewind_entry_t *entries;  // ring of records, oldest first
+    size_t entries_cap;
+    size_t first;  // index of the oldest record
+    size_t count;  // records currently held
+
+    int keyframe_interval;       // frames between keyframes
+    int frames_since_keyframe;
+    bool force_keyframe;  // next push must hold every page (chain broken)
+} Rewind;
+
+// allocate the history and start tracking writes. returns false if out of memory
+bool rewind_init(Rewind *rw, GB *gb, size_t budget, int keyframe_interval);
+
+// stop tracking writes and release the history
+void rewind_free(Rewind *rw);
+
+// record the current machine state, call once per frame. returns false if a
+// single record doesn't fit in the budget
+bool rewind_push(Rewind *rw);
+
+// restore the most recently pushed state and drop it from the history.
+// returns false if the history is empty
+bool rewind_pop(Rewind *rw);
+
+// number of frames that can currently be rewound
+size_t rewind_frames(const Rewind *rw);
+
+#endif
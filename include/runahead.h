@@ -0,0 +1,39 @@
+#ifndef RUNAHEAD_HEADER
+#define RUNAHEAD_HEADER
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "gb.h"
+
+#define RUNAHEAD_MAX_FRAMES 4
+
+/* run-ahead hides the game's own input lag. every host frame the real frame is
+run without drawing, the machine is snapshotted, then it keeps running `frames`
+more frames with the same input and only the last of them is drawn. the snapshot
+is restored afterwards, so the machine only ever advances one frame per call, but
+the picture shows where it will be `frames` frames later: input pressed now is
+visible that many frames sooner.
+
+frames ahead skip all PPU drawing (except the last) and never send their sound
+to the host, and snapshots are a few memcpys, so the extra cost is mostly the
+CPU time of the hidden frames */
+typedef struct RunAhead {
+    GB *gb;
+    int frames;          // frames shown ahead, 0 (off) to RUNAHEAD_MAX_FRAMES
+    uint8_t *snapshot;   // gb_snapshot_t of the real frame
+    apu_output_t audio;  // sound output of the real frame, not yet sent to the host
+} RunAhead;
+
+// allocate the snapshot buffer. the ROM must already be loaded (it fixes the size)
+bool runahead_init(RunAhead *ra, GB *gb, int frames);
+
+// change the number of frames (clamped to 0..RUNAHEAD_MAX_FRAMES)
+void runahead_set_frames(RunAhead *ra, int frames);
+
+// advance the machine by one frame, leaving the run-ahead picture in the framebuffer
+void runahead_run_frame(RunAhead *ra);
+
+void runahead_free(RunAhead *ra);
+
+#endif
@@ -0,0 +1,70 @@
+#ifndef SAVESTATE_HEADER
+#define SAVESTATE_HEADER
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include "gb.h"
+
+/* on-disk save states. all integers are little-endian.
+
+header (32 bytes)
+- 0x00: magic "DMGS"
+- 0x04: format version (bumped only for incompatible changes)
+- 0x06: number of sections
+- 0x08: ROM global checksum (cartridge header 0x014E-0x014F)
+- 0x0A: reserved
+- 0x0C: title (16 bytes, from cartridge header 0x0134)
+- 0x1C: reserved
+
+section table (20 bytes per section, right after the header)
+- id (four character code), flags, file offset, stored size, raw size
+
+every component has its own section, written field by field. new fields are
+only ever appended to the end of a section, so older files simply have shorter
+sections and the loader keeps the reset value for whatever is missing. unknown
+sections are skipped. large sections (memories) are LZ compressed and only
+decompressed, straight into the machine, when the state is actually loaded */
+
+#define SAVESTATE_VERSION 1
+
+typedef struct SaveState {
+    const uint8_t *data;  // the mapped file
+    size_t size;          // file size in bytes
+
+    uint16_t version;       // format version of the file
+    uint16_t rom_checksum;  // global checksum of the ROM the state belongs to
+    char title[17];         // cartridge title, NUL terminated
+
+    uint16_t section_count;
+    const uint8_t *sections;  // section table inside data
+} SaveState;
+
+// global checksum stored in the cartridge header (0x014E-0x014F)
+uint16_t savestate_rom_checksum(const MMU *mmu);
+
+// write the machine state to path. returns false on I/O errors
+bool savestate_write(const GB *gb, const char *path);
+
+/* hash of everything savestate_write would save except the picture, taken from
+the same field-by-field encoding, so it doesn't depend on struct layout and two
+builds of the emulator can compare their states */
+uint64_t savestate_hash(const GB *gb);
+
+// map a state file and read its header and section table. nothing is decompressed yet
+bool savestate_open(SaveState *ss, const char *path);
+
+// true if the state was saved with the ROM currently loaded in mmu
+bool savestate_matches_rom(const SaveState *ss, const MMU *mmu);
+
+// load the state into a machine that has the same ROM loaded
+bool savestate_load(const SaveState *ss, GB *gb);
+
+// decompress only the saved picture (e.g. for a state browser thumbnail)
+bool savestate_read_framebuffer(const SaveState *ss, uint8_t framebuffer[LCD_HEIGHT][LCD_WIDTH]);
+
+// unmap the file
+void savestate_close(SaveState *ss);
+
+#endif
@@ -0,0 +1,67 @@
+#ifndef SERIAL_HEADER
+#define SERIAL_HEADER
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#define SB 0xFF01  // serial transfer data
+#define SC 0xFF02  // serial transfer control
+
+#define SERIAL_START 0x80     // SC bit 7: transfer requested / in progress
+#define SERIAL_INTERNAL 0x01  // SC bit 0: this side drives the clock
+
+#define SERIAL_BIT_CYCLES 512  // one bit at 8192 Hz
+#define SERIAL_PENDING (-1)    // transfer hook: the incoming byte comes later
+
+struct CPU;
+
+/* called when this side starts a transfer on its own clock: out is the byte
+being sent, the return value the byte that will be shifted in (0xFF if nothing
+is connected), or SERIAL_PENDING if the other end answers later through
+serial_reply */
+typedef int (*serial_transfer_fn)(void *user, uint8_t out);
+
+/* the serial port. with the internal clock a byte takes 8 bits at 8192 Hz
+(4096 cycles): one bit shifts on every falling edge of bit 8 of the system
+counter, which the timer reports through serial_clock. when the last bit is in,
+SC bit 7 clears and the serial interrupt (IF bit 3) is requested.
+
+with the external clock the other end drives the transfer: serial_receive hands
+over its byte and the bits are shifted in on the same local 8192 Hz clock */
+typedef struct Serial {
+    struct CPU *cpu;  // pointer to the CPU
+
+    uint8_t sb;         // SB: shifts out at the top, in at the bottom
+    uint8_t sc;         // SC: bits 7 and 0
+    uint8_t bits_left;  // bits still to shift in the current transfer (0 = idle)
+    uint8_t incoming;   // byte being shifted in
+    bool pending;       // incoming not known yet (waiting for serial_reply)
+
+    /* host side, not machine state. must stay last */
+    serial_transfer_fn transfer;
+    void *user;
+    bool completed;  // a transfer finished since gb_run cleared this
+    bool stop;       // gb_run stops on completed: end a HALT stretch there too
+} Serial;
+
+void serial_init(Serial *serial, struct CPU *cpu);
+void serial_reset(Serial *serial);
+
+// where outgoing bytes go (and incoming ones come from). NULL: nothing connected
+void serial_connect(Serial *serial, serial_transfer_fn transfer, void *user);
+
+/* mmu helpers */
+uint8_t serial_read_sc(const Serial *serial);         /* read 0xFF02 */
+void serial_write_sc(Serial *serial, uint8_t value);  /* write 0xFF02 */
+
+// falling edge of system counter bit 8: shift one bit of a running transfer
+void serial_clock(Serial *serial);
+
+// the answer to a transfer the hook left SERIAL_PENDING
+void serial_reply(Serial *serial, uint8_t in);
+
+// the other end started a transfer on its clock, sending in, and elapsed bits
+// of it have already gone by. returns the byte this side sends back
+uint8_t serial_receive(Serial *serial, uint8_t in, uint8_t elapsed);
+
+#endif
@@ -0,0 +1,67 @@
+#ifndef SNAPSHOT_HEADER
+#define SNAPSHOT_HEADER
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include "gb.h"
+
+#define GB_SNAPSHOT_MAGIC 0x534E4744u  // "DGNS"
+
+/* the small, non-memory part of the machine: every component's registers
+- CPU, timer, joypad and MBC structs are copied whole (pointers are re-linked on restore)
+- PPU is copied up to its framebuffer (see ppu.h), APU up to its output buffer,
+  serial port up to its host hook
+- I/O registers and the few MMU flags */
+typedef struct gb_regs_t {
+    CPU cpu;
+    Timer timer;
+    uint8_t ppu[offsetof(PPU, framebuffer)];  // PPU state, framebuffer excluded
+    Joypad joypad;
+    uint8_t apu[offsetof(APU, output)];          // APU state, output buffer excluded
+    uint8_t serial[offsetof(Serial, transfer)];  // serial state, host hook excluded
+    MBC mbc;
+
+    uint8_t io[0x0080];
+    uint8_t rom_bank;
+    bool ram_enable;
+    bool boot_rom_enabled;
+} gb_regs_t;
+
+/* in-memory copy of a running machine. the layout is a flat block so that
+saving and restoring is a handful of memcpys with no allocation. the cartridge
+ROM, legacy ROM copy and boot ROM are never copied, the restored machine keeps
+using the ROM it already has loaded. external RAM (cartridge RAM, or the legacy
+ERAM when there is none) trails the struct */
+typedef struct gb_snapshot_t {
+    uint32_t magic;  // GB_SNAPSHOT_MAGIC
+    uint32_t size;   // total size in bytes, trailing external RAM included
+
+    gb_regs_t regs;
+
+    /* MMU memories */
+    uint8_t vram[0x2000];
+    uint8_t wram[0x2000];
+    uint8_t oam[0x00A0];
+    uint8_t hram[0x007F];
+
+    uint32_t ext_ram_size;  // size of ext_ram[]
+    uint8_t ext_ram[];      // cartridge RAM, or the legacy ERAM if no cartridge RAM
+} gb_snapshot_t;
+
+// copy / restore only the register block (restoring re-links the component pointers)
+void gb_regs_save(const GB *gb, gb_regs_t *regs);
+void gb_regs_restore(GB *gb, const gb_regs_t *regs);
+
+// exact number of bytes gb_snapshot_save will write for this machine
+size_t gb_snapshot_size(const GB *gb);
+
+// copy the machine state into buf (at least gb_snapshot_size bytes), returns bytes written
+size_t gb_snapshot_save(const GB *gb, void *buf);
+
+// restore a machine from buf. the cartridge must be the same one (or at least the
+// same RAM size) the snapshot was taken with. returns false if buf is not a usable snapshot
+bool gb_snapshot_restore(GB *gb, const void *buf);
+
+#endif
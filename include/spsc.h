@@ -0,0 +1,36 @@
+#ifndef SPSC_HEADER
+#define SPSC_HEADER
+
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+/* lock-free single producer, single consumer queue of fixed-size elements.
+exactly one thread pushes and exactly one other thread pops. the capacity is a
+power of two so positions wrap with a mask, and the two positions sit on their
+own cache lines so the threads don't keep stealing each other's line */
+
+typedef struct SpscQueue {
+    uint8_t *data;
+    size_t elem_size;
+    size_t capacity;  // elements, power of two
+
+    _Alignas(64) atomic_size_t head;  // next element to write (producer)
+    _Alignas(64) atomic_size_t tail;  // next element to read (consumer)
+} SpscQueue;
+
+// capacity is rounded up to a power of two
+bool spsc_init(SpscQueue *q, size_t elem_size, size_t capacity);
+void spsc_free(SpscQueue *q);
+
+// push up to n elements, returns how many fit
+size_t spsc_push(SpscQueue *q, const void *elems, size_t n);
+
+// pop up to n elements, returns how many there were
+size_t spsc_pop(SpscQueue *q, void *elems, size_t n);
+
+// elements waiting (exact for either side's own view)
+size_t spsc_count(SpscQueue *q);
+
+#endif
@@ -0,0 +1,41 @@
+#ifndef STATEHASH_HEADER
+#define STATEHASH_HEADER
+
+#include <stdint.h>
+
+#include "gb.h"
+
+/* compact hashes of the machine state, one per component so a mismatch says
+where to look. covers what a snapshot does (see snapshot.h) minus the component
+pointers, which differ from one machine to the next even when the state doesn't.
+struct padding is hashed too: gb_init zeroes it and nothing writes it after */
+typedef enum gb_hash_part_t {
+    GB_HASH_CPU,
+    GB_HASH_TIMER,
+    GB_HASH_PPU,
+    GB_HASH_JOYPAD,
+    GB_HASH_APU,
+    GB_HASH_SERIAL,
+    GB_HASH_MBC,
+    GB_HASH_IO,  // I/O registers and the MMU banking flags
+    GB_HASH_VRAM,
+    GB_HASH_WRAM,
+    GB_HASH_OAM,
+    GB_HASH_HRAM,
+    GB_HASH_EXT_RAM,
+    GB_HASH_PARTS,
+} gb_hash_part_t;
+
+// hash every part of the machine from scratch into hash[GB_HASH_PARTS]
+void gb_state_hashes(const GB *gb, uint64_t hash[GB_HASH_PARTS]);
+
+/* the whole machine in one hash, kept up to date incrementally: each memory page
+has its own hash, refreshed only once mmu_write has dirtied it (MMU_DIRTY_HASH),
+and the page hashes are xored together. a call costs the register blocks plus
+the pages written since the last one, so it is cheap enough to take after every
+step. the first call turns page tracking on and hashes all of memory */
+uint64_t gb_state_hash(GB *gb);
+
+const char *gb_hash_part_name(gb_hash_part_t part);
+
+#endif
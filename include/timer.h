@@ -6,10 +6,14 @@
 
 struct CPU;
 struct MMU;
+struct APU;
+struct Serial;
 
 typedef struct Timer {
     struct CPU *cpu;  // pointer to the CPU
     struct MMU *mmu;  // pointer to the MMU
+    struct APU *apu;        // pointer to the APU (its frame sequencer runs off DIV)
+    struct Serial *serial;  // pointer to the serial port (its clock runs off DIV)
 
     uint16_t div;   // divider register (0xFF04)
     uint16_t tima;  // timer counter register (0xFF05)
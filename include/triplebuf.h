@@ -0,0 +1,57 @@
+#ifndef TRIPLEBUF_HEADER
+#define TRIPLEBUF_HEADER
+
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+/* lock-free triple buffer: one producer thread hands whole frames to one
+consumer thread. the producer always has a buffer to write into and the consumer
+always has the most recent complete frame to read, neither ever waits for the
+other. frames the consumer didn't get to in time are simply replaced.
+
+the three buffers rotate between three roles: back (producer writing), front
+(consumer reading) and middle (latest published frame, waiting). only the
+middle index is shared, along with a flag telling whether it holds a frame the
+consumer hasn't taken yet.
+
+a consumer with nothing else to do can sleep until the next frame instead of
+polling: publish wakes it. that costs the producer an uncontended lock per frame,
+never a wait on the consumer */
+
+typedef struct TripleBuffer {
+    uint8_t *data;  // three buffers of size bytes each
+    size_t size;
+
+    _Alignas(64) int back;            // producer side
+    _Alignas(64) int front;           // consumer side
+    _Alignas(64) atomic_uint middle;  // middle index | fresh flag
+
+    pthread_mutex_t lock;  // only for sleeping in triplebuf_wait
+    pthread_cond_t published;
+} TripleBuffer;
+
+bool triplebuf_init(TripleBuffer *tb, size_t size);
+void triplebuf_free(TripleBuffer *tb);
+
+/* producer */
+// buffer to fill with the next frame
+uint8_t *triplebuf_back(TripleBuffer *tb);
+// hand the back buffer to the consumer and get a new back buffer
+void triplebuf_publish(TripleBuffer *tb);
+// true once the consumer has taken the last published frame (a new one would be seen)
+bool triplebuf_consumed(TripleBuffer *tb);
+
+/* consumer */
+// take the latest published frame, if there is one the consumer hasn't seen.
+// returns false (and keeps the current front buffer) otherwise
+bool triplebuf_acquire(TripleBuffer *tb);
+// most recently acquired frame
+const uint8_t *triplebuf_front(const TripleBuffer *tb);
+// sleep until a frame the consumer hasn't seen is published, or until the host
+// time `until` (seconds on the monotonic clock, as pacer_now). true if there is one
+bool triplebuf_wait(TripleBuffer *tb, double until);
+
+#endif
@@ -0,0 +1,470 @@
+#include "apu.h"
+
+#include <math.h>
+#include <stddef.h>
+#include <string.h>
+
+#include "cpu.h"
+
+#define AMPLITUDE 64  // output units per step of (channel level x master volume)
+
+#define CH_SQUARE1 0
+#define CH_SQUARE2 1
+#define CH_WAVE 2
+#define CH_NOISE 3
+
+/* bits that always read back as 1, per register from NR10 */
+static const uint8_t read_mask[APU_REGS_SIZE] = {
+    0x80, 0x3F, 0x00, 0xFF, 0xBF,                          // NR10-NR14
+    0xFF, 0x3F, 0x00, 0xFF, 0xBF,                          // (unused), NR21-NR24
+    0x7F, 0xFF, 0x9F, 0xFF, 0xBF,                          // NR30-NR34
+    0xFF, 0xFF, 0x00, 0x00, 0xBF,                          // (unused), NR41-NR44
+    0x00, 0x00, 0x70,                                      // NR50-NR52
+    0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF,  // unused
+    /* wave RAM reads back as written */
+};
+
+/* duty cycles, one bit per step (step 0 is the top bit) */
+static const uint8_t duty_steps[4] = {0x01, 0x81, 0x87, 0x7E};
+
+static const uint8_t noise_divisors[8] = {8, 16, 32, 48, 64, 80, 96, 112};
+
+/* band-limited step, as the per-sample differences of a windowed sinc step
+response at each sub-sample phase. every phase sums to exactly 1.0 (Q15) so
+the integrated output never drifts */
+static int32_t kernel[APU_KERNEL_PHASES][APU_KERNEL_TAPS];
+static bool kernel_ready;
+
+static void build_kernel(void) {
+    const double pi     = 3.14159265358979323846;
+    const double cutoff = 0.45;  // of the output rate, just under Nyquist
+    const double half   = APU_KERNEL_TAPS / 2.0;
+
+    for (int phase = 0; phase < APU_KERNEL_PHASES; phase++) {
+        double taps[APU_KERNEL_TAPS];
+        double sum = 0.0;
+
+        for (int k = 0; k < APU_KERNEL_TAPS; k++) {
+            double x    = k - (half - 1.0) - (double)phase / APU_KERNEL_PHASES;
+            double sinc = x == 0.0 ? 1.0 : sin(2.0 * pi * cutoff * x) / (2.0 * pi * cutoff * x);
+            double w    = 0.42 + 0.5 * cos(pi * x / half) + 0.08 * cos(2.0 * pi * x / half);
+            taps[k]     = sinc * w;
+            sum += taps[k];
+        }
+
+        int32_t total = 0;
+        for (int k = 0; k < APU_KERNEL_TAPS; k++) {
+            kernel[phase][k] = (int32_t)lround(taps[k] / sum * 32768.0);
+            total += kernel[phase][k];
+        }
+        kernel[phase][APU_KERNEL_TAPS / 2 - 1] += 32768 - total;  // rounding error
+    }
+    kernel_ready = true;
+}
+
+/* output ---------------------------------------------------------------- */
+
+/* draw an amplitude step at cycle t */
+static void add_step(apu_output_t *out, uint64_t t, int32_t left, int32_t right) {
+    uint64_t offset = t > out->start ? t - out->start : 0;
+    size_t index    = offset / APU_CYCLES_PER_SAMPLE;
+    int phase = (int)(offset % APU_CYCLES_PER_SAMPLE) * APU_KERNEL_PHASES / APU_CYCLES_PER_SAMPLE;
+
+    const int32_t *k = kernel[phase];
+    int32_t *l       = &out->buffer[0][index];
+    int32_t *r       = &out->buffer[1][index];
+    for (int i = 0; i < APU_KERNEL_TAPS; i++) {
+        l[i] += left * k[i];
+        r[i] += right * k[i];
+    }
+}
+
+/* integrate every sample that no future step can touch any more (those before
+apu->time), high-pass them like the DMG's output capacitor and send them off */
+static void flush(APU *apu) {
+    apu_output_t *out = &apu->output;
+    size_t n          = (apu->time - out->start) / APU_CYCLES_PER_SAMPLE;
+    if (n == 0)
+        return;
+
+    apu_sample_t samples[APU_CHUNK_SAMPLES];
+    for (size_t i = 0; i < n; i++) {
+        int16_t s[2];
+        for (int c = 0; c < 2; c++) {
+            out->level[c] += out->buffer[c][i];
+            int32_t level = out->level[c] >> 15;
+            out->dc[c] += (level * 256 - out->dc[c]) >> 11;  // ~5 Hz
+            int32_t v = level - (out->dc[c] >> 8);
+            s[c]      = (int16_t)(v > INT16_MAX ? INT16_MAX : v < INT16_MIN ? INT16_MIN : v);
+        }
+        samples[i] = (apu_sample_t){s[0], s[1]};
+    }
+
+    // a full queue means the host fell behind: drop rather than wait
+    if (out->queue && !out->muted)
+        spsc_push(out->queue, samples, n);
+
+    /* keep the tails of the latest steps, clear what they leave behind */
+    for (int c = 0; c < 2; c++) {
+        memmove(out->buffer[c], out->buffer[c] + n, APU_KERNEL_TAPS * sizeof(int32_t));
+        memset(out->buffer[c] + APU_KERNEL_TAPS, 0, n * sizeof(int32_t));
+    }
+    out->start += n * APU_CYCLES_PER_SAMPLE;
+}
+
+/* channels -------------------------------------------------------------- */
+
+static uint8_t *channel_regs(APU *apu, int i) { return &apu->regs[i * 5]; }  // NRx0
+
+/* T-cycles between waveform steps, 0 if the channel doesn't step */
+static uint32_t channel_period(APU *apu, int i) {
+    const apu_channel_t *ch = &apu->ch[i];
+    switch (i) {
+        case CH_WAVE: return (2048 - ch->freq) * 2;
+        case CH_NOISE: {
+            uint8_t nr43 = apu->regs[NR43 - NR10];
+            if ((nr43 >> 4) >= 14)
+                return 0;  // shifts 14 and 15 never clock the LFSR
+            return (uint32_t)noise_divisors[nr43 & 0x07] << (nr43 >> 4);
+        }
+        default: return (2048 - ch->freq) * 4;
+    }
+}
+
+/* digital output, 0-15 */
+static uint8_t channel_level(APU *apu, int i) {
+    const apu_channel_t *ch = &apu->ch[i];
+    if (!ch->enabled || !ch->dac)
+        return 0;
+
+    switch (i) {
+        case CH_WAVE: {
+            uint8_t shift = (apu->regs[NR32 - NR10] >> 5) & 0x03;
+            if (!shift)
+                return 0;  // muted
+            uint8_t byte   = apu->regs[WAVE_RAM - NR10 + (ch->pos >> 1)];
+            uint8_t sample = (ch->pos & 1) ? byte & 0x0F : byte >> 4;
+            return sample >> (shift - 1);
+        }
+        case CH_NOISE: return (ch->lfsr & 1) ? 0 : ch->volume;
+        default: {
+            uint8_t duty = channel_regs(apu, i)[1] >> 6;
+            return ((duty_steps[duty] >> (7 - ch->pos)) & 1) ? ch->volume : 0;
+        }
+    }
+}
+
+/* recompute what channel i puts into the mix and draw the change at cycle t */
+static void update_output(APU *apu, int i, uint64_t t) {
+    apu_channel_t *ch = &apu->ch[i];
+    uint8_t nr50      = apu->regs[NR50 - NR10];
+    uint8_t nr51      = apu->regs[NR51 - NR10];
+    int level         = channel_level(apu, i) * AMPLITUDE;
+
+    int16_t left  = (nr51 >> (i + 4)) & 1 ? (int16_t)(level * (((nr50 >> 4) & 0x07) + 1)) : 0;
+    int16_t right = (nr51 >> i) & 1 ? (int16_t)(level * ((nr50 & 0x07) + 1)) : 0;
+
+    if (left != ch->out_left || right != ch->out_right) {
+        add_step(&apu->output, t, left - ch->out_left, right - ch->out_right);
+        ch->out_left  = left;
+        ch->out_right = right;
+    }
+}
+
+static void update_outputs(APU *apu) {
+    for (int i = 0; i < 4; i++) {
+        update_output(apu, i, apu->time);
+    }
+}
+
+/* run channel i's waveform up to cycle end, one iteration per step */
+static void run_channel(APU *apu, int i, uint64_t end) {
+    apu_channel_t *ch = &apu->ch[i];
+    uint32_t period   = channel_period(apu, i);
+
+    if (!ch->enabled || !period) {
+        if (ch->next_time < end)
+            ch->next_time = end;
+        return;
+    }
+
+    while (ch->next_time <= end) {
+        switch (i) {
+            case CH_WAVE: ch->pos = (ch->pos + 1) & 0x1F; break;
+            case CH_NOISE: {
+                uint16_t bit = (ch->lfsr ^ (ch->lfsr >> 1)) & 1;
+                ch->lfsr     = (ch->lfsr >> 1) | (bit << 14);
+                if (apu->regs[NR43 - NR10] & 0x08)
+                    ch->lfsr = (ch->lfsr & ~0x40) | (bit << 6);  // 7-bit mode
+                break;
+            }
+            default: ch->pos = (ch->pos + 1) & 0x07; break;
+        }
+        update_output(apu, i, ch->next_time);
+        ch->next_time += period;
+    }
+}
+
+void apu_sync(APU *apu) {
+    uint64_t now = apu->cpu->cycles;
+
+    /* in pieces, so the steps always land inside the buffer */
+    while (apu->time < now) {
+        uint64_t limit = apu->output.start + APU_CHUNK_SAMPLES * APU_CYCLES_PER_SAMPLE;
+        uint64_t end   = now < limit ? now : limit;
+
+        for (int i = 0; i < 4; i++) {
+            run_channel(apu, i, end);
+        }
+        apu->time = end;
+
+        if (end == limit)
+            flush(apu);
+    }
+}
+
+/* frequency the sweep would move channel 1 to, disabling it on overflow */
+static uint16_t sweep_target(APU *apu) {
+    uint8_t nr10   = apu->regs[0];
+    uint16_t delta = apu->sweep_shadow >> (nr10 & 0x07);
+    uint16_t freq  = (nr10 & 0x08) ? apu->sweep_shadow - delta : apu->sweep_shadow + delta;
+    if (freq > 2047)
+        apu->ch[CH_SQUARE1].enabled = false;
+    return freq;
+}
+
+static void trigger(APU *apu, int i) {
+    apu_channel_t *ch = &apu->ch[i];
+    uint8_t nrx2      = channel_regs(apu, i)[2];
+
+    ch->enabled       = ch->dac;
+    if (ch->length == 0)
+        ch->length = i == CH_WAVE ? 256 : 64;
+    ch->next_time = apu->time + channel_period(apu, i);
+
+    if (i != CH_WAVE) {
+        ch->volume     = nrx2 >> 4;
+        ch->env_up     = nrx2 & 0x08;
+        ch->env_period = nrx2 & 0x07;
+        ch->env_timer  = ch->env_period ? ch->env_period : 8;
+    }
+
+    switch (i) {
+        case CH_SQUARE1: {
+            uint8_t period     = (apu->regs[0] >> 4) & 0x07;
+            uint8_t shift      = apu->regs[0] & 0x07;
+            apu->sweep_shadow  = ch->freq;
+            apu->sweep_timer   = period ? period : 8;
+            apu->sweep_enabled = period || shift;
+            if (shift)
+                sweep_target(apu);  // overflow check only
+            break;
+        }
+        case CH_WAVE: ch->pos = 0; break;
+        case CH_NOISE: ch->lfsr = 0x7FFF; break;
+    }
+}
+
+/* frame sequencer ------------------------------------------------------- */
+
+static void clock_length(APU *apu) {
+    for (int i = 0; i < 4; i++) {
+        apu_channel_t *ch = &apu->ch[i];
+        if (ch->length_enable && ch->length > 0 && --ch->length == 0)
+            ch->enabled = false;
+    }
+}
+
+static void clock_sweep(APU *apu) {
+    if (apu->sweep_timer && --apu->sweep_timer > 0)
+        return;
+
+    uint8_t period   = (apu->regs[0] >> 4) & 0x07;
+    apu->sweep_timer = period ? period : 8;
+    if (!apu->sweep_enabled || !period)
+        return;
+
+    uint16_t freq = sweep_target(apu);
+    if (freq <= 2047 && (apu->regs[0] & 0x07)) {
+        apu_channel_t *ch      = &apu->ch[CH_SQUARE1];
+        ch->freq               = freq;
+        apu->sweep_shadow      = freq;
+        apu->regs[NR13 - NR10] = freq & 0xFF;
+        apu->regs[NR14 - NR10] = (apu->regs[NR14 - NR10] & ~0x07) | (freq >> 8);
+        sweep_target(apu);  // the new frequency is checked again right away
+    }
+}
+
+static void clock_envelopes(APU *apu) {
+    static const int channels[3] = {CH_SQUARE1, CH_SQUARE2, CH_NOISE};
+    for (int n = 0; n < 3; n++) {
+        apu_channel_t *ch = &apu->ch[channels[n]];
+        if (!ch->env_period || --ch->env_timer > 0)
+            continue;
+
+        ch->env_timer = ch->env_period;
+        if (ch->env_up && ch->volume < 15)
+            ch->volume++;
+        else if (!ch->env_up && ch->volume > 0)
+            ch->volume--;
+    }
+}
+
+void apu_div_event(APU *apu) {
+    apu_sync(apu);
+
+    if (apu->power) {
+        /* 512 Hz: length on even steps, sweep on 2 and 6, envelope on 7 */
+        uint8_t step = apu->sequencer_step;
+        if (!(step & 1))
+            clock_length(apu);
+        if (step == 2 || step == 6)
+            clock_sweep(apu);
+        if (step == 7)
+            clock_envelopes(apu);
+        apu->sequencer_step = (step + 1) & 0x07;
+        update_outputs(apu);
+    }
+
+    flush(apu);
+}
+
+/* registers ------------------------------------------------------------- */
+
+void apu_init(APU *apu, struct CPU *cpu) {
+    apu->cpu = cpu;
+    if (!kernel_ready)
+        build_kernel();
+
+    apu_reset(apu);
+}
+
+void apu_reset(APU *apu) {
+    struct CPU *cpu = apu->cpu;
+    memset(apu, 0, offsetof(APU, output));
+    apu->cpu = cpu;
+
+    apu->ch[CH_NOISE].lfsr = 0x7FFF;
+    apu->time              = cpu->cycles;
+
+    apu_output_restart(apu);
+}
+
+uint8_t apu_read(APU *apu, uint16_t addr) {
+    int reg = addr - NR10;
+
+    if (addr == NR52) {
+        uint8_t status = 0;
+        for (int i = 0; i < 4; i++) {
+            status |= apu->ch[i].enabled << i;
+        }
+        return 0x70 | (apu->power << 7) | status;
+    }
+    return apu->regs[reg] | read_mask[reg];
+}
+
+static void power_off(APU *apu) {
+    memset(apu->regs, 0, NR52 - NR10);  // NR10-NR51, wave RAM survives
+    for (int i = 0; i < 4; i++) {
+        apu_channel_t *ch = &apu->ch[i];
+        ch->enabled       = false;
+        ch->dac           = false;
+        ch->length_enable = false;
+        ch->freq          = 0;
+        ch->volume        = 0;
+        ch->env_period    = 0;
+    }
+    apu->sweep_enabled = false;
+    apu->power         = false;
+}
+
+void apu_write(APU *apu, uint16_t addr, uint8_t value) {
+    int reg = addr - NR10;
+    apu_sync(apu);
+
+    if (addr >= WAVE_RAM) {
+        apu->regs[reg] = value;
+        update_output(apu, CH_WAVE, apu->time);
+        return;
+    }
+
+    if (addr == NR52) {
+        if (apu->power && !(value & 0x80)) {
+            power_off(apu);
+        } else if (!apu->power && (value & 0x80)) {
+            apu->power          = true;
+            apu->sequencer_step = 0;
+            for (int i = 0; i < 4; i++) {
+                apu->ch[i].pos = 0;
+            }
+        }
+        update_outputs(apu);
+        return;
+    }
+
+    if (!apu->power) {
+        /* powered off, only the length counters can still be written (DMG) */
+        switch (addr) {
+            case NR11:
+            case NR21:
+            case NR41: apu->ch[reg / 5].length = 64 - (value & 0x3F); break;
+            case NR31: apu->ch[CH_WAVE].length = 256 - value; break;
+        }
+        return;
+    }
+
+    apu->regs[reg] = value;
+    if (addr >= NR50) {
+        update_outputs(apu);  // volume or panning for every channel
+        return;
+    }
+
+    int i             = reg / 5;
+    apu_channel_t *ch = &apu->ch[i];
+    switch (reg % 5) {
+        case 1:  // NRx1: length (and duty)
+            ch->length = i == CH_WAVE ? 256 - value : 64 - (value & 0x3F);
+            break;
+        case 2:  // NRx2: envelope, or the wave channel's output level
+            if (i != CH_WAVE) {
+                ch->dac = value & 0xF8;
+                if (!ch->dac)
+                    ch->enabled = false;
+            }
+            break;
+        case 3:  // NRx3: frequency low (the noise channel's period is read from NR43 directly)
+            ch->freq = (ch->freq & 0x0700) | value;
+            break;
+        case 4:  // NRx4: frequency high, length enable, trigger
+            ch->freq          = (ch->freq & 0x00FF) | ((value & 0x07) << 8);
+            ch->length_enable = value & 0x40;
+            if (value & 0x80)
+                trigger(apu, i);
+            break;
+        case 0:  // NR10 is read directly by the sweep, NR30 is the wave DAC
+            if (i == CH_WAVE) {
+                ch->dac = value & 0x80;
+                if (!ch->dac)
+                    ch->enabled = false;
+            }
+            break;
+    }
+    update_output(apu, i, apu->time);
+}
+
+void apu_set_output(APU *apu, SpscQueue *queue) { apu->output.queue = queue; }
+
+void apu_output_restart(APU *apu) {
+    apu_output_t *out = &apu->output;
+    memset(out->buffer, 0, sizeof(out->buffer));
+    out->start = apu->time - apu->time % APU_CYCLES_PER_SAMPLE;  // same sample grid as before
+
+    /* jump straight to the restored level, the high-pass smooths the step */
+    for (int c = 0; c < 2; c++) {
+        int32_t level = 0;
+        for (int i = 0; i < 4; i++) {
+            level += c ? apu->ch[i].out_right : apu->ch[i].out_left;
+        }
+        out->level[c] = level * 32768;
+    }
+}
@@ -9,7 +9,10 @@
 
 #include "opcodes.h"
 
-FILE *cpu_log = NULL;
+FILE *cpu_log = NULL;  // instruction trace, off when NULL
+cpu_trace_fn cpu_trace = NULL;
+void *cpu_trace_user   = NULL;
+bool gb_reference      = false;  // fast paths on
 
 /* function to reset and initialize the CPU
 - sets all regular regs to zero
@@ -22,6 +25,8 @@ void cpu_init(struct CPU *cpu, struct MMU *mmu, struct Timer *timer, struct PPU
     cpu->timer = timer;
     cpu->ppu   = ppu;
 
+    cpu->halt_until = UINT64_MAX;
+
     /* debug register init */
     cpu->a     = 0x01;
     cpu->b     = 0x00;
@@ -51,6 +56,15 @@ static void log_cpu_state(CPU *cpu) {
     fflush(cpu_log);
 }
 
+void cpu_update_interrupts(CPU *cpu) {
+    cpu->interrupt_check = cpu->halt || (cpu->ime && (cpu->ifr & cpu->ier & 0x1F));
+}
+
+void cpu_request_interrupt(CPU *cpu, uint8_t bits) {
+    cpu->ifr |= bits;
+    cpu_update_interrupts(cpu);
+}
+
 /* function to tick the emulator components */
 void tick(CPU *cpu, int cycles) {
     cpu->cycles += cycles;
@@ -84,14 +98,19 @@ static void interrupt_servicing_routine(CPU *cpu) {
     cpu->ifr &= ~(1 << id); /* clear the interrupt flag. this acks the interrupt */
     cpu->ime       = 0;     /* disable interrupts */
     cpu->ime_delay = 0;     /* abort any pending EIs */
+    cpu_update_interrupts(cpu);
 
     uint16_t ret   = cpu->pc; /* save the current program counter */
+    if (cpu->accurate)
+        tick(cpu, 8); /* two internal M-cycles, the pushes are the third and fourth */
     cpu->sp--;
     mem_write(cpu->sp, (ret >> 8) & 0xFF); /* push the high byte */
+    if (cpu->accurate)
+        tick(cpu, 4);
     cpu->sp--;
     mem_write(cpu->sp, ret & 0xFF); /* push the low byte */
     cpu->pc = 0x0040 + (id * 8);    /* set the program counter to the interrupt vector */
-    tick(cpu, 20);
+    tick(cpu, cpu->accurate ? 8 : 20);
 }
 
 /* fetch-decode-execute cycle
@@ -108,7 +127,9 @@ static uint8_t fetch(CPU *cpu) {
     return opcode;
 }
 
-void cpu_step(CPU *cpu) {
+/* HALT and interrupt dispatch, only entered when interrupt_check says there is
+something to do (or always, on the reference path). false when the step is over */
+static bool handle_interrupts(CPU *cpu) {
     /* handle halt */
     if (cpu->halt == 1) {
         uint8_t flagged_and_enabled = cpu->ifr & cpu->ier & 0x1F;
@@ -116,34 +137,54 @@ void cpu_step(CPU *cpu) {
         if (flagged_and_enabled) {
             /* an interrupt is pending, so we exit HALT and service it if IME=1 */
             cpu->halt = 0;
+            cpu_update_interrupts(cpu);
             if (cpu->ime) {
                 interrupt_servicing_routine(cpu);
-                return;
+                return false;
             }
             /* if IME=0, we just exit HALT and continue execution */
         } else {
-            /* no interrupts pending - stay halted */
-            tick(cpu, 4);
-            return;
+            /* no interrupts pending - stay halted. nothing changes until the timer or
+            the PPU flags an interrupt, so keep ticking here until one does (or the
+            frame ends and the host gets to pace and present, or gb_run's budget runs out)
+            instead of coming back through the whole step every 4 cycles. the
+            reference path is one tick per step */
+            if (gb_reference) {
+                tick(cpu, 4);
+                return false;
+            }
+            do {
+                tick(cpu, 4);
+            } while (!(cpu->ifr & cpu->ier & 0x1F) && !cpu->ppu->frame_completed &&
+                     cpu->cycles < cpu->halt_until);
+            return false;
         }
     }
 
-    log_cpu_state(cpu); /* log the previous CPU state */
-
     /* acknowledge pending interrupts */
     if (cpu->ime && !cpu->dma_flag) {
         interrupt_servicing_routine(cpu);
     }
+    return true;
+}
+
+void cpu_step(CPU *cpu) {
+    if ((cpu->interrupt_check || gb_reference) && !handle_interrupts(cpu))
+        return;
+
+    /* trace the state the next instruction starts from. the dispatch above is not
+    an instruction of its own, so the handler's first one is traced at its vector,
+    the way gameboy-doctor's truth logs have it */
+    if (cpu_log)
+        log_cpu_state(cpu);
+    if (cpu_trace)
+        cpu_trace(cpu_trace_user, cpu);
 
     /* fetch the next instruction */
     uint8_t opcode = fetch(cpu);
-    decode_and_execute(cpu, opcode);
-
-    /* pass the signal to ime from the previous instruction
-    see https://gbdev.io/pandocs/Interrupts.html */
-    if (cpu->ime_delay) {
-        cpu->ime_delay--; /* 2 → 1   (during instr N+1 fetch) */
-        if (cpu->ime_delay == 0)
-            cpu->ime = 1; /* becomes 1 *after* instr N+1 exec */
-    }
+    if (cpu->accurate)
+        decode_and_execute_accurate(cpu, opcode);
+    else
+        decode_and_execute(cpu, opcode);
+    cpu_retire(cpu);
 }
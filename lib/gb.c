@@ -0,0 +1,88 @@
+#include "gb.h"
+
+#include <string.h>
+
+#include "recomp.h"
+
+void gb_init(GB *gb) {
+    memset(gb, 0, sizeof(*gb));
+
+    /* same order the frontend used to follow: the PPU reset goes through the MMU */
+    mmu_init(&gb->mmu, &gb->cpu, &gb->timer, &gb->ppu, &gb->joypad);
+    cpu_init(&gb->cpu, &gb->mmu, &gb->timer, &gb->ppu);
+    timer_init(&gb->timer, &gb->cpu, &gb->mmu);
+    ppu_init(&gb->ppu, &gb->mmu, &gb->cpu);
+    joypad_init(&gb->joypad, &gb->mmu, &gb->cpu);
+    apu_init(&gb->apu, &gb->cpu);
+    serial_init(&gb->serial, &gb->cpu);
+
+    /* the MMU and timer reach the APU and serial port only through gb_link */
+    gb_link(gb);
+
+    gb->breakpoint = -1;
+}
+
+void gb_link(GB *gb) {
+    gb->mmu.cpu    = &gb->cpu;
+    gb->mmu.timer  = &gb->timer;
+    gb->mmu.ppu    = &gb->ppu;
+    gb->mmu.joypad = &gb->joypad;
+    gb->mmu.apu    = &gb->apu;
+    gb->mmu.serial = &gb->serial;
+
+    gb->cpu.mmu    = &gb->mmu;
+    gb->cpu.timer  = &gb->timer;
+    gb->cpu.ppu    = &gb->ppu;
+
+    gb->timer.cpu    = &gb->cpu;
+    gb->timer.mmu    = &gb->mmu;
+    gb->timer.apu    = &gb->apu;
+    gb->timer.serial = &gb->serial;
+
+    gb->ppu.mmu    = &gb->mmu;
+    gb->ppu.cpu    = &gb->cpu;
+
+    gb->joypad.mmu = &gb->mmu;
+    gb->joypad.cpu = &gb->cpu;
+
+    gb->apu.cpu    = &gb->cpu;
+    gb->serial.cpu = &gb->cpu;
+}
+
+gb_stop_t gb_run(GB *gb, uint64_t cycles) {
+    CPU *cpu       = &gb->cpu;
+    uint64_t end   = cycles > UINT64_MAX - cpu->cycles ? UINT64_MAX : cpu->cycles + cycles;
+    gb_stop_t stop = GB_STOP_BUDGET;
+    Recomp *recomp = gb->recomp;
+
+    gb->ppu.frame_completed = 0;
+    gb->serial.completed    = false;
+    gb->serial.stop         = gb->serial_stop;
+    cpu->halt_until         = end;
+
+    /* a breakpoint is never -1 to a pc, so without one that test never passes. a
+    halted CPU has not reached the instruction at pc yet */
+    while (cpu->cycles < end) {
+        if (!recomp || !recomp_run(recomp, gb, end))
+            cpu_step(cpu);
+        if (gb->ppu.frame_completed) {
+            stop = GB_STOP_FRAME;
+            break;
+        }
+        if (cpu->pc == gb->breakpoint && !cpu->halt) {
+            stop = GB_STOP_BREAKPOINT;
+            break;
+        }
+        if (gb->serial.completed && gb->serial_stop) {
+            stop = GB_STOP_SERIAL;
+            break;
+        }
+    }
+
+    cpu->halt_until = UINT64_MAX;
+    return stop;
+}
+
+gb_stop_t gb_run_frame(GB *gb) {
+    return gb_run(gb, UINT64_MAX);
+}
@@ -0,0 +1,155 @@
+#include "link.h"
+
+#include <stdio.h>
+#include <string.h>
+
+/* both called with the lock held */
+static void post(link_port_t *to, uint64_t time, uint8_t byte, bool reply) {
+    if (to->count == LINK_INBOX_SIZE) {
+        fprintf(stderr, "Link cable inbox overflow, byte dropped\n");
+        return;
+    }
+    to->inbox[(to->head + to->count++) % LINK_INBOX_SIZE] =
+        (link_message_t){.time = time, .byte = byte, .reply = reply};
+}
+
+static void deliver(link_port_t *port, uint64_t now) {
+    link_port_t *other = &port->cable->port[!port->side];
+
+    while (port->count && port->inbox[port->head].time <= now) {
+        link_message_t m = port->inbox[port->head];
+        port->head       = (port->head + 1) % LINK_INBOX_SIZE;
+        port->count--;
+
+        if (m.reply) {
+            serial_reply(&port->gb->serial, m.byte);
+        } else {
+            uint8_t out = serial_receive(&port->gb->serial, m.byte,
+                                         LINK_LATENCY / SERIAL_BIT_CYCLES);
+            if (!other->closed)
+                post(other, now + LINK_LATENCY, out, true);
+        }
+    }
+}
+
+/* serial hook: a transfer started on this side's clock, called mid-instruction */
+static int link_transfer(void *user, uint8_t out) {
+    link_port_t *port  = user;
+    link_port_t *other = &port->cable->port[!port->side];
+    int in             = SERIAL_PENDING;
+
+    pthread_mutex_lock(&port->cable->lock);
+    if (other->closed)
+        in = 0xFF;
+    else
+        post(other, port->gb->cpu.cycles + LINK_LATENCY, out, false);
+    pthread_mutex_unlock(&port->cable->lock);
+    return in;
+}
+
+bool link_init(LinkCable *link, GB *a, GB *b) {
+    memset(link, 0, sizeof(*link));
+    if (pthread_mutex_init(&link->lock, NULL) != 0) {
+        fprintf(stderr, "Failed to create the link cable lock\n");
+        return false;
+    }
+    if (pthread_cond_init(&link->progress, NULL) != 0) {
+        fprintf(stderr, "Failed to create the link cable condition\n");
+        pthread_mutex_destroy(&link->lock);
+        return false;
+    }
+
+    GB *gbs[2] = {a, b};
+    for (int side = 0; side < 2; side++) {
+        link_port_t *port = &link->port[side];
+        port->gb          = gbs[side];
+        port->cable       = link;
+        port->side        = side;
+        port->time        = gbs[side]->cpu.cycles;
+        serial_connect(&gbs[side]->serial, link_transfer, port);
+    }
+    return true;
+}
+
+void link_free(LinkCable *link) {
+    for (int side = 0; side < 2; side++) {
+        serial_connect(&link->port[side].gb->serial, NULL, NULL);
+    }
+    pthread_cond_destroy(&link->progress);
+    pthread_mutex_destroy(&link->lock);
+}
+
+/* publish how far this side got, take what is due and wait while the other side
+could still send something due before the next instruction. returns the cycle
+this side may run up to before coming back */
+static uint64_t sync_port(link_port_t *port) {
+    LinkCable *link    = port->cable;
+    link_port_t *other = &link->port[!port->side];
+    uint64_t now       = port->gb->cpu.cycles;
+    uint64_t bound;
+
+    pthread_mutex_lock(&link->lock);
+    port->time = now;
+    pthread_cond_broadcast(&link->progress);
+
+    /* the other side can't post anything due before other->time + LINK_LATENCY */
+    for (;;) {
+        deliver(port, now);
+        bound = other->closed ? UINT64_MAX : other->time + LINK_LATENCY;
+        if (now < bound)
+            break;
+        pthread_cond_wait(&link->progress, &link->lock);
+    }
+
+    uint64_t end = now + LINK_QUANTUM;
+    if (bound < end)
+        end = bound;
+    if (port->count && port->inbox[port->head].time < end)
+        end = port->inbox[port->head].time;
+    pthread_mutex_unlock(&link->lock);
+    return end;
+}
+
+/* instructions only start before the bound sync_port gives, so every message is
+taken at the first instruction boundary at or after its time */
+static void run(LinkCable *link, int side, uint64_t until, bool frame) {
+    link_port_t *port = &link->port[side];
+    GB *gb            = port->gb;
+
+    while (gb->cpu.cycles < until) {
+        uint64_t end = sync_port(port);
+        if (end > until)
+            end = until;
+        while (gb->cpu.cycles < end) {
+            if (gb_run(gb, end - gb->cpu.cycles) == GB_STOP_FRAME && frame)
+                return;
+        }
+    }
+}
+
+void link_run_frame(LinkCable *link, int side) {
+    run(link, side, UINT64_MAX, true);
+}
+
+void link_run_cycles(LinkCable *link, int side, uint64_t cycles) {
+    run(link, side, link->port[side].gb->cpu.cycles + cycles, false);
+}
+
+void link_close(LinkCable *link, int side) {
+    link_port_t *port  = &link->port[side];
+    link_port_t *other = &link->port[!side];
+
+    pthread_mutex_lock(&link->lock);
+    port->closed = true;
+
+    /* transfers this side never got to are answered by an empty cable */
+    while (port->count) {
+        link_message_t m = port->inbox[port->head];
+        port->head       = (port->head + 1) % LINK_INBOX_SIZE;
+        port->count--;
+        if (!m.reply && !other->closed)
+            post(other, m.time + LINK_LATENCY, 0xFF, true);
+    }
+    pthread_cond_broadcast(&link->progress);
+    pthread_mutex_unlock(&link->lock);
+}
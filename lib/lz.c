@@ -0,0 +1,160 @@
+#include "lz.h"
+
+#include <stdint.h>
+#include <string.h>
+
+#define LZ_MIN_MATCH 4
+#define LZ_MAX_OFFSET 0xFFFF
+#define LZ_HASH_BITS 12
+
+static inline uint32_t read32(const uint8_t *p) {
+    uint32_t v;
+    memcpy(&v, p, sizeof(v));
+    return v;
+}
+
+static inline uint32_t hash4(const uint8_t *p) {
+    return (read32(p) * 2654435761u) >> (32 - LZ_HASH_BITS);
+}
+
+/* write a length that did not fit in its nibble: 255, 255, ..., rest */
+static uint8_t *put_length(uint8_t *op, const uint8_t *oend, size_t len) {
+    while (len >= 255) {
+        if (op >= oend)
+            return NULL;
+        *op++ = 255;
+        len -= 255;
+    }
+    if (op >= oend)
+        return NULL;
+    *op++ = (uint8_t)len;
+    return op;
+}
+
+static uint8_t *put_sequence(uint8_t *op, const uint8_t *oend, const uint8_t *lit, size_t lit_len,
+                             size_t match_len, uint16_t offset, bool last) {
+    if (op >= oend)
+        return NULL;
+
+    uint8_t *token = op++;
+    size_t ml      = last ? 0 : match_len - LZ_MIN_MATCH;
+    *token         = (uint8_t)(((lit_len < 15 ? lit_len : 15) << 4) | (ml < 15 ? ml : 15));
+
+    if (lit_len >= 15 && !(op = put_length(op, oend, lit_len - 15)))
+        return NULL;
+    if ((size_t)(oend - op) < lit_len)
+        return NULL;
+    memcpy(op, lit, lit_len);
+    op += lit_len;
+
+    if (last)
+        return op;
+
+    if (oend - op < 2)
+        return NULL;
+    *op++ = offset & 0xFF;
+    *op++ = offset >> 8;
+
+    if (ml >= 15 && !(op = put_length(op, oend, ml - 15)))
+        return NULL;
+    return op;
+}
+
+size_t lz_compress_bound(size_t n) { return n + n / 255 + 16; }
+
+size_t lz_compress(const uint8_t *src, size_t n, uint8_t *dst, size_t cap) {
+    uint32_t table[1 << LZ_HASH_BITS];  // last position seen for each hash
+    memset(table, 0xFF, sizeof(table));
+
+    const uint8_t *anchor = src;  // start of pending literals
+    const uint8_t *ip     = src;
+    const uint8_t *iend   = src + n;
+    uint8_t *op           = dst;
+    const uint8_t *oend   = dst + cap;
+
+    while (n >= LZ_MIN_MATCH && ip <= iend - LZ_MIN_MATCH) {
+        uint32_t h         = hash4(ip);
+        uint32_t candidate = table[h];
+        table[h]           = (uint32_t)(ip - src);
+
+        if (candidate == UINT32_MAX || (ip - src) - candidate > LZ_MAX_OFFSET ||
+            read32(src + candidate) != read32(ip)) {
+            ip++;
+            continue;
+        }
+
+        /* extend the match as far as it goes */
+        const uint8_t *match = src + candidate;
+        size_t len           = LZ_MIN_MATCH;
+        while (ip + len < iend && match[len] == ip[len])
+            len++;
+
+        op = put_sequence(op, oend, anchor, ip - anchor, len, (uint16_t)(ip - match), false);
+        if (!op)
+            return 0;
+
+        ip += len;
+        anchor = ip;
+    }
+
+    /* the block always ends with a literal-only sequence */
+    op = put_sequence(op, oend, anchor, iend - anchor, 0, 0, true);
+    return op ? (size_t)(op - dst) : 0;
+}
+
+/* read the rest of a length that maxed out its nibble */
+static bool get_length(const uint8_t **ip, const uint8_t *iend, size_t *len) {
+    uint8_t b;
+    do {
+        if (*ip >= iend)
+            return false;
+        b = *(*ip)++;
+        *len += b;
+    } while (b == 255);
+    return true;
+}
+
+bool lz_decompress(const uint8_t *src, size_t n, uint8_t *dst, size_t out_n) {
+    const uint8_t *ip   = src;
+    const uint8_t *iend = src + n;
+    uint8_t *op         = dst;
+    uint8_t *oend       = dst + out_n;
+
+    while (ip < iend) {
+        uint8_t token  = *ip++;
+
+        /* literals */
+        size_t lit_len = token >> 4;
+        if (lit_len == 15 && !get_length(&ip, iend, &lit_len))
+            return false;
+        if ((size_t)(iend - ip) < lit_len || (size_t)(oend - op) < lit_len)
+            return false;
+        memcpy(op, ip, lit_len);
+        ip += lit_len;
+        op += lit_len;
+
+        if (ip == iend)
+            break;  // final sequence has no match
+
+        /* match */
+        if (iend - ip < 2)
+            return false;
+        size_t offset = ip[0] | (ip[1] << 8);
+        ip += 2;
+
+        size_t len = token & 0x0F;
+        if (len == 15 && !get_length(&ip, iend, &len))
+            return false;
+        len += LZ_MIN_MATCH;
+
+        if (offset == 0 || offset > (size_t)(op - dst) || (size_t)(oend - op) < len)
+            return false;
+
+        /* byte by byte: matches may overlap their own output (runs) */
+        const uint8_t *match = op - offset;
+        while (len--)
+            *op++ = *match++;
+    }
+
+    return op == oend;
+}
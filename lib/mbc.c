@@ -144,30 +144,29 @@ uint8_t mbc_get_current_ram_bank(MBC *mbc) {
     }
 }
 
-uint8_t mbc_read_rom(MBC *mbc, struct MMU *mmu, uint16_t addr) {
-    uint32_t physical_addr;
-
+uint32_t mbc_rom_offset(MBC *mbc, uint16_t addr) {
     if (addr < 0x4000) {
         // bank 0 area (0x0000-0x3FFF)
         if (mbc->type == MBC1 || mbc->type == MBC1_RAM || mbc->type == MBC1_RAM_BAT) {
             if (mbc->mbc1_mode == MBC1_MODE_4_32) {
                 // in mode 1, this area can be banked with upper bits
-                uint8_t bank  = (mbc->rom_bank_high & 0x03) << 5;
-                physical_addr = (bank * 0x4000) + addr;
-            } else {
-                // Mode 0: always bank 0
-                physical_addr = addr;
+                uint8_t bank = (mbc->rom_bank_high & 0x03) << 5;
+                return (bank * 0x4000) + addr;
             }
-        } else {
-            // no MBC: direct access
-            physical_addr = addr;
+            // Mode 0: always bank 0
         }
-    } else {
-        // switchable bank area (0x4000-0x7FFF)
-        uint8_t bank  = mbc_get_current_rom_bank(mbc);
-        physical_addr = (bank * 0x4000) + (addr - 0x4000);
+        // no MBC: direct access
+        return addr;
     }
 
+    // switchable bank area (0x4000-0x7FFF)
+    uint8_t bank = mbc_get_current_rom_bank(mbc);
+    return (bank * 0x4000) + (addr - 0x4000);
+}
+
+uint8_t mbc_read_rom(MBC *mbc, struct MMU *mmu, uint16_t addr) {
+    uint32_t physical_addr = mbc_rom_offset(mbc, addr);
+
     // bounds check
     if (physical_addr >= mmu->cartridge_rom_size) {
         return 0xFF;  // return 0xFF for out-of-bounds reads
@@ -296,6 +295,7 @@ void mbc_write_ram(MBC *mbc, struct MMU *mmu, uint16_t addr, uint8_t value) {
         uint16_t offset = (addr - 0xA000) & 0x01FF;  // 512 bytes, 9 bits
         if (offset < 512 && offset < mmu->cartridge_ram_size) {
             mmu->cartridge_ram[offset] = value & 0x0F;  // MBC2 uses lower 4 bits
+            mmu_mark_dirty(mmu, MMU_PAGE_ERAM + (offset >> MMU_PAGE_SHIFT));
         }
         return;
     }
@@ -323,6 +323,7 @@ void mbc_write_ram(MBC *mbc, struct MMU *mmu, uint16_t addr, uint8_t value) {
     }
 
     mmu->cartridge_ram[physical_addr] = value;
+    mmu_mark_dirty(mmu, MMU_PAGE_ERAM + (physical_addr >> MMU_PAGE_SHIFT));
 }
 
 void mbc_update_rtc(MBC *mbc) {
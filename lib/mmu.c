@@ -5,8 +5,10 @@
 #include <stdlib.h>
 #include <string.h>
 
+#include "apu.h"
 #include "cpu.h"
 #include "joyp.h"
+#include "serial.h"
 
 void mmu_init(MMU *mmu, struct CPU *cpu, struct Timer *timer, struct PPU *ppu,
               struct Joypad *joypad) {
@@ -82,14 +84,19 @@ uint8_t mmu_read(MMU *mmu, uint16_t addr) {
     } else if (addr < 0xFF00) {
         return 0xFF; /* prohibited area */
     } else if (addr < 0xFF80) {
+        if (addr >= NR10 && addr < NR10 + APU_REGS_SIZE) {
+            return apu_read(mmu->apu, addr); /* sound registers and wave RAM */
+        }
         switch (addr) {
             case JOYP:   return joypad_read(mmu->joypad);      /* JOYP register */
+            case SB:     return mmu->serial->sb;               /* serial data */
+            case SC:     return serial_read_sc(mmu->serial);   /* serial control */
             case DIV:    return mmu->timer->div >> 8;          /* DIV register */
             case TIMA:   return mmu->timer->tima;              /* TIMA register */
             case TMA:    return mmu->timer->tma;               /* TMA register */
             case TAC:    return mmu->timer->tac;               /* TAC register */
             case IF:     return (mmu->cpu->ifr & 0x1F) | 0xE0; /* IFR register */
-            case LY:     return mmu->ppu->current_scanline;    /* LY register */
+            case LY:     return mmu->ly_stub ? 0x90 : mmu->ppu->current_scanline; /* LY register */
             case STAT:   return (mmu->io[0x41] & 0xF8) | (mmu->ppu->mode & 0x03); /* STAT register */
             case 0xFF4D: /* undocumented read */
             case 0xFF56: return 0xFF;
@@ -109,6 +116,14 @@ uint16_t mmu_read16(MMU *mmu, uint16_t addr) {
     return (high << 8) | low;               /* combine the two bytes */
 }
 
+uint32_t mmu_rom_offset(MMU *mmu, uint16_t addr) {
+    if (addr >= 0x8000 || !mmu->cartridge_rom || (mmu->boot_rom_enabled && addr < 0x0100))
+        return MMU_NOT_ROM;
+
+    uint32_t offset = mbc_rom_offset(&mmu->mbc, addr);
+    return offset < mmu->cartridge_rom_size ? offset : MMU_NOT_ROM;
+}
+
 void mmu_write(MMU *mmu, uint16_t addr, uint8_t value) {
     if (addr < 0x8000) {
         /* ROM area - handle MBC control writes */
@@ -116,6 +131,7 @@ void mmu_write(MMU *mmu, uint16_t addr, uint8_t value) {
         return;
     } else if (addr < 0xA000) {
         mmu->vram[addr - 0x8000] = value; /* write to VRAM */
+        mmu_mark_dirty(mmu, MMU_PAGE_VRAM + ((addr - 0x8000) >> MMU_PAGE_SHIFT));
         return;
     } else if (addr < 0xC000) {
         /* external RAM area - use MBC for bank switching */
@@ -124,28 +140,41 @@ void mmu_write(MMU *mmu, uint16_t addr, uint8_t value) {
         } else {
             /* fallback to legacy ERAM */
             mmu->eram[addr - 0xA000] = value;
+            mmu_mark_dirty(mmu, MMU_PAGE_ERAM + ((addr - 0xA000) >> MMU_PAGE_SHIFT));
         }
         return;
     } else if (addr < 0xE000) {
         mmu->wram[addr - 0xC000] = value; /* write to WRAM */
+        mmu_mark_dirty(mmu, MMU_PAGE_WRAM + ((addr - 0xC000) >> MMU_PAGE_SHIFT));
         return;
     } else if (addr < 0xFE00) {
         mmu->wram[addr - 0xE000] = value; /* write to WRAM */
+        mmu_mark_dirty(mmu, MMU_PAGE_WRAM + ((addr - 0xE000) >> MMU_PAGE_SHIFT));
         return;
     } else if (addr < 0xFEA0) {
         mmu->oam[addr - 0xFE00] = value; /* write to OAM */
+        mmu_mark_dirty(mmu, MMU_PAGE_OAM);
         return;
     } else if (addr < 0xFF00) {
         return; /* prohibited area */
     } else if (addr < 0xFF80) {
+        if (addr >= NR10 && addr < NR10 + APU_REGS_SIZE) {
+            apu_write(mmu->apu, addr, value); /* sound registers and wave RAM */
+            return;
+        }
         switch (addr) {
             case JOYP: joypad_write(mmu->joypad, value); break;    /* JOYP register */
+            case SB:   mmu->serial->sb = value; break;             /* serial data */
+            case SC:   serial_write_sc(mmu->serial, value); break; /* serial control */
             case DIV:  timer_write_div(mmu->timer); break;         /* reset the DIV register */
             case TIMA: timer_write_tima(mmu->timer, value); break; /* TIMA register */
             case TMA:  timer_write_tma(mmu->timer, value); break;  /* TMA register */
             case TAC:  timer_write_tac(mmu->timer, value); break;  /* TAC register */
             case DMA:  ppu_dma_transfer(mmu->ppu, value); break;   /* DMA transfer */
-            case IF:   mmu->cpu->ifr = value & 0x1F; break;          /* IFR register */
+            case IF: /* IFR register */
+                mmu->cpu->ifr = value & 0x1F;
+                cpu_update_interrupts(mmu->cpu);
+                break;
             case BOOT:
                 if (value & 0x01) {
                     mmu->boot_rom_enabled = false;
@@ -156,9 +185,11 @@ void mmu_write(MMU *mmu, uint16_t addr, uint8_t value) {
         return;
     } else if (addr < IE) {
         mmu->hram[addr - 0xFF80] = value; /* write to HRAM */
+        mmu_mark_dirty(mmu, MMU_PAGE_HRAM);
         return;
     } else if (addr == IE) {
         mmu->cpu->ier = value & 0x1F; /* write to IER register */
+        cpu_update_interrupts(mmu->cpu);
     }
 }
 
@@ -167,6 +198,55 @@ void mmu_write16(MMU *mmu, uint16_t addr, uint16_t value) {
     mmu_write(mmu, addr + 1, (value >> 8)); /* write the high byte */
 }
 
+uint8_t *mmu_ext_ram(const MMU *mmu) {
+    return mmu->cartridge_ram ? mmu->cartridge_ram : (uint8_t *)mmu->eram;
+}
+
+uint32_t mmu_ext_ram_size(const MMU *mmu) {
+    return mmu->cartridge_ram ? mmu->cartridge_ram_size : (uint32_t)sizeof(mmu->eram);
+}
+
+uint8_t *mmu_page(MMU *mmu, int page) {
+    if (mmu_page_size(mmu, page) == 0)
+        return NULL;
+
+    if (page < MMU_PAGE_WRAM)
+        return mmu->vram + ((page - MMU_PAGE_VRAM) << MMU_PAGE_SHIFT);
+    if (page < MMU_PAGE_OAM)
+        return mmu->wram + ((page - MMU_PAGE_WRAM) << MMU_PAGE_SHIFT);
+    if (page == MMU_PAGE_OAM)
+        return mmu->oam;
+    if (page == MMU_PAGE_HRAM)
+        return mmu->hram;
+    return mmu_ext_ram(mmu) + ((page - MMU_PAGE_ERAM) << MMU_PAGE_SHIFT);
+}
+
+size_t mmu_page_size(const MMU *mmu, int page) {
+    if (page < 0 || page >= MMU_PAGE_COUNT)
+        return 0;
+    if (page == MMU_PAGE_OAM)
+        return sizeof(mmu->oam);
+    if (page == MMU_PAGE_HRAM)
+        return sizeof(mmu->hram);
+    if (page < MMU_PAGE_ERAM)
+        return MMU_PAGE_SIZE;
+
+    /* external RAM: MBC2 has only 512 bytes, so the last page may be partial */
+    size_t offset = (size_t)(page - MMU_PAGE_ERAM) << MMU_PAGE_SHIFT;
+    size_t size   = mmu_ext_ram_size(mmu);
+    if (offset >= size)
+        return 0;
+    return (size - offset < MMU_PAGE_SIZE) ? size - offset : MMU_PAGE_SIZE;
+}
+
+void mmu_mark_all_dirty(MMU *mmu) {
+    if (!mmu->dirty_mask)
+        return;
+    for (int page = 0; page < MMU_PAGE_COUNT; page++) {
+        mmu->dirty[page] |= mmu->dirty_mask;
+    }
+}
+
 /* helper function to free dynamically allocated cartridge memory */
 void mmu_cleanup(MMU *mmu) {
     if (mmu->cartridge_rom) {
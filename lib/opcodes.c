@@ -6,6 +6,20 @@
 #include <stdio.h>
 #include <string.h>
 
+/* external definitions of the inline helpers in opcodes.h, for calls the compiler
+chooses not to inline (C99 inline semantics). the accurate tier only needs its own
+copies of the ones that touch the bus */
+#ifndef OPCODES_ACCURATE
+extern inline void advance_pc(CPU *cpu, uint8_t n);
+extern inline uint8_t high_byte(uint16_t val);
+extern inline uint8_t low_byte(uint16_t val);
+extern inline int get_flag(CPU *cpu, uint8_t flag);
+extern inline void set_flag(CPU *cpu, uint8_t flag, int enable);
+extern inline void add_i8_to_u16(uint16_t sp, int8_t off, uint16_t *out, CPU *cpu);
+#endif
+extern inline void call_u16(CPU *cpu);
+extern inline void ret(CPU *cpu);
+
 /* function to log CPU errors with useful information */
 static void log_cpu_error(CPU *cpu, const char *format, ...) {
     va_list args;
@@ -588,10 +602,274 @@ DEF_SET_U3_R8(0xff, 7, a) /* SET 7, A */
 
 /* ----  control/misc ---- */
 DEF_IMPLIED(0x00, nop, /* nothing */, 4)
-DEF_IMPLIED(0xf3, di, cpu->ime = cpu->ime_delay = 0;, 4)
+DEF_IMPLIED(0xf3, di, cpu->ime = cpu->ime_delay = 0; cpu_update_interrupts(cpu);, 4)
 DEF_IMPLIED(0xfb, ei, cpu->ime_delay = 2;, 4)
 DEF_HALT(0x76)
 
+/* the second byte of a CB-prefixed instruction. always inlined, so the interpreter
+keeps the single switch it had before this was split out */
+static inline __attribute__((always_inline)) void decode_cb(CPU *cpu, uint8_t op) {
+    switch (op) {
+        case 0x00: op_0x00_rlc_b(cpu); break;
+        case 0x01: op_0x01_rlc_c(cpu); break;
+        case 0x02: op_0x02_rlc_d(cpu); break;
+        case 0x03: op_0x03_rlc_e(cpu); break;
+        case 0x04: op_0x04_rlc_h(cpu); break;
+        case 0x05: op_0x05_rlc_l(cpu); break;
+        case 0x06: op_0x06_rlc_hlptr(cpu); break;
+        case 0x07: op_0x07_rlc_a(cpu); break;
+        case 0x08: op_0x08_rrc_b(cpu); break;
+        case 0x09: op_0x09_rrc_c(cpu); break;
+        case 0x0A: op_0x0a_rrc_d(cpu); break;
+        case 0x0B: op_0x0b_rrc_e(cpu); break;
+        case 0x0C: op_0x0c_rrc_h(cpu); break;
+        case 0x0D: op_0x0d_rrc_l(cpu); break;
+        case 0x0E: op_0x0e_rrc_hlptr(cpu); break;
+        case 0x0F: op_0x0f_rrc_a(cpu); break;
+        case 0x10: op_0x10_rl_b(cpu); break;
+        case 0x11: op_0x11_rl_c(cpu); break;
+        case 0x12: op_0x12_rl_d(cpu); break;
+        case 0x13: op_0x13_rl_e(cpu); break;
+        case 0x14: op_0x14_rl_h(cpu); break;
+        case 0x15: op_0x15_rl_l(cpu); break;
+        case 0x16: op_0x16_rl_hlptr(cpu); break;
+        case 0x17: op_0x17_rl_a(cpu); break;
+        case 0x18: op_0x18_rr_b(cpu); break;
+        case 0x19: op_0x19_rr_c(cpu); break;
+        case 0x1A: op_0x1a_rr_d(cpu); break;
+        case 0x1B: op_0x1b_rr_e(cpu); break;
+        case 0x1C: op_0x1c_rr_h(cpu); break;
+        case 0x1D: op_0x1d_rr_l(cpu); break;
+        case 0x1E: op_0x1e_rr_hlptr(cpu); break;
+        case 0x1F: op_0x1f_rr_a(cpu); break;
+        case 0x20: op_0x20_sla_b(cpu); break;
+        case 0x21: op_0x21_sla_c(cpu); break;
+        case 0x22: op_0x22_sla_d(cpu); break;
+        case 0x23: op_0x23_sla_e(cpu); break;
+        case 0x24: op_0x24_sla_h(cpu); break;
+        case 0x25: op_0x25_sla_l(cpu); break;
+        case 0x26: op_0x26_sla_hlptr(cpu); break;
+        case 0x27: op_0x27_sla_a(cpu); break;
+        case 0x28: op_0x28_sra_b(cpu); break;
+        case 0x29: op_0x29_sra_c(cpu); break;
+        case 0x2A: op_0x2a_sra_d(cpu); break;
+        case 0x2B: op_0x2b_sra_e(cpu); break;
+        case 0x2C: op_0x2c_sra_h(cpu); break;
+        case 0x2D: op_0x2d_sra_l(cpu); break;
+        case 0x2E: op_0x2e_sra_hlptr(cpu); break;
+        case 0x2F: op_0x2f_sra_a(cpu); break;
+        case 0x30: op_0x30_swap_b(cpu); break;
+        case 0x31: op_0x31_swap_c(cpu); break;
+        case 0x32: op_0x32_swap_d(cpu); break;
+        case 0x33: op_0x33_swap_e(cpu); break;
+        case 0x34: op_0x34_swap_h(cpu); break;
+        case 0x35: op_0x35_swap_l(cpu); break;
+        case 0x36: op_0x36_swap_hlptr(cpu); break;
+        case 0x37: op_0x37_swap_a(cpu); break;
+        case 0x38: op_0x38_srl_b(cpu); break;
+        case 0x39: op_0x39_srl_c(cpu); break;
+        case 0x3A: op_0x3a_srl_d(cpu); break;
+        case 0x3B: op_0x3b_srl_e(cpu); break;
+        case 0x3C: op_0x3c_srl_h(cpu); break;
+        case 0x3D: op_0x3d_srl_l(cpu); break;
+        case 0x3E: op_0x3e_srl_hlptr(cpu); break;
+        case 0x3F: op_0x3f_srl_a(cpu); break;
+        case 0x40: op_0x40_bit_0_b(cpu); break;
+        case 0x41: op_0x41_bit_0_c(cpu); break;
+        case 0x42: op_0x42_bit_0_d(cpu); break;
+        case 0x43: op_0x43_bit_0_e(cpu); break;
+        case 0x44: op_0x44_bit_0_h(cpu); break;
+        case 0x45: op_0x45_bit_0_l(cpu); break;
+        case 0x46: op_0x46_bit_0_hlptr(cpu); break;
+        case 0x47: op_0x47_bit_0_a(cpu); break;
+        case 0x48: op_0x48_bit_1_b(cpu); break;
+        case 0x49: op_0x49_bit_1_c(cpu); break;
+        case 0x4A: op_0x4a_bit_1_d(cpu); break;
+        case 0x4B: op_0x4b_bit_1_e(cpu); break;
+        case 0x4C: op_0x4c_bit_1_h(cpu); break;
+        case 0x4D: op_0x4d_bit_1_l(cpu); break;
+        case 0x4E: op_0x4e_bit_1_hlptr(cpu); break;
+        case 0x4F: op_0x4f_bit_1_a(cpu); break;
+        case 0x50: op_0x50_bit_2_b(cpu); break;
+        case 0x51: op_0x51_bit_2_c(cpu); break;
+        case 0x52: op_0x52_bit_2_d(cpu); break;
+        case 0x53: op_0x53_bit_2_e(cpu); break;
+        case 0x54: op_0x54_bit_2_h(cpu); break;
+        case 0x55: op_0x55_bit_2_l(cpu); break;
+        case 0x56: op_0x56_bit_2_hlptr(cpu); break;
+        case 0x57: op_0x57_bit_2_a(cpu); break;
+        case 0x58: op_0x58_bit_3_b(cpu); break;
+        case 0x59: op_0x59_bit_3_c(cpu); break;
+        case 0x5A: op_0x5a_bit_3_d(cpu); break;
+        case 0x5B: op_0x5b_bit_3_e(cpu); break;
+        case 0x5C: op_0x5c_bit_3_h(cpu); break;
+        case 0x5D: op_0x5d_bit_3_l(cpu); break;
+        case 0x5E: op_0x5e_bit_3_hlptr(cpu); break;
+        case 0x5F: op_0x5f_bit_3_a(cpu); break;
+        case 0x60: op_0x60_bit_4_b(cpu); break;
+        case 0x61: op_0x61_bit_4_c(cpu); break;
+        case 0x62: op_0x62_bit_4_d(cpu); break;
+        case 0x63: op_0x63_bit_4_e(cpu); break;
+        case 0x64: op_0x64_bit_4_h(cpu); break;
+        case 0x65: op_0x65_bit_4_l(cpu); break;
+        case 0x66: op_0x66_bit_4_hlptr(cpu); break;
+        case 0x67: op_0x67_bit_4_a(cpu); break;
+        case 0x68: op_0x68_bit_5_b(cpu); break;
+        case 0x69: op_0x69_bit_5_c(cpu); break;
+        case 0x6A: op_0x6a_bit_5_d(cpu); break;
+        case 0x6B: op_0x6b_bit_5_e(cpu); break;
+        case 0x6C: op_0x6c_bit_5_h(cpu); break;
+        case 0x6D: op_0x6d_bit_5_l(cpu); break;
+        case 0x6E: op_0x6e_bit_5_hlptr(cpu); break;
+        case 0x6F: op_0x6f_bit_5_a(cpu); break;
+        case 0x70: op_0x70_bit_6_b(cpu); break;
+        case 0x71: op_0x71_bit_6_c(cpu); break;
+        case 0x72: op_0x72_bit_6_d(cpu); break;
+        case 0x73: op_0x73_bit_6_e(cpu); break;
+        case 0x74: op_0x74_bit_6_h(cpu); break;
+        case 0x75: op_0x75_bit_6_l(cpu); break;
+        case 0x76: op_0x76_bit_6_hlptr(cpu); break;
+        case 0x77: op_0x77_bit_6_a(cpu); break;
+        case 0x78: op_0x78_bit_7_b(cpu); break;
+        case 0x79: op_0x79_bit_7_c(cpu); break;
+        case 0x7A: op_0x7a_bit_7_d(cpu); break;
+        case 0x7B: op_0x7b_bit_7_e(cpu); break;
+        case 0x7C: op_0x7c_bit_7_h(cpu); break;
+        case 0x7D: op_0x7d_bit_7_l(cpu); break;
+        case 0x7E: op_0x7e_bit_7_hlptr(cpu); break;
+        case 0x7F: op_0x7f_bit_7_a(cpu); break;
+        case 0x80: op_0x80_res_0_b(cpu); break;
+        case 0x81: op_0x81_res_0_c(cpu); break;
+        case 0x82: op_0x82_res_0_d(cpu); break;
+        case 0x83: op_0x83_res_0_e(cpu); break;
+        case 0x84: op_0x84_res_0_h(cpu); break;
+        case 0x85: op_0x85_res_0_l(cpu); break;
+        case 0x86: op_0x86_res_0_hlptr(cpu); break;
+        case 0x87: op_0x87_res_0_a(cpu); break;
+        case 0x88: op_0x88_res_1_b(cpu); break;
+        case 0x89: op_0x89_res_1_c(cpu); break;
+        case 0x8A: op_0x8a_res_1_d(cpu); break;
+        case 0x8B: op_0x8b_res_1_e(cpu); break;
+        case 0x8C: op_0x8c_res_1_h(cpu); break;
+        case 0x8D: op_0x8d_res_1_l(cpu); break;
+        case 0x8E: op_0x8e_res_1_hlptr(cpu); break;
+        case 0x8F: op_0x8f_res_1_a(cpu); break;
+        case 0x90: op_0x90_res_2_b(cpu); break;
+        case 0x91: op_0x91_res_2_c(cpu); break;
+        case 0x92: op_0x92_res_2_d(cpu); break;
+        case 0x93: op_0x93_res_2_e(cpu); break;
+        case 0x94: op_0x94_res_2_h(cpu); break;
+        case 0x95: op_0x95_res_2_l(cpu); break;
+        case 0x96: op_0x96_res_2_hlptr(cpu); break;
+        case 0x97: op_0x97_res_2_a(cpu); break;
+        case 0x98: op_0x98_res_3_b(cpu); break;
+        case 0x99: op_0x99_res_3_c(cpu); break;
+        case 0x9A: op_0x9a_res_3_d(cpu); break;
+        case 0x9B: op_0x9b_res_3_e(cpu); break;
+        case 0x9C: op_0x9c_res_3_h(cpu); break;
+        case 0x9D: op_0x9d_res_3_l(cpu); break;
+        case 0x9E: op_0x9e_res_3_hlptr(cpu); break;
+        case 0x9F: op_0x9f_res_3_a(cpu); break;
+        case 0xA0: op_0xa0_res_4_b(cpu); break;
+        case 0xA1: op_0xa1_res_4_c(cpu); break;
+        case 0xA2: op_0xa2_res_4_d(cpu); break;
+        case 0xA3: op_0xa3_res_4_e(cpu); break;
+        case 0xA4: op_0xa4_res_4_h(cpu); break;
+        case 0xA5: op_0xa5_res_4_l(cpu); break;
+        case 0xA6: op_0xa6_res_4_hlptr(cpu); break;
+        case 0xA7: op_0xa7_res_4_a(cpu); break;
+        case 0xA8: op_0xa8_res_5_b(cpu); break;
+        case 0xA9: op_0xa9_res_5_c(cpu); break;
+        case 0xAA: op_0xaa_res_5_d(cpu); break;
+        case 0xAB: op_0xab_res_5_e(cpu); break;
+        case 0xAC: op_0xac_res_5_h(cpu); break;
+        case 0xAD: op_0xad_res_5_l(cpu); break;
+        case 0xAE: op_0xae_res_5_hlptr(cpu); break;
+        case 0xAF: op_0xaf_res_5_a(cpu); break;
+        case 0xB0: op_0xb0_res_6_b(cpu); break;
+        case 0xB1: op_0xb1_res_6_c(cpu); break;
+        case 0xB2: op_0xb2_res_6_d(cpu); break;
+        case 0xB3: op_0xb3_res_6_e(cpu); break;
+        case 0xB4: op_0xb4_res_6_h(cpu); break;
+        case 0xB5: op_0xb5_res_6_l(cpu); break;
+        case 0xB6: op_0xb6_res_6_hlptr(cpu); break;
+        case 0xB7: op_0xb7_res_6_a(cpu); break;
+        case 0xB8: op_0xb8_res_7_b(cpu); break;
+        case 0xB9: op_0xb9_res_7_c(cpu); break;
+        case 0xBA: op_0xba_res_7_d(cpu); break;
+        case 0xBB: op_0xbb_res_7_e(cpu); break;
+        case 0xBC: op_0xbc_res_7_h(cpu); break;
+        case 0xBD: op_0xbd_res_7_l(cpu); break;
+        case 0xBE: op_0xbe_res_7_hlptr(cpu); break;
+        case 0xBF: op_0xbf_res_7_a(cpu); break;
+        case 0xC0: op_0xc0_set_0_b(cpu); break;
+        case 0xC1: op_0xc1_set_0_c(cpu); break;
+        case 0xC2: op_0xc2_set_0_d(cpu); break;
+        case 0xC3: op_0xc3_set_0_e(cpu); break;
+        case 0xC4: op_0xc4_set_0_h(cpu); break;
+        case 0xC5: op_0xc5_set_0_l(cpu); break;
+        case 0xC6: op_0xc6_set_0_hlptr(cpu); break;
+        case 0xC7: op_0xc7_set_0_a(cpu); break;
+        case 0xC8: op_0xc8_set_1_b(cpu); break;
+        case 0xC9: op_0xc9_set_1_c(cpu); break;
+        case 0xCA: op_0xca_set_1_d(cpu); break;
+        case 0xCB: op_0xcb_set_1_e(cpu); break;
+        case 0xCC: op_0xcc_set_1_h(cpu); break;
+        case 0xCD: op_0xcd_set_1_l(cpu); break;
+        case 0xCE: op_0xce_set_1_hlptr(cpu); break;
+        case 0xCF: op_0xcf_set_1_a(cpu); break;
+        case 0xD0: op_0xd0_set_2_b(cpu); break;
+        case 0xD1: op_0xd1_set_2_c(cpu); break;
+        case 0xD2: op_0xd2_set_2_d(cpu); break;
+        case 0xD3: op_0xd3_set_2_e(cpu); break;
+        case 0xD4: op_0xd4_set_2_h(cpu); break;
+        case 0xD5: op_0xd5_set_2_l(cpu); break;
+        case 0xD6: op_0xd6_set_2_hlptr(cpu); break;
+        case 0xD7: op_0xd7_set_2_a(cpu); break;
+        case 0xD8: op_0xd8_set_3_b(cpu); break;
+        case 0xD9: op_0xd9_set_3_c(cpu); break;
+        case 0xDA: op_0xda_set_3_d(cpu); break;
+        case 0xDB: op_0xdb_set_3_e(cpu); break;
+        case 0xDC: op_0xdc_set_3_h(cpu); break;
+        case 0xDD: op_0xdd_set_3_l(cpu); break;
+        case 0xDE: op_0xde_set_3_hlptr(cpu); break;
+        case 0xDF: op_0xdf_set_3_a(cpu); break;
+        case 0xE0: op_0xe0_set_4_b(cpu); break;
+        case 0xE1: op_0xe1_set_4_c(cpu); break;
+        case 0xE2: op_0xe2_set_4_d(cpu); break;
+        case 0xE3: op_0xe3_set_4_e(cpu); break;
+        case 0xE4: op_0xe4_set_4_h(cpu); break;
+        case 0xE5: op_0xe5_set_4_l(cpu); break;
+        case 0xE6: op_0xe6_set_4_hlptr(cpu); break;
+        case 0xE7: op_0xe7_set_4_a(cpu); break;
+        case 0xE8: op_0xe8_set_5_b(cpu); break;
+        case 0xE9: op_0xe9_set_5_c(cpu); break;
+        case 0xEA: op_0xea_set_5_d(cpu); break;
+        case 0xEB: op_0xeb_set_5_e(cpu); break;
+        case 0xEC: op_0xec_set_5_h(cpu); break;
+        case 0xED: op_0xed_set_5_l(cpu); break;
+        case 0xEE: op_0xee_set_5_hlptr(cpu); break;
+        case 0xEF: op_0xef_set_5_a(cpu); break;
+        case 0xF0: op_0xf0_set_6_b(cpu); break;
+        case 0xF1: op_0xf1_set_6_c(cpu); break;
+        case 0xF2: op_0xf2_set_6_d(cpu); break;
+        case 0xF3: op_0xf3_set_6_e(cpu); break;
+        case 0xF4: op_0xf4_set_6_h(cpu); break;
+        case 0xF5: op_0xf5_set_6_l(cpu); break;
+        case 0xF6: op_0xf6_set_6_hlptr(cpu); break;
+        case 0xF7: op_0xf7_set_6_a(cpu); break;
+        case 0xF8: op_0xf8_set_7_b(cpu); break;
+        case 0xF9: op_0xf9_set_7_c(cpu); break;
+        case 0xFA: op_0xfa_set_7_d(cpu); break;
+        case 0xFB: op_0xfb_set_7_e(cpu); break;
+        case 0xFC: op_0xfc_set_7_h(cpu); break;
+        case 0xFD: op_0xfd_set_7_l(cpu); break;
+        case 0xFE: op_0xfe_set_7_hlptr(cpu); break;
+        case 0xFF: op_0xff_set_7_a(cpu); break;
+        default:   log_cpu_error(cpu, "unimplemented CB opcode: 0x%02X", op);
+    }
+}
+
 void decode_and_execute(CPU *cpu, uint8_t op) {
     switch (op) {
         /* ---- x8/alu ---- */
@@ -850,270 +1128,10 @@ void decode_and_execute(CPU *cpu, uint8_t op) {
         case 0x17: op_rla(cpu); break;
         case 0x0F: op_rrca(cpu); break;
         case 0x1F: op_rra(cpu); break;
-        case 0xCB: {
-            uint8_t cb_op =
-                mem_read(cpu->pc++); /* fetch the CB‐opcode (the second byte) and advance PC */
-
-            switch (cb_op) {
-                case 0x00: op_0x00_rlc_b(cpu); break;
-                case 0x01: op_0x01_rlc_c(cpu); break;
-                case 0x02: op_0x02_rlc_d(cpu); break;
-                case 0x03: op_0x03_rlc_e(cpu); break;
-                case 0x04: op_0x04_rlc_h(cpu); break;
-                case 0x05: op_0x05_rlc_l(cpu); break;
-                case 0x06: op_0x06_rlc_hlptr(cpu); break;
-                case 0x07: op_0x07_rlc_a(cpu); break;
-                case 0x08: op_0x08_rrc_b(cpu); break;
-                case 0x09: op_0x09_rrc_c(cpu); break;
-                case 0x0A: op_0x0a_rrc_d(cpu); break;
-                case 0x0B: op_0x0b_rrc_e(cpu); break;
-                case 0x0C: op_0x0c_rrc_h(cpu); break;
-                case 0x0D: op_0x0d_rrc_l(cpu); break;
-                case 0x0E: op_0x0e_rrc_hlptr(cpu); break;
-                case 0x0F: op_0x0f_rrc_a(cpu); break;
-                case 0x10: op_0x10_rl_b(cpu); break;
-                case 0x11: op_0x11_rl_c(cpu); break;
-                case 0x12: op_0x12_rl_d(cpu); break;
-                case 0x13: op_0x13_rl_e(cpu); break;
-                case 0x14: op_0x14_rl_h(cpu); break;
-                case 0x15: op_0x15_rl_l(cpu); break;
-                case 0x16: op_0x16_rl_hlptr(cpu); break;
-                case 0x17: op_0x17_rl_a(cpu); break;
-                case 0x18: op_0x18_rr_b(cpu); break;
-                case 0x19: op_0x19_rr_c(cpu); break;
-                case 0x1A: op_0x1a_rr_d(cpu); break;
-                case 0x1B: op_0x1b_rr_e(cpu); break;
-                case 0x1C: op_0x1c_rr_h(cpu); break;
-                case 0x1D: op_0x1d_rr_l(cpu); break;
-                case 0x1E: op_0x1e_rr_hlptr(cpu); break;
-                case 0x1F: op_0x1f_rr_a(cpu); break;
-                case 0x20: op_0x20_sla_b(cpu); break;
-                case 0x21: op_0x21_sla_c(cpu); break;
-                case 0x22: op_0x22_sla_d(cpu); break;
-                case 0x23: op_0x23_sla_e(cpu); break;
-                case 0x24: op_0x24_sla_h(cpu); break;
-                case 0x25: op_0x25_sla_l(cpu); break;
-                case 0x26: op_0x26_sla_hlptr(cpu); break;
-                case 0x27: op_0x27_sla_a(cpu); break;
-                case 0x28: op_0x28_sra_b(cpu); break;
-                case 0x29: op_0x29_sra_c(cpu); break;
-                case 0x2A: op_0x2a_sra_d(cpu); break;
-                case 0x2B: op_0x2b_sra_e(cpu); break;
-                case 0x2C: op_0x2c_sra_h(cpu); break;
-                case 0x2D: op_0x2d_sra_l(cpu); break;
-                case 0x2E: op_0x2e_sra_hlptr(cpu); break;
-                case 0x2F: op_0x2f_sra_a(cpu); break;
-                case 0x30: op_0x30_swap_b(cpu); break;
-                case 0x31: op_0x31_swap_c(cpu); break;
-                case 0x32: op_0x32_swap_d(cpu); break;
-                case 0x33: op_0x33_swap_e(cpu); break;
-                case 0x34: op_0x34_swap_h(cpu); break;
-                case 0x35: op_0x35_swap_l(cpu); break;
-                case 0x36: op_0x36_swap_hlptr(cpu); break;
-                case 0x37: op_0x37_swap_a(cpu); break;
-                case 0x38: op_0x38_srl_b(cpu); break;
-                case 0x39: op_0x39_srl_c(cpu); break;
-                case 0x3A: op_0x3a_srl_d(cpu); break;
-                case 0x3B: op_0x3b_srl_e(cpu); break;
-                case 0x3C: op_0x3c_srl_h(cpu); break;
-                case 0x3D: op_0x3d_srl_l(cpu); break;
-                case 0x3E: op_0x3e_srl_hlptr(cpu); break;
-                case 0x3F: op_0x3f_srl_a(cpu); break;
-                case 0x40: op_0x40_bit_0_b(cpu); break;
-                case 0x41: op_0x41_bit_0_c(cpu); break;
-                case 0x42: op_0x42_bit_0_d(cpu); break;
-                case 0x43: op_0x43_bit_0_e(cpu); break;
-                case 0x44: op_0x44_bit_0_h(cpu); break;
-                case 0x45: op_0x45_bit_0_l(cpu); break;
-                case 0x46: op_0x46_bit_0_hlptr(cpu); break;
-                case 0x47: op_0x47_bit_0_a(cpu); break;
-                case 0x48: op_0x48_bit_1_b(cpu); break;
-                case 0x49: op_0x49_bit_1_c(cpu); break;
-                case 0x4A: op_0x4a_bit_1_d(cpu); break;
-                case 0x4B: op_0x4b_bit_1_e(cpu); break;
-                case 0x4C: op_0x4c_bit_1_h(cpu); break;
-                case 0x4D: op_0x4d_bit_1_l(cpu); break;
-                case 0x4E: op_0x4e_bit_1_hlptr(cpu); break;
-                case 0x4F: op_0x4f_bit_1_a(cpu); break;
-                case 0x50: op_0x50_bit_2_b(cpu); break;
-                case 0x51: op_0x51_bit_2_c(cpu); break;
-                case 0x52: op_0x52_bit_2_d(cpu); break;
-                case 0x53: op_0x53_bit_2_e(cpu); break;
-                case 0x54: op_0x54_bit_2_h(cpu); break;
-                case 0x55: op_0x55_bit_2_l(cpu); break;
-                case 0x56: op_0x56_bit_2_hlptr(cpu); break;
-                case 0x57: op_0x57_bit_2_a(cpu); break;
-                case 0x58: op_0x58_bit_3_b(cpu); break;
-                case 0x59: op_0x59_bit_3_c(cpu); break;
-                case 0x5A: op_0x5a_bit_3_d(cpu); break;
-                case 0x5B: op_0x5b_bit_3_e(cpu); break;
-                case 0x5C: op_0x5c_bit_3_h(cpu); break;
-                case 0x5D: op_0x5d_bit_3_l(cpu); break;
-                case 0x5E: op_0x5e_bit_3_hlptr(cpu); break;
-                case 0x5F: op_0x5f_bit_3_a(cpu); break;
-                case 0x60: op_0x60_bit_4_b(cpu); break;
-                case 0x61: op_0x61_bit_4_c(cpu); break;
-                case 0x62: op_0x62_bit_4_d(cpu); break;
-                case 0x63: op_0x63_bit_4_e(cpu); break;
-                case 0x64: op_0x64_bit_4_h(cpu); break;
-                case 0x65: op_0x65_bit_4_l(cpu); break;
-                case 0x66: op_0x66_bit_4_hlptr(cpu); break;
-                case 0x67: op_0x67_bit_4_a(cpu); break;
-                case 0x68: op_0x68_bit_5_b(cpu); break;
-                case 0x69: op_0x69_bit_5_c(cpu); break;
-                case 0x6A: op_0x6a_bit_5_d(cpu); break;
-                case 0x6B: op_0x6b_bit_5_e(cpu); break;
-                case 0x6C: op_0x6c_bit_5_h(cpu); break;
-                case 0x6D: op_0x6d_bit_5_l(cpu); break;
-                case 0x6E: op_0x6e_bit_5_hlptr(cpu); break;
-                case 0x6F: op_0x6f_bit_5_a(cpu); break;
-                case 0x70: op_0x70_bit_6_b(cpu); break;
-                case 0x71: op_0x71_bit_6_c(cpu); break;
-                case 0x72: op_0x72_bit_6_d(cpu); break;
-                case 0x73: op_0x73_bit_6_e(cpu); break;
-                case 0x74: op_0x74_bit_6_h(cpu); break;
-                case 0x75: op_0x75_bit_6_l(cpu); break;
-                case 0x76: op_0x76_bit_6_hlptr(cpu); break;
-                case 0x77: op_0x77_bit_6_a(cpu); break;
-                case 0x78: op_0x78_bit_7_b(cpu); break;
-                case 0x79: op_0x79_bit_7_c(cpu); break;
-                case 0x7A: op_0x7a_bit_7_d(cpu); break;
-                case 0x7B: op_0x7b_bit_7_e(cpu); break;
-                case 0x7C: op_0x7c_bit_7_h(cpu); break;
-                case 0x7D: op_0x7d_bit_7_l(cpu); break;
-                case 0x7E: op_0x7e_bit_7_hlptr(cpu); break;
-                case 0x7F: op_0x7f_bit_7_a(cpu); break;
-                case 0x80: op_0x80_res_0_b(cpu); break;
-                case 0x81: op_0x81_res_0_c(cpu); break;
-                case 0x82: op_0x82_res_0_d(cpu); break;
-                case 0x83: op_0x83_res_0_e(cpu); break;
-                case 0x84: op_0x84_res_0_h(cpu); break;
-                case 0x85: op_0x85_res_0_l(cpu); break;
-                case 0x86: op_0x86_res_0_hlptr(cpu); break;
-                case 0x87: op_0x87_res_0_a(cpu); break;
-                case 0x88: op_0x88_res_1_b(cpu); break;
-                case 0x89: op_0x89_res_1_c(cpu); break;
-                case 0x8A: op_0x8a_res_1_d(cpu); break;
-                case 0x8B: op_0x8b_res_1_e(cpu); break;
-                case 0x8C: op_0x8c_res_1_h(cpu); break;
-                case 0x8D: op_0x8d_res_1_l(cpu); break;
-                case 0x8E: op_0x8e_res_1_hlptr(cpu); break;
-                case 0x8F: op_0x8f_res_1_a(cpu); break;
-                case 0x90: op_0x90_res_2_b(cpu); break;
-                case 0x91: op_0x91_res_2_c(cpu); break;
-                case 0x92: op_0x92_res_2_d(cpu); break;
-                case 0x93: op_0x93_res_2_e(cpu); break;
-                case 0x94: op_0x94_res_2_h(cpu); break;
-                case 0x95: op_0x95_res_2_l(cpu); break;
-                case 0x96: op_0x96_res_2_hlptr(cpu); break;
-                case 0x97: op_0x97_res_2_a(cpu); break;
-                case 0x98: op_0x98_res_3_b(cpu); break;
-                case 0x99: op_0x99_res_3_c(cpu); break;
-                case 0x9A: op_0x9a_res_3_d(cpu); break;
-                case 0x9B: op_0x9b_res_3_e(cpu); break;
-                case 0x9C: op_0x9c_res_3_h(cpu); break;
-                case 0x9D: op_0x9d_res_3_l(cpu); break;
-                case 0x9E: op_0x9e_res_3_hlptr(cpu); break;
-                case 0x9F: op_0x9f_res_3_a(cpu); break;
-                case 0xA0: op_0xa0_res_4_b(cpu); break;
-                case 0xA1: op_0xa1_res_4_c(cpu); break;
-                case 0xA2: op_0xa2_res_4_d(cpu); break;
-                case 0xA3: op_0xa3_res_4_e(cpu); break;
-                case 0xA4: op_0xa4_res_4_h(cpu); break;
-                case 0xA5: op_0xa5_res_4_l(cpu); break;
-                case 0xA6: op_0xa6_res_4_hlptr(cpu); break;
-                case 0xA7: op_0xa7_res_4_a(cpu); break;
-                case 0xA8: op_0xa8_res_5_b(cpu); break;
-                case 0xA9: op_0xa9_res_5_c(cpu); break;
-                case 0xAA: op_0xaa_res_5_d(cpu); break;
-                case 0xAB: op_0xab_res_5_e(cpu); break;
-                case 0xAC: op_0xac_res_5_h(cpu); break;
-                case 0xAD: op_0xad_res_5_l(cpu); break;
-                case 0xAE: op_0xae_res_5_hlptr(cpu); break;
-                case 0xAF: op_0xaf_res_5_a(cpu); break;
-                case 0xB0: op_0xb0_res_6_b(cpu); break;
-                case 0xB1: op_0xb1_res_6_c(cpu); break;
-                case 0xB2: op_0xb2_res_6_d(cpu); break;
-                case 0xB3: op_0xb3_res_6_e(cpu); break;
-                case 0xB4: op_0xb4_res_6_h(cpu); break;
-                case 0xB5: op_0xb5_res_6_l(cpu); break;
-                case 0xB6: op_0xb6_res_6_hlptr(cpu); break;
-                case 0xB7: op_0xb7_res_6_a(cpu); break;
-                case 0xB8: op_0xb8_res_7_b(cpu); break;
-                case 0xB9: op_0xb9_res_7_c(cpu); break;
-                case 0xBA: op_0xba_res_7_d(cpu); break;
-                case 0xBB: op_0xbb_res_7_e(cpu); break;
-                case 0xBC: op_0xbc_res_7_h(cpu); break;
-                case 0xBD: op_0xbd_res_7_l(cpu); break;
-                case 0xBE: op_0xbe_res_7_hlptr(cpu); break;
-                case 0xBF: op_0xbf_res_7_a(cpu); break;
-                case 0xC0: op_0xc0_set_0_b(cpu); break;
-                case 0xC1: op_0xc1_set_0_c(cpu); break;
-                case 0xC2: op_0xc2_set_0_d(cpu); break;
-                case 0xC3: op_0xc3_set_0_e(cpu); break;
-                case 0xC4: op_0xc4_set_0_h(cpu); break;
-                case 0xC5: op_0xc5_set_0_l(cpu); break;
-                case 0xC6: op_0xc6_set_0_hlptr(cpu); break;
-                case 0xC7: op_0xc7_set_0_a(cpu); break;
-                case 0xC8: op_0xc8_set_1_b(cpu); break;
-                case 0xC9: op_0xc9_set_1_c(cpu); break;
-                case 0xCA: op_0xca_set_1_d(cpu); break;
-                case 0xCB: op_0xcb_set_1_e(cpu); break;
-                case 0xCC: op_0xcc_set_1_h(cpu); break;
-                case 0xCD: op_0xcd_set_1_l(cpu); break;
-                case 0xCE: op_0xce_set_1_hlptr(cpu); break;
-                case 0xCF: op_0xcf_set_1_a(cpu); break;
-                case 0xD0: op_0xd0_set_2_b(cpu); break;
-                case 0xD1: op_0xd1_set_2_c(cpu); break;
-                case 0xD2: op_0xd2_set_2_d(cpu); break;
-                case 0xD3: op_0xd3_set_2_e(cpu); break;
-                case 0xD4: op_0xd4_set_2_h(cpu); break;
-                case 0xD5: op_0xd5_set_2_l(cpu); break;
-                case 0xD6: op_0xd6_set_2_hlptr(cpu); break;
-                case 0xD7: op_0xd7_set_2_a(cpu); break;
-                case 0xD8: op_0xd8_set_3_b(cpu); break;
-                case 0xD9: op_0xd9_set_3_c(cpu); break;
-                case 0xDA: op_0xda_set_3_d(cpu); break;
-                case 0xDB: op_0xdb_set_3_e(cpu); break;
-                case 0xDC: op_0xdc_set_3_h(cpu); break;
-                case 0xDD: op_0xdd_set_3_l(cpu); break;
-                case 0xDE: op_0xde_set_3_hlptr(cpu); break;
-                case 0xDF: op_0xdf_set_3_a(cpu); break;
-                case 0xE0: op_0xe0_set_4_b(cpu); break;
-                case 0xE1: op_0xe1_set_4_c(cpu); break;
-                case 0xE2: op_0xe2_set_4_d(cpu); break;
-                case 0xE3: op_0xe3_set_4_e(cpu); break;
-                case 0xE4: op_0xe4_set_4_h(cpu); break;
-                case 0xE5: op_0xe5_set_4_l(cpu); break;
-                case 0xE6: op_0xe6_set_4_hlptr(cpu); break;
-                case 0xE7: op_0xe7_set_4_a(cpu); break;
-                case 0xE8: op_0xe8_set_5_b(cpu); break;
-                case 0xE9: op_0xe9_set_5_c(cpu); break;
-                case 0xEA: op_0xea_set_5_d(cpu); break;
-                case 0xEB: op_0xeb_set_5_e(cpu); break;
-                case 0xEC: op_0xec_set_5_h(cpu); break;
-                case 0xED: op_0xed_set_5_l(cpu); break;
-                case 0xEE: op_0xee_set_5_hlptr(cpu); break;
-                case 0xEF: op_0xef_set_5_a(cpu); break;
-                case 0xF0: op_0xf0_set_6_b(cpu); break;
-                case 0xF1: op_0xf1_set_6_c(cpu); break;
-                case 0xF2: op_0xf2_set_6_d(cpu); break;
-                case 0xF3: op_0xf3_set_6_e(cpu); break;
-                case 0xF4: op_0xf4_set_6_h(cpu); break;
-                case 0xF5: op_0xf5_set_6_l(cpu); break;
-                case 0xF6: op_0xf6_set_6_hlptr(cpu); break;
-                case 0xF7: op_0xf7_set_6_a(cpu); break;
-                case 0xF8: op_0xf8_set_7_b(cpu); break;
-                case 0xF9: op_0xf9_set_7_c(cpu); break;
-                case 0xFA: op_0xfa_set_7_d(cpu); break;
-                case 0xFB: op_0xfb_set_7_e(cpu); break;
-                case 0xFC: op_0xfc_set_7_h(cpu); break;
-                case 0xFD: op_0xfd_set_7_l(cpu); break;
-                case 0xFE: op_0xfe_set_7_hlptr(cpu); break;
-                case 0xFF: op_0xff_set_7_a(cpu); break;
-                default:   log_cpu_error(cpu, "unimplemented CB opcode: 0x%02X", op);
-            }
-        } break;
+        case 0xCB:
+            /* fetch the CB‐opcode (the second byte) and advance PC */
+            decode_cb(cpu, mem_read(cpu->pc++));
+            break;
 
         /* ---- unimplemented / illegal ---- */
         default: log_cpu_error(cpu, "unimplemented opcode: 0x%02X", op); break;
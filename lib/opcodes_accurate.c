@@ -0,0 +1,5 @@
+/* the M-cycle accurate tier: the same opcode definitions as the fast one, built
+again with every bus access on its own M-cycle (see the top of opcodes.h) */
+
+#define OPCODES_ACCURATE
+#include "opcodes.c"
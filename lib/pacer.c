@@ -0,0 +1,68 @@
+#define _POSIX_C_SOURCE 200809L
+
+#include "pacer.h"
+
+#include <time.h>
+
+#define MAX_LAG 0.1      // seconds off schedule (either way) before restarting it
+#define MIN_SPIN 0.0002  // always spin at least this long before a deadline
+#define SMOOTHING 0.05   // weight of the newest measurement
+
+double pacer_now(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+static void sleep_for(double seconds) {
+    struct timespec ts = {.tv_sec = (time_t)seconds};
+    ts.tv_nsec         = (long)((seconds - ts.tv_sec) * 1e9);
+    nanosleep(&ts, NULL);
+}
+
+void pacer_init(Pacer *p, uint64_t cycles) {
+    p->oversleep = 0.001;  // typical timer slack, refined by measurement
+    p->lateness  = 0.0;
+    p->resyncs   = 0;
+    pacer_resync(p, cycles);
+}
+
+void pacer_resync(Pacer *p, uint64_t cycles) {
+    p->origin        = pacer_now();
+    p->origin_cycles = cycles;
+}
+
+double pacer_deadline(const Pacer *p, uint64_t cycles) {
+    return p->origin + (double)(cycles - p->origin_cycles) / DMG_CLOCK_HZ;
+}
+
+void pacer_wait(Pacer *p, uint64_t cycles) {
+    double target = pacer_deadline(p, cycles);
+    double now    = pacer_now();
+
+    /* far behind, or far ahead because the cycle count jumped (state loaded, rewind) */
+    if (now - target > MAX_LAG || target - now > MAX_LAG) {
+        p->resyncs++;
+        pacer_resync(p, cycles);
+        return;
+    }
+
+    /* sleep most of the way, leaving the margin the host tends to oversleep by */
+    double margin = p->oversleep * 1.5 + MIN_SPIN;
+    if (target - now > margin) {
+        double request = target - now - margin;
+        sleep_for(request);
+
+        double woke = pacer_now();
+        p->oversleep += SMOOTHING * ((woke - now - request) - p->oversleep);
+        if (p->oversleep < 0.0)
+            p->oversleep = 0.0;  // woke up early (signal)
+        now = woke;
+    }
+
+    /* spin the rest for an exact deadline */
+    while (now < target)
+        now = pacer_now();
+
+    p->lateness += SMOOTHING * ((now - target) - p->lateness);
+}
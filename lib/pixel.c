@@ -0,0 +1,104 @@
+#include "pixel.h"
+
+#include <string.h>
+
+#if defined(__SSSE3__)
+#include <tmmintrin.h>
+#elif defined(__ARM_NEON) && defined(__aarch64__)
+#include <arm_neon.h>
+#endif
+
+size_t pixel_row_size(pixel_format format, int n) {
+    switch (format) {
+        case PIXEL_INDEXED:
+            return n;
+        case PIXEL_2BPP:
+            return (n + 3) / 4;
+        case PIXEL_RGB565:
+            return n * sizeof(uint16_t);
+        case PIXEL_RGBA8888:
+            return n * 4;
+    }
+    return 0;
+}
+
+uint16_t pixel_rgb565(const uint8_t *rgba) {
+    return ((rgba[0] >> 3) << 11) | ((rgba[1] >> 2) << 5) | (rgba[2] >> 3);
+}
+
+void pixel_to_2bpp(const uint8_t *shades, uint8_t *out, int n) {
+    for (int x = 0; x < n; x += 4) {
+        *out++ = ((shades[x] & 3) << 6) | ((shades[x + 1] & 3) << 4) | ((shades[x + 2] & 3) << 2) |
+                 (shades[x + 3] & 3);
+    }
+}
+
+void pixel_to_rgb565(const uint8_t *shades, uint16_t *out, const uint16_t lut[4], int n) {
+    for (int x = 0; x < n; x++) {
+        out[x] = lut[shades[x] & 3];
+    }
+}
+
+/* the palette is only 4 entries, so a byte shuffle is a complete table lookup:
+each color channel gets its own 16-byte table indexed by the shades, 16 pixels
+per instruction, and the channels are interleaved back into RGBA */
+void pixel_to_rgba8888(const uint8_t *shades, uint8_t *out, const uint8_t *lut, int n) {
+    int x = 0;
+
+#if defined(__SSSE3__) || (defined(__ARM_NEON) && defined(__aarch64__))
+    uint8_t channel[4][16] = {{0}};
+    for (int c = 0; c < 4; c++) {
+        for (int shade = 0; shade < 4; shade++) {
+            channel[c][shade] = lut[shade * 4 + c];
+        }
+    }
+#endif
+
+#if defined(__SSSE3__)
+    const __m128i three = _mm_set1_epi8(3);
+    const __m128i r_lut = _mm_loadu_si128((const __m128i *)channel[0]);
+    const __m128i g_lut = _mm_loadu_si128((const __m128i *)channel[1]);
+    const __m128i b_lut = _mm_loadu_si128((const __m128i *)channel[2]);
+    const __m128i a_lut = _mm_loadu_si128((const __m128i *)channel[3]);
+
+    for (; x + 16 <= n; x += 16) {
+        __m128i idx = _mm_and_si128(_mm_loadu_si128((const __m128i *)(shades + x)), three);
+        __m128i r   = _mm_shuffle_epi8(r_lut, idx);
+        __m128i g   = _mm_shuffle_epi8(g_lut, idx);
+        __m128i b   = _mm_shuffle_epi8(b_lut, idx);
+        __m128i a   = _mm_shuffle_epi8(a_lut, idx);
+
+        __m128i rg_lo = _mm_unpacklo_epi8(r, g);  // RGRG... pixels 0-7
+        __m128i rg_hi = _mm_unpackhi_epi8(r, g);  // pixels 8-15
+        __m128i ba_lo = _mm_unpacklo_epi8(b, a);
+        __m128i ba_hi = _mm_unpackhi_epi8(b, a);
+
+        uint8_t *dst = out + x * 4;
+        _mm_storeu_si128((__m128i *)(dst + 0), _mm_unpacklo_epi16(rg_lo, ba_lo));
+        _mm_storeu_si128((__m128i *)(dst + 16), _mm_unpackhi_epi16(rg_lo, ba_lo));
+        _mm_storeu_si128((__m128i *)(dst + 32), _mm_unpacklo_epi16(rg_hi, ba_hi));
+        _mm_storeu_si128((__m128i *)(dst + 48), _mm_unpackhi_epi16(rg_hi, ba_hi));
+    }
+#elif defined(__ARM_NEON) && defined(__aarch64__)
+    const uint8x16_t three = vdupq_n_u8(3);
+    const uint8x16_t r_lut = vld1q_u8(channel[0]);
+    const uint8x16_t g_lut = vld1q_u8(channel[1]);
+    const uint8x16_t b_lut = vld1q_u8(channel[2]);
+    const uint8x16_t a_lut = vld1q_u8(channel[3]);
+
+    for (; x + 16 <= n; x += 16) {
+        uint8x16_t idx = vandq_u8(vld1q_u8(shades + x), three);
+        uint8x16x4_t rgba;
+        rgba.val[0] = vqtbl1q_u8(r_lut, idx);
+        rgba.val[1] = vqtbl1q_u8(g_lut, idx);
+        rgba.val[2] = vqtbl1q_u8(b_lut, idx);
+        rgba.val[3] = vqtbl1q_u8(a_lut, idx);
+        vst4q_u8(out + x * 4, rgba);  // interleaving store
+    }
+#endif
+
+    /* scalar fallback and the remainder */
+    for (; x < n; x++) {
+        memcpy(out + x * 4, lut + (shades[x] & 3) * 4, 4);
+    }
+}
@@ -24,10 +24,33 @@ void ppu_init(PPU *ppu, struct MMU *mmu, struct CPU *cpu) {
     ppu->mmu = mmu;
     ppu->cpu = cpu;
 
+    /* no host output until the frontend asks for one, grayscale palette */
+    static const uint8_t grays[16] = {
+        0xFF, 0xFF, 0xFF, 0xFF,  // white
+        0xAA, 0xAA, 0xAA, 0xFF,  // light gray
+        0x55, 0x55, 0x55, 0xFF,  // dark gray
+        0x00, 0x00, 0x00, 0xFF,  // black
+    };
+    ppu_set_output(ppu, PIXEL_INDEXED, NULL, 0);
+    ppu_set_palette(ppu, grays);
+
     /* reset the PPU state */
     ppu_reset(ppu);
 }
 
+void ppu_set_output(PPU *ppu, pixel_format format, void *buffer, size_t pitch) {
+    ppu->output_format = format;
+    ppu->output        = buffer;
+    ppu->output_pitch  = pitch;
+}
+
+void ppu_set_palette(PPU *ppu, const uint8_t *rgba) {
+    memcpy(ppu->palette_rgba, rgba, sizeof(ppu->palette_rgba));
+    for (int shade = 0; shade < 4; shade++) {
+        ppu->palette_rgb565[shade] = pixel_rgb565(rgba + shade * 4);
+    }
+}
+
 /* function to reset the PPU */
 void ppu_reset(PPU *ppu) {
     /* reset the framebuffer */
@@ -54,9 +77,9 @@ void ppu_reset(PPU *ppu) {
 /* internal helper functions */
 static inline void request_interrupt(PPU *ppu, int interrupt_type) {
     if (interrupt_type == VBLANK_INTERRUPT) {
-        ppu->cpu->ifr |= 0x01;  // set bit 0 of IF register
+        cpu_request_interrupt(ppu->cpu, 0x01);  // set bit 0 of IF register
     } else if (interrupt_type == LCD_INTERRUPT) {
-        ppu->cpu->ifr |= 0x02;  // set bit 1 of IF register
+        cpu_request_interrupt(ppu->cpu, 0x02);  // set bit 1 of IF register
     }
 }
 
@@ -176,6 +199,12 @@ static void render_window_in_scanline(PPU *ppu) {
         ppu->window_was_visible  = true;
     }
 
+    /* not drawing this frame: only advance the window line */
+    if (ppu->skip_render) {
+        ppu->window_line_counter++;
+        return;
+    }
+
     /* calculate the window y coordinate (relative to window start) */
     uint8_t window_y                = ppu->window_line_counter;
 
@@ -222,6 +251,27 @@ static void render_window_in_scanline(PPU *ppu) {
     }
 }
 
+/* copy the finished scanline to the host output in its format */
+static void output_scanline(PPU *ppu) {
+    const uint8_t *shades = ppu->framebuffer[ppu->current_scanline];
+    uint8_t *out          = ppu->output + ppu->current_scanline * ppu->output_pitch;
+
+    switch (ppu->output_format) {
+        case PIXEL_INDEXED:
+            memcpy(out, shades, LCD_WIDTH);
+            break;
+        case PIXEL_2BPP:
+            pixel_to_2bpp(shades, out, LCD_WIDTH);
+            break;
+        case PIXEL_RGB565:
+            pixel_to_rgb565(shades, (uint16_t *)out, ppu->palette_rgb565, LCD_WIDTH);
+            break;
+        case PIXEL_RGBA8888:
+            pixel_to_rgba8888(shades, out, ppu->palette_rgba, LCD_WIDTH);
+            break;
+    }
+}
+
 static void scan_oam(PPU *ppu) {
     /* check if sprites are enabled using LCDC (bit 1) */
     uint8_t lcdc = mmu_read(ppu->mmu, LCDC);
@@ -403,9 +453,24 @@ void ppu_step(PPU *ppu, int cycles) {
                 ppu->scanline_cycles -= CYCLES_DRAWING_AVG;
 
                 if (ppu->current_scanline < LCD_HEIGHT) {
-                    render_background_in_scanline(ppu);
+                    uint8_t *line = ppu->framebuffer[ppu->current_scanline];
+                    uint8_t previous[LCD_WIDTH];
+
+                    if (!ppu->skip_render) {
+                        memcpy(previous, line, LCD_WIDTH);
+                        render_background_in_scanline(ppu);
+                    }
+
+                    // the window is always walked: it keeps the window line counter
                     render_window_in_scanline(ppu);
-                    render_sprites_in_scanline(ppu);
+
+                    if (!ppu->skip_render) {
+                        render_sprites_in_scanline(ppu);
+                        if (memcmp(previous, line, LCD_WIDTH) != 0)
+                            ppu->line_dirty[ppu->current_scanline] = true;
+                        if (ppu->output)
+                            output_scanline(ppu);
+                    }
                 }
                 change_mode(ppu, PPU_MODE_HBLANK);
             }
@@ -0,0 +1,107 @@
+#include "recomp.h"
+
+#include <dlfcn.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define PATH_MAX_LEN 4096
+
+uint64_t recomp_rom_hash(const uint8_t *rom, uint32_t size) {
+    uint64_t hash = 0xCBF29CE484222325ull;
+    for (uint32_t i = 0; i < size; i++) {
+        hash ^= rom[i];
+        hash *= 0x100000001B3ull;
+    }
+    return hash;
+}
+
+/* the same offset in two banks is 0x4000 apart, so mix the bank bits in */
+static uint32_t slot_of(const Recomp *r, uint32_t offset) {
+    uint32_t h = (offset ^ (offset >> 14)) * 0x9E3779B1u;
+    return (h ^ (h >> 16)) & r->mask;
+}
+
+bool recomp_load(Recomp *r, const char *path, const MMU *mmu) {
+    memset(r, 0, sizeof(*r));
+
+    /* without a slash dlopen searches the library path rather than the directory */
+    char local[PATH_MAX_LEN];
+    if (!strchr(path, '/')) {
+        snprintf(local, sizeof(local), "./%s", path);
+        path = local;
+    }
+
+    r->handle = dlopen(path, RTLD_NOW | RTLD_LOCAL);
+    if (!r->handle) {
+        fprintf(stderr, "Failed to load compiled code: %s\n", dlerror());
+        return false;
+    }
+
+    const RecompTable *table = dlsym(r->handle, "recomp_table");
+    const char *problem      = NULL;
+    if (!table)
+        problem = "no recomp_table in it";
+    else if (table->version != RECOMP_VERSION || table->gb_size != sizeof(GB))
+        problem = "generated for another version of the emulator";
+    else if (!mmu->cartridge_rom ||
+             table->rom_hash != recomp_rom_hash(mmu->cartridge_rom, mmu->cartridge_rom_size))
+        problem = "generated from another ROM";
+    if (problem) {
+        fprintf(stderr, "Compiled code %s: %s\n", path, problem);
+        recomp_free(r);
+        return false;
+    }
+
+    uint32_t slots = 16;
+    while (slots < table->count * 2) {
+        slots *= 2;
+    }
+    r->slots = calloc(slots, sizeof(RecompBlock));
+    if (!r->slots) {
+        fprintf(stderr, "Failed to allocate %u compiled block slots\n", slots);
+        recomp_free(r);
+        return false;
+    }
+    r->mask  = slots - 1;
+    r->table = table;
+
+    for (uint32_t i = 0; i < table->count; i++) {
+        uint32_t s = slot_of(r, table->blocks[i].offset);
+        while (r->slots[s].fn) {
+            s = (s + 1) & r->mask;
+        }
+        r->slots[s] = table->blocks[i];
+    }
+    return true;
+}
+
+void recomp_free(Recomp *r) {
+    free(r->slots);
+    if (r->handle)
+        dlclose(r->handle);
+    memset(r, 0, sizeof(*r));
+}
+
+bool recomp_run(Recomp *r, GB *gb, uint64_t end) {
+    CPU *cpu = &gb->cpu;
+
+    /* the steps cpu_step does something other than run the next instruction in,
+    and the modes compiled code doesn't have */
+    if (cpu->interrupt_check || cpu->halt_bug || cpu->accurate || gb_reference || cpu_log ||
+        cpu_trace)
+        return false;
+
+    uint32_t offset = mmu_rom_offset(&gb->mmu, cpu->pc);
+    if (offset == MMU_NOT_ROM)
+        return false;
+
+    for (uint32_t s = slot_of(r, offset); r->slots[s].fn; s = (s + 1) & r->mask) {
+        if (r->slots[s].offset == offset) {
+            r->entries++;
+            r->slots[s].fn(gb, end);
+            return true;
+        }
+    }
+    return false;
+}
@@ -0,0 +1,205 @@
+#include "rewind.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "snapshot.h"
+
+/* record layout in the arena (no alignment guarantees, always memcpy'd)
+- gb_regs_t
+- uint8_t page count
+- per page: uint8_t page number, then the page bytes (mmu_page_size) */
+#define RECORD_HEADER_SIZE (sizeof(gb_regs_t) + 1)
+
+static rewind_entry_t *entry_at(const Rewind *rw, size_t i) {
+    return &rw->entries[(rw->first + i) % rw->entries_cap];
+}
+
+static size_t record_size(const Rewind *rw, bool keyframe) {
+    const MMU *mmu = &rw->gb->mmu;
+    size_t size    = RECORD_HEADER_SIZE;
+
+    for (int page = 0; page < MMU_PAGE_COUNT; page++) {
+        size_t page_size = mmu_page_size(mmu, page);
+        if (page_size && (keyframe || (mmu->dirty[page] & MMU_DIRTY_REWIND))) {
+            size += 1 + page_size;
+        }
+    }
+    return size;
+}
+
+/* arena offset where a record of size bytes fits without overwriting live
+records, or -1. records never wrap around the end of the arena */
+static long find_space(const Rewind *rw, size_t size) {
+    if (rw->count == 0)
+        return size <= rw->budget ? 0 : -1;
+    if (rw->count == rw->entries_cap)
+        return -1;
+
+    const rewind_entry_t *oldest = entry_at(rw, 0);
+    const rewind_entry_t *newest = entry_at(rw, rw->count - 1);
+    size_t tail                  = oldest->offset;
+    size_t head                  = newest->offset + newest->size;
+
+    if (newest->offset >= tail) {
+        /* live records are [tail, head): room at the end, or wrap to the start */
+        if (rw->budget - head >= size)
+            return (long)head;
+        if (tail >= size)
+            return 0;
+        return -1;
+    }
+
+    /* already wrapped: live records are [tail, budget) and [0, head) */
+    return tail - head >= size ? (long)head : -1;
+}
+
+/* drop the oldest keyframe and its deltas. refuses to drop the newest group,
+which the next delta still depends on */
+static bool evict_group(Rewind *rw) {
+    size_t next = 1;
+    while (next < rw->count && !entry_at(rw, next)->keyframe)
+        next++;
+    if (next == rw->count)
+        return false;
+
+    rw->first = (rw->first + next) % rw->entries_cap;
+    rw->count -= next;
+    return true;
+}
+
+bool rewind_init(Rewind *rw, GB *gb, size_t budget, int keyframe_interval) {
+    memset(rw, 0, sizeof(*rw));
+
+    /* every record is at least its header, which bounds the number of records */
+    rw->entries_cap = budget / RECORD_HEADER_SIZE + 1;
+    rw->arena       = malloc(budget);
+    rw->entries     = malloc(rw->entries_cap * sizeof(rewind_entry_t));
+    if (!rw->arena || !rw->entries) {
+        fprintf(stderr, "Failed to allocate %zu bytes of rewind history\n", budget);
+        rewind_free(rw);
+        return false;
+    }
+
+    rw->gb                = gb;
+    rw->budget            = budget;
+    rw->keyframe_interval = keyframe_interval > 0 ? keyframe_interval : 1;
+    rw->force_keyframe    = true;
+
+    gb->mmu.dirty_mask |= MMU_DIRTY_REWIND;
+    return true;
+}
+
+void rewind_free(Rewind *rw) {
+    if (rw->gb) {
+        MMU *mmu = &rw->gb->mmu;
+        mmu->dirty_mask &= ~MMU_DIRTY_REWIND;
+        for (int page = 0; page < MMU_PAGE_COUNT; page++) {
+            mmu->dirty[page] &= ~MMU_DIRTY_REWIND;
+        }
+    }
+
+    free(rw->arena);
+    free(rw->entries);
+    memset(rw, 0, sizeof(*rw));
+}
+
+bool rewind_push(Rewind *rw) {
+    MMU *mmu      = &rw->gb->mmu;
+    bool keyframe = rw->force_keyframe || rw->count == 0 ||
+                    rw->frames_since_keyframe + 1 >= rw->keyframe_interval;
+    size_t size   = record_size(rw, keyframe);
+
+    long offset;
+    while ((offset = find_space(rw, size)) < 0) {
+        if (evict_group(rw))
+            continue;
+
+        if (!keyframe) {
+            /* only the newest group is left: start over from a keyframe */
+            keyframe = true;
+            size     = record_size(rw, true);
+        }
+        if (rw->count == 0) {
+            fprintf(stderr, "Rewind record of %zu bytes exceeds the %zu byte budget\n", size,
+                    rw->budget);
+            return false;
+        }
+        rw->count = 0;
+    }
+
+    /* write the record */
+    uint8_t *out = rw->arena + offset;
+    gb_regs_t regs;
+    gb_regs_save(rw->gb, &regs);
+    memcpy(out, &regs, sizeof(regs));
+    out += sizeof(regs);
+
+    uint8_t *page_count = out++;
+    *page_count         = 0;
+    for (int page = 0; page < MMU_PAGE_COUNT; page++) {
+        size_t page_size = mmu_page_size(mmu, page);
+        if (!page_size || !(keyframe || (mmu->dirty[page] & MMU_DIRTY_REWIND)))
+            continue;
+
+        *out++ = (uint8_t)page;
+        memcpy(out, mmu_page(mmu, page), page_size);
+        out += page_size;
+        (*page_count)++;
+        mmu->dirty[page] &= ~MMU_DIRTY_REWIND;
+    }
+
+    if (rw->count == 0)
+        rw->first = 0;
+    rewind_entry_t *entry = entry_at(rw, rw->count++);
+    entry->offset         = (uint32_t)offset;
+    entry->size           = (uint32_t)size;
+    entry->keyframe       = keyframe;
+
+    rw->frames_since_keyframe = keyframe ? 0 : rw->frames_since_keyframe + 1;
+    rw->force_keyframe        = false;
+    return true;
+}
+
+/* copy a record's pages back into memory */
+static void apply_pages(Rewind *rw, const rewind_entry_t *entry) {
+    MMU *mmu          = &rw->gb->mmu;
+    const uint8_t *in = rw->arena + entry->offset + sizeof(gb_regs_t);
+    int page_count    = *in++;
+
+    for (int i = 0; i < page_count; i++) {
+        int page         = *in++;
+        size_t page_size = mmu_page_size(mmu, page);
+        memcpy(mmu_page(mmu, page), in, page_size);
+        in += page_size;
+    }
+}
+
+bool rewind_pop(Rewind *rw) {
+    if (rw->count == 0)
+        return false;
+
+    /* rebuild memory from the nearest keyframe forward, then take the registers
+    of the newest record */
+    size_t newest = rw->count - 1;
+    size_t base   = newest;
+    while (!entry_at(rw, base)->keyframe)
+        base--;
+    for (size_t i = base; i <= newest; i++) {
+        apply_pages(rw, entry_at(rw, i));
+    }
+
+    gb_regs_t regs;
+    memcpy(&regs, rw->arena + entry_at(rw, newest)->offset, sizeof(regs));
+    gb_regs_restore(rw->gb, &regs);
+
+    /* memory changed behind mmu_write's back. the restored state is no longer
+    in the history, so the next record can't be a delta against it */
+    mmu_mark_all_dirty(&rw->gb->mmu);
+    rw->count--;
+    rw->force_keyframe = true;
+    return true;
+}
+
+size_t rewind_frames(const Rewind *rw) { return rw->count; }
@@ -140,6 +140,9 @@ void load_rom(MMU *mmu, const char *filepath) {
         memset(mmu->cartridge_ram, 0x00, mmu->cartridge_ram_size); /* Initialize to 0 */
     }
 
+    /* external RAM was replaced (and may have changed size) behind mmu_write's back */
+    mmu_mark_all_dirty(mmu);
+
     fclose(file);
 
     printf("ROM loaded: %zu bytes (expected %u), MBC Type: %d\n", total_read,
@@ -0,0 +1,74 @@
+#include "runahead.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "snapshot.h"
+
+bool runahead_init(RunAhead *ra, GB *gb, int frames) {
+    ra->gb       = gb;
+    ra->snapshot = malloc(gb_snapshot_size(gb));
+    if (!ra->snapshot) {
+        fprintf(stderr, "Failed to allocate the run-ahead snapshot\n");
+        return false;
+    }
+
+    runahead_set_frames(ra, frames);
+    return true;
+}
+
+void runahead_set_frames(RunAhead *ra, int frames) {
+    if (frames < 0)
+        frames = 0;
+    if (frames > RUNAHEAD_MAX_FRAMES)
+        frames = RUNAHEAD_MAX_FRAMES;
+    ra->frames = frames;
+}
+
+void runahead_run_frame(RunAhead *ra) {
+    GB *gb = ra->gb;
+
+    if (ra->frames == 0) {
+        gb_run_frame(gb);
+        return;
+    }
+
+    /* the real frame, nobody sees it */
+    gb->ppu.skip_render = true;
+    gb_run_frame(gb);
+    gb_snapshot_save(gb, ra->snapshot);
+    ra->audio = gb->apu.output;
+
+    /* dirty pages as of the real frame. the hidden frames' writes are undone by
+    the restore, so other consumers (rewind) should see exactly these */
+    uint8_t dirty[MMU_PAGE_COUNT];
+    memcpy(dirty, gb->mmu.dirty, sizeof(dirty));
+
+    /* frames ahead, drawing only the last one. they are re-run for real later,
+    so they stay out of the instruction trace */
+    FILE *log            = cpu_log;
+    cpu_trace_fn trace   = cpu_trace;
+    cpu_log              = NULL;
+    cpu_trace            = NULL;
+    gb->apu.output.muted = true;
+    for (int i = 0; i < ra->frames; i++) {
+        gb->ppu.skip_render = (i < ra->frames - 1);
+        gb_run_frame(gb);
+    }
+    cpu_log   = log;
+    cpu_trace = trace;
+
+    /* back to the real frame. the framebuffer isn't part of the snapshot, so it
+    keeps the picture from ahead */
+    gb_snapshot_restore(gb, ra->snapshot);
+    memcpy(gb->mmu.dirty, dirty, sizeof(dirty));
+
+    /* the real frame's sound picks up where it left off */
+    gb->apu.output = ra->audio;
+}
+
+void runahead_free(RunAhead *ra) {
+    free(ra->snapshot);
+    ra->snapshot = NULL;
+}
@@ -0,0 +1,737 @@
+#define _POSIX_C_SOURCE 200809L
+
+#include "savestate.h"
+
+#include <fcntl.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "lz.h"
+
+#define FOURCC(a, b, c, d) \
+    ((uint32_t)(a) | ((uint32_t)(b) << 8) | ((uint32_t)(c) << 16) | ((uint32_t)(d) << 24))
+
+/* section ids */
+#define SECTION_CPU FOURCC('C', 'P', 'U', ' ')
+#define SECTION_TIMER FOURCC('T', 'I', 'M', 'R')
+#define SECTION_PPU FOURCC('P', 'P', 'U', ' ')
+#define SECTION_JOYPAD FOURCC('J', 'O', 'Y', 'P')
+#define SECTION_MBC FOURCC('M', 'B', 'C', ' ')
+#define SECTION_MMU FOURCC('M', 'M', 'U', ' ')
+#define SECTION_VRAM FOURCC('V', 'R', 'A', 'M')
+#define SECTION_WRAM FOURCC('W', 'R', 'A', 'M')
+#define SECTION_OAM FOURCC('O', 'A', 'M', ' ')
+#define SECTION_IO FOURCC('I', 'O', ' ', ' ')
+#define SECTION_HRAM FOURCC('H', 'R', 'A', 'M')
+#define SECTION_ERAM FOURCC('E', 'R', 'A', 'M')
+#define SECTION_FRAMEBUFFER FOURCC('F', 'B', 'U', 'F')
+#define SECTION_APU FOURCC('A', 'P', 'U', ' ')
+#define SECTION_SERIAL FOURCC('S', 'I', 'O', ' ')
+
+#define SECTION_COUNT 15
+
+#define HEADER_SIZE 32
+#define ENTRY_SIZE 20
+#define FIELDS_MAX 256  // scratch size for the field-by-field sections
+
+#define SECTION_COMPRESSED 0x01
+#define COMPRESS_MIN_SIZE 64  // smaller sections are always stored raw
+
+/* little-endian helpers ------------------------------------------------- */
+static inline void le16(uint8_t *p, uint16_t v) {
+    p[0] = v & 0xFF;
+    p[1] = v >> 8;
+}
+
+static inline void le32(uint8_t *p, uint32_t v) {
+    le16(p, v & 0xFFFF);
+    le16(p + 2, v >> 16);
+}
+
+static inline uint16_t rd16(const uint8_t *p) { return p[0] | (p[1] << 8); }
+
+static inline uint32_t rd32(const uint8_t *p) { return rd16(p) | ((uint32_t)rd16(p + 2) << 16); }
+
+/* field writer: small sections are written one field at a time */
+typedef struct {
+    uint8_t buf[FIELDS_MAX];
+    size_t len;
+} fields_t;
+
+static void put8(fields_t *w, uint8_t v) {
+    if (w->len < sizeof(w->buf))
+        w->buf[w->len++] = v;
+}
+
+static void put16(fields_t *w, uint16_t v) {
+    put8(w, v & 0xFF);
+    put8(w, v >> 8);
+}
+
+static void put32(fields_t *w, uint32_t v) {
+    put16(w, v & 0xFFFF);
+    put16(w, v >> 16);
+}
+
+static void put64(fields_t *w, uint64_t v) {
+    put32(w, v & 0xFFFFFFFF);
+    put32(w, v >> 32);
+}
+
+/* field reader: a field past the end of the section (written by an older
+version) keeps the value passed in, which is the reset value */
+typedef struct {
+    const uint8_t *p;
+    size_t len, pos;
+} reader_t;
+
+static uint8_t get8(reader_t *r, uint8_t keep) { return r->pos < r->len ? r->p[r->pos++] : keep; }
+
+static uint16_t get16(reader_t *r, uint16_t keep) {
+    if (r->pos + 2 > r->len)
+        return keep;
+    uint16_t v = rd16(r->p + r->pos);
+    r->pos += 2;
+    return v;
+}
+
+static uint32_t get32(reader_t *r, uint32_t keep) {
+    if (r->pos + 4 > r->len)
+        return keep;
+    uint32_t v = rd32(r->p + r->pos);
+    r->pos += 4;
+    return v;
+}
+
+static uint64_t get64(reader_t *r, uint64_t keep) {
+    if (r->pos + 8 > r->len)
+        return keep;
+    uint64_t v = rd32(r->p + r->pos) | ((uint64_t)rd32(r->p + r->pos + 4) << 32);
+    r->pos += 8;
+    return v;
+}
+
+uint16_t savestate_rom_checksum(const MMU *mmu) {
+    const uint8_t *rom = mmu->cartridge_rom ? mmu->cartridge_rom : mmu->rom;
+    return (rom[0x014E] << 8) | rom[0x014F];
+}
+
+/* writing --------------------------------------------------------------- */
+typedef struct {
+    uint8_t *data;   // whole file being built
+    size_t len;      // bytes used so far
+    size_t cap;      // bytes allocated
+    int n_sections;  // table entries filled so far
+
+    uint64_t *hash;  // savestate_hash: sections are folded in here instead of stored
+} file_t;
+
+#define FNV_OFFSET 0xCBF29CE484222325ull
+#define FNV_PRIME 0x100000001B3ull
+
+static uint64_t fnv(uint64_t hash, const void *data, size_t size) {
+    const uint8_t *p = data;
+    for (size_t i = 0; i < size; i++) {
+        hash ^= p[i];
+        hash *= FNV_PRIME;
+    }
+    return hash;
+}
+
+static void add_section(file_t *f, uint32_t id, const void *raw, size_t raw_len) {
+    if (f->hash) {
+        uint8_t head[8];
+        le32(head, id);
+        le32(head + 4, (uint32_t)raw_len);
+        *f->hash = fnv(fnv(*f->hash, head, sizeof(head)), raw, raw_len);
+        return;
+    }
+
+    uint8_t *entry = f->data + HEADER_SIZE + f->n_sections++ * ENTRY_SIZE;
+    uint8_t *out   = f->data + f->len;
+    uint32_t flags = 0;
+    size_t stored  = 0;
+
+    if (raw_len >= COMPRESS_MIN_SIZE) {
+        stored = lz_compress(raw, raw_len, out, raw_len - 1);  // only keep it if it shrinks
+        if (stored)
+            flags |= SECTION_COMPRESSED;
+    }
+    if (!stored) {
+        memcpy(out, raw, raw_len);
+        stored = raw_len;
+    }
+
+    le32(entry + 0, id);
+    le32(entry + 4, flags);
+    le32(entry + 8, (uint32_t)f->len);
+    le32(entry + 12, (uint32_t)stored);
+    le32(entry + 16, (uint32_t)raw_len);
+    f->len += stored;
+}
+
+static void add_fields(file_t *f, uint32_t id, const fields_t *w) {
+    add_section(f, id, w->buf, w->len);
+}
+
+static void write_cpu(file_t *f, const CPU *cpu) {
+    fields_t w = {0};
+    put8(&w, cpu->a);
+    put8(&w, cpu->f);
+    put8(&w, cpu->b);
+    put8(&w, cpu->c);
+    put8(&w, cpu->d);
+    put8(&w, cpu->e);
+    put8(&w, cpu->h);
+    put8(&w, cpu->l);
+    put16(&w, cpu->sp);
+    put16(&w, cpu->pc);
+    put64(&w, cpu->cycles);
+    put8(&w, cpu->ime);
+    put8(&w, cpu->ime_delay);
+    put8(&w, cpu->ifr);
+    put8(&w, cpu->ier);
+    put8(&w, cpu->halt);
+    put8(&w, cpu->halt_bug);
+    put8(&w, cpu->dma_flag);
+    put8(&w, cpu->last_opcode);
+    add_fields(f, SECTION_CPU, &w);
+}
+
+static void write_timer(file_t *f, const Timer *t) {
+    fields_t w = {0};
+    put16(&w, t->div);
+    put16(&w, t->tima);
+    put8(&w, t->tma);
+    put8(&w, t->tac);
+    put8(&w, t->prev_div_bit);
+    put8(&w, t->overflow_phase);
+    add_fields(f, SECTION_TIMER, &w);
+}
+
+static void write_ppu(file_t *f, const PPU *ppu) {
+    fields_t w = {0};
+    put32(&w, (uint32_t)ppu->scanline_cycles);
+    put8(&w, ppu->current_scanline);
+    put8(&w, ppu->mode);
+    put8(&w, ppu->window_line_counter);
+    put8(&w, ppu->window_was_visible);
+    put8(&w, (uint8_t)ppu->num_scanline_sprites);
+    for (int i = 0; i < MAX_SPRITES_PER_SCANLINE; i++) {
+        const sprite_t *s = &ppu->scanline_sprites[i];
+        put8(&w, s->y);
+        put8(&w, s->x);
+        put8(&w, s->tile);
+        put8(&w, s->attributes);
+        put8(&w, s->oam_index);
+    }
+    put8(&w, ppu->frame_completed);
+    add_fields(f, SECTION_PPU, &w);
+}
+
+static void write_joypad(file_t *f, const Joypad *j) {
+    fields_t w = {0};
+    put8(&w, j->joyp);
+    put8(&w, j->joyp_ready);
+    put8(&w, j->buttons);
+    put8(&w, j->dpad);
+    add_fields(f, SECTION_JOYPAD, &w);
+}
+
+static void write_mbc(file_t *f, const MBC *mbc) {
+    fields_t w = {0};
+    put8(&w, mbc->rom_bank_low);
+    put8(&w, mbc->rom_bank_high);
+    put8(&w, mbc->ram_enable);
+    put8(&w, mbc->ram_bank);
+    put8(&w, mbc->mbc1_mode);
+    put8(&w, mbc->mbc3_mode);
+    put8(&w, mbc->rtc.seconds);
+    put8(&w, mbc->rtc.minutes);
+    put8(&w, mbc->rtc.hours);
+    put8(&w, mbc->rtc.day_lo);
+    put8(&w, mbc->rtc.day_hi);
+    put8(&w, mbc->rtc.latch);
+    put8(&w, mbc->rtc.latch_seconds);
+    put8(&w, mbc->rtc.latch_minutes);
+    put8(&w, mbc->rtc.latch_hours);
+    put8(&w, mbc->rtc.latch_day_lo);
+    put8(&w, mbc->rtc.latch_day_hi);
+    put8(&w, mbc->rtc_latch_pending);
+    put32(&w, mbc->rtc_cycles);
+    add_fields(f, SECTION_MBC, &w);
+}
+
+static void write_apu(file_t *f, const APU *apu) {
+    fields_t w = {0};
+    for (int i = 0; i < APU_REGS_SIZE; i++) {
+        put8(&w, apu->regs[i]);
+    }
+    put8(&w, apu->power);
+    put8(&w, apu->sequencer_step);
+    for (int i = 0; i < 4; i++) {
+        const apu_channel_t *ch = &apu->ch[i];
+        put8(&w, ch->enabled);
+        put8(&w, ch->dac);
+        put8(&w, ch->length_enable);
+        put16(&w, ch->length);
+        put8(&w, ch->volume);
+        put8(&w, ch->env_period);
+        put8(&w, ch->env_timer);
+        put8(&w, ch->env_up);
+        put16(&w, ch->freq);
+        put8(&w, ch->pos);
+        put16(&w, ch->lfsr);
+        put64(&w, ch->next_time);
+        put16(&w, (uint16_t)ch->out_left);
+        put16(&w, (uint16_t)ch->out_right);
+    }
+    put8(&w, apu->sweep_timer);
+    put8(&w, apu->sweep_enabled);
+    put16(&w, apu->sweep_shadow);
+    put64(&w, apu->time);
+    add_fields(f, SECTION_APU, &w);
+}
+
+static void write_serial(file_t *f, const Serial *s) {
+    fields_t w = {0};
+    put8(&w, s->sb);
+    put8(&w, s->sc);
+    put8(&w, s->bits_left);
+    put8(&w, s->incoming);
+    put8(&w, s->pending);
+    add_fields(f, SECTION_SERIAL, &w);
+}
+
+static void write_mmu(file_t *f, const MMU *mmu) {
+    fields_t w = {0};
+    put8(&w, mmu->rom_bank);
+    put8(&w, mmu->ram_enable);
+    put8(&w, mmu->boot_rom_enabled);
+    add_fields(f, SECTION_MMU, &w);
+
+    add_section(f, SECTION_VRAM, mmu->vram, sizeof(mmu->vram));
+    add_section(f, SECTION_WRAM, mmu->wram, sizeof(mmu->wram));
+    add_section(f, SECTION_OAM, mmu->oam, sizeof(mmu->oam));
+    add_section(f, SECTION_IO, mmu->io, sizeof(mmu->io));
+    add_section(f, SECTION_HRAM, mmu->hram, sizeof(mmu->hram));
+    add_section(f, SECTION_ERAM, mmu_ext_ram(mmu), mmu_ext_ram_size(mmu));
+}
+
+bool savestate_write(const GB *gb, const char *path) {
+    const MMU *mmu = &gb->mmu;
+
+    /* worst case: every section stored raw */
+    size_t raw     = SECTION_COUNT * FIELDS_MAX + sizeof(mmu->vram) + sizeof(mmu->wram) +
+                 sizeof(mmu->oam) + sizeof(mmu->io) + sizeof(mmu->hram) + mmu_ext_ram_size(mmu) +
+                 sizeof(gb->ppu.framebuffer);
+    file_t f = {0};
+    f.cap    = HEADER_SIZE + SECTION_COUNT * ENTRY_SIZE + raw;
+    f.data   = calloc(1, f.cap);
+    if (!f.data) {
+        fprintf(stderr, "Failed to allocate save state buffer\n");
+        return false;
+    }
+    f.len = HEADER_SIZE + SECTION_COUNT * ENTRY_SIZE;
+
+    /* header */
+    memcpy(f.data, "DMGS", 4);
+    le16(f.data + 0x04, SAVESTATE_VERSION);
+    le16(f.data + 0x06, SECTION_COUNT);
+    le16(f.data + 0x08, savestate_rom_checksum(mmu));
+    const uint8_t *rom = mmu->cartridge_rom ? mmu->cartridge_rom : mmu->rom;
+    memcpy(f.data + 0x0C, rom + 0x0134, 16);
+
+    /* sections */
+    write_cpu(&f, &gb->cpu);
+    write_timer(&f, &gb->timer);
+    write_ppu(&f, &gb->ppu);
+    write_joypad(&f, &gb->joypad);
+    write_mbc(&f, &mmu->mbc);
+    write_mmu(&f, mmu);
+    add_section(&f, SECTION_FRAMEBUFFER, gb->ppu.framebuffer, sizeof(gb->ppu.framebuffer));
+    write_apu(&f, &gb->apu);
+    write_serial(&f, &gb->serial);
+
+    /* write to a temporary file first so a crash never leaves a truncated state behind */
+    char tmp_path[4096];
+    snprintf(tmp_path, sizeof(tmp_path), "%s.tmp", path);
+
+    FILE *file = fopen(tmp_path, "wb");
+    if (!file) {
+        fprintf(stderr, "Failed to open save state for writing: %s\n", tmp_path);
+        free(f.data);
+        return false;
+    }
+    size_t written = fwrite(f.data, 1, f.len, file);
+    int closed     = fclose(file);
+    free(f.data);
+
+    if (written != f.len || closed != 0 || rename(tmp_path, path) != 0) {
+        fprintf(stderr, "Failed to write save state: %s\n", path);
+        remove(tmp_path);
+        return false;
+    }
+    return true;
+}
+
+uint64_t savestate_hash(const GB *gb) {
+    uint64_t hash = FNV_OFFSET;
+    file_t f      = {.hash = &hash};
+
+    write_cpu(&f, &gb->cpu);
+    write_timer(&f, &gb->timer);
+    write_ppu(&f, &gb->ppu);
+    write_joypad(&f, &gb->joypad);
+    write_mbc(&f, &gb->mmu.mbc);
+    write_mmu(&f, &gb->mmu);
+    write_apu(&f, &gb->apu);
+    write_serial(&f, &gb->serial);
+    return hash;
+}
+
+/* reading --------------------------------------------------------------- */
+static const uint8_t *find_section(const SaveState *ss, uint32_t id) {
+    for (int i = 0; i < ss->section_count; i++) {
+        const uint8_t *entry = ss->sections + i * ENTRY_SIZE;
+        if (rd32(entry) == id)
+            return entry;
+    }
+    return NULL;
+}
+
+/* decompress (or copy) a whole section into dst, which must be exactly its raw size */
+static bool read_section(const SaveState *ss, uint32_t id, void *dst, size_t dst_len) {
+    const uint8_t *entry = find_section(ss, id);
+    if (!entry || rd32(entry + 16) != dst_len)
+        return false;
+
+    const uint8_t *src = ss->data + rd32(entry + 8);
+    size_t stored      = rd32(entry + 12);
+
+    if (rd32(entry + 4) & SECTION_COMPRESSED)
+        return lz_decompress(src, stored, dst, dst_len);
+    if (stored != dst_len)
+        return false;
+    memcpy(dst, src, dst_len);
+    return true;
+}
+
+/* field-by-field sections: a missing section reads as empty (every field keeps its reset value) */
+static reader_t open_fields(const SaveState *ss, uint32_t id, uint8_t scratch[FIELDS_MAX]) {
+    reader_t r           = {0};
+    const uint8_t *entry = find_section(ss, id);
+    if (!entry)
+        return r;
+
+    size_t raw = rd32(entry + 16);
+    if (!(rd32(entry + 4) & SECTION_COMPRESSED)) {
+        r.p   = ss->data + rd32(entry + 8);
+        r.len = raw;
+    } else if (raw <= FIELDS_MAX && read_section(ss, id, scratch, raw)) {
+        r.p   = scratch;
+        r.len = raw;
+    }
+    return r;
+}
+
+bool savestate_open(SaveState *ss, const char *path) {
+    memset(ss, 0, sizeof(*ss));
+
+    int fd = open(path, O_RDONLY);
+    if (fd < 0) {
+        fprintf(stderr, "Failed to open save state: %s\n", path);
+        return false;
+    }
+
+    struct stat st;
+    if (fstat(fd, &st) != 0 || st.st_size < HEADER_SIZE) {
+        fprintf(stderr, "Save state too small: %s\n", path);
+        close(fd);
+        return false;
+    }
+
+    void *map = mmap(NULL, (size_t)st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (map == MAP_FAILED) {
+        fprintf(stderr, "Failed to map save state: %s\n", path);
+        return false;
+    }
+
+    ss->data          = map;
+    ss->size          = (size_t)st.st_size;
+    ss->version       = rd16(ss->data + 0x04);
+    ss->section_count = rd16(ss->data + 0x06);
+    ss->rom_checksum  = rd16(ss->data + 0x08);
+    memcpy(ss->title, ss->data + 0x0C, 16);
+    ss->sections = ss->data + HEADER_SIZE;
+
+    /* validate the header and section table, so loading never reads out of bounds.
+    an uncompressed section is read in place for its raw size, so that has to be
+    exactly what is stored */
+    bool valid   = memcmp(ss->data, "DMGS", 4) == 0 && ss->version <= SAVESTATE_VERSION &&
+                 HEADER_SIZE + (size_t)ss->section_count * ENTRY_SIZE <= ss->size;
+    for (int i = 0; valid && i < ss->section_count; i++) {
+        const uint8_t *entry = ss->sections + i * ENTRY_SIZE;
+        uint64_t end         = (uint64_t)rd32(entry + 8) + rd32(entry + 12);
+        valid                = end <= ss->size && ((rd32(entry + 4) & SECTION_COMPRESSED) ||
+                                    rd32(entry + 12) == rd32(entry + 16));
+    }
+
+    if (!valid) {
+        fprintf(stderr, "Not a valid save state (or from a newer version): %s\n", path);
+        savestate_close(ss);
+        return false;
+    }
+    return true;
+}
+
+bool savestate_matches_rom(const SaveState *ss, const MMU *mmu) {
+    return ss->rom_checksum == savestate_rom_checksum(mmu);
+}
+
+static void load_cpu(const SaveState *ss, CPU *cpu) {
+    uint8_t scratch[FIELDS_MAX];
+    reader_t r       = open_fields(ss, SECTION_CPU, scratch);
+    cpu->a           = get8(&r, cpu->a);
+    cpu->f           = get8(&r, cpu->f);
+    cpu->b           = get8(&r, cpu->b);
+    cpu->c           = get8(&r, cpu->c);
+    cpu->d           = get8(&r, cpu->d);
+    cpu->e           = get8(&r, cpu->e);
+    cpu->h           = get8(&r, cpu->h);
+    cpu->l           = get8(&r, cpu->l);
+    cpu->sp          = get16(&r, cpu->sp);
+    cpu->pc          = get16(&r, cpu->pc);
+    cpu->cycles      = get64(&r, cpu->cycles);
+    cpu->ime         = get8(&r, cpu->ime);
+    cpu->ime_delay   = get8(&r, cpu->ime_delay);
+    cpu->ifr         = get8(&r, cpu->ifr);
+    cpu->ier         = get8(&r, cpu->ier);
+    cpu->halt        = get8(&r, cpu->halt);
+    cpu->halt_bug    = get8(&r, cpu->halt_bug);
+    cpu->dma_flag    = get8(&r, cpu->dma_flag);
+    cpu->last_opcode = get8(&r, cpu->last_opcode);
+    cpu_update_interrupts(cpu);
+}
+
+static void load_timer(const SaveState *ss, Timer *t) {
+    uint8_t scratch[FIELDS_MAX];
+    reader_t r        = open_fields(ss, SECTION_TIMER, scratch);
+    t->div            = get16(&r, t->div);
+    t->tima           = get16(&r, t->tima);
+    t->tma            = get8(&r, t->tma);
+    t->tac            = get8(&r, t->tac);
+    t->prev_div_bit   = get8(&r, t->prev_div_bit);
+    t->overflow_phase = get8(&r, t->overflow_phase);
+}
+
+static void load_ppu(const SaveState *ss, PPU *ppu) {
+    uint8_t scratch[FIELDS_MAX];
+    reader_t r                = open_fields(ss, SECTION_PPU, scratch);
+    ppu->scanline_cycles      = (int)get32(&r, (uint32_t)ppu->scanline_cycles);
+    ppu->current_scanline     = get8(&r, ppu->current_scanline);
+    ppu->mode                 = get8(&r, ppu->mode) & 0x03;
+    ppu->window_line_counter  = get8(&r, ppu->window_line_counter);
+    ppu->window_was_visible   = get8(&r, ppu->window_was_visible);
+    ppu->num_scanline_sprites = get8(&r, (uint8_t)ppu->num_scanline_sprites);
+    if (ppu->num_scanline_sprites > MAX_SPRITES_PER_SCANLINE)
+        ppu->num_scanline_sprites = MAX_SPRITES_PER_SCANLINE;
+    for (int i = 0; i < MAX_SPRITES_PER_SCANLINE; i++) {
+        sprite_t *s   = &ppu->scanline_sprites[i];
+        s->y          = get8(&r, s->y);
+        s->x          = get8(&r, s->x);
+        s->tile       = get8(&r, s->tile);
+        s->attributes = get8(&r, s->attributes);
+        s->oam_index  = get8(&r, s->oam_index);
+    }
+    ppu->frame_completed = get8(&r, ppu->frame_completed);
+}
+
+static void load_joypad(const SaveState *ss, Joypad *j) {
+    uint8_t scratch[FIELDS_MAX];
+    reader_t r    = open_fields(ss, SECTION_JOYPAD, scratch);
+    j->joyp       = get8(&r, j->joyp);
+    j->joyp_ready = get8(&r, j->joyp_ready);
+    j->buttons    = get8(&r, j->buttons);
+    j->dpad       = get8(&r, j->dpad);
+}
+
+static void load_mbc(const SaveState *ss, MBC *mbc) {
+    uint8_t scratch[FIELDS_MAX];
+    reader_t r             = open_fields(ss, SECTION_MBC, scratch);
+    mbc->rom_bank_low      = get8(&r, mbc->rom_bank_low);
+    mbc->rom_bank_high     = get8(&r, mbc->rom_bank_high);
+    mbc->ram_enable        = get8(&r, mbc->ram_enable);
+    mbc->ram_bank          = get8(&r, mbc->ram_bank);
+    mbc->mbc1_mode         = get8(&r, mbc->mbc1_mode) & 0x01;
+    mbc->mbc3_mode         = get8(&r, mbc->mbc3_mode);
+    mbc->rtc.seconds       = get8(&r, mbc->rtc.seconds);
+    mbc->rtc.minutes       = get8(&r, mbc->rtc.minutes);
+    mbc->rtc.hours         = get8(&r, mbc->rtc.hours);
+    mbc->rtc.day_lo        = get8(&r, mbc->rtc.day_lo);
+    mbc->rtc.day_hi        = get8(&r, mbc->rtc.day_hi);
+    mbc->rtc.latch         = get8(&r, mbc->rtc.latch);
+    mbc->rtc.latch_seconds = get8(&r, mbc->rtc.latch_seconds);
+    mbc->rtc.latch_minutes = get8(&r, mbc->rtc.latch_minutes);
+    mbc->rtc.latch_hours   = get8(&r, mbc->rtc.latch_hours);
+    mbc->rtc.latch_day_lo  = get8(&r, mbc->rtc.latch_day_lo);
+    mbc->rtc.latch_day_hi  = get8(&r, mbc->rtc.latch_day_hi);
+    mbc->rtc_latch_pending = get8(&r, mbc->rtc_latch_pending);
+    mbc->rtc_cycles        = get32(&r, mbc->rtc_cycles);
+}
+
+static void load_apu(const SaveState *ss, APU *apu) {
+    uint8_t scratch[FIELDS_MAX];
+    reader_t r = open_fields(ss, SECTION_APU, scratch);
+    for (int i = 0; i < APU_REGS_SIZE; i++) {
+        apu->regs[i] = get8(&r, apu->regs[i]);
+    }
+    apu->power          = get8(&r, apu->power);
+    apu->sequencer_step = get8(&r, apu->sequencer_step) & 0x07;
+    for (int i = 0; i < 4; i++) {
+        apu_channel_t *ch = &apu->ch[i];
+        ch->enabled       = get8(&r, ch->enabled);
+        ch->dac           = get8(&r, ch->dac);
+        ch->length_enable = get8(&r, ch->length_enable);
+        ch->length        = get16(&r, ch->length);
+        ch->volume        = get8(&r, ch->volume) & 0x0F;
+        ch->env_period    = get8(&r, ch->env_period) & 0x07;
+        ch->env_timer     = get8(&r, ch->env_timer);
+        ch->env_up        = get8(&r, ch->env_up);
+        ch->freq          = get16(&r, ch->freq) & 0x07FF;
+        ch->pos           = get8(&r, ch->pos) & 0x1F;
+        ch->lfsr          = get16(&r, ch->lfsr);
+        ch->next_time     = get64(&r, ch->next_time);
+        ch->out_left      = (int16_t)get16(&r, (uint16_t)ch->out_left);
+        ch->out_right     = (int16_t)get16(&r, (uint16_t)ch->out_right);
+    }
+    apu->sweep_timer   = get8(&r, apu->sweep_timer);
+    apu->sweep_enabled = get8(&r, apu->sweep_enabled);
+    apu->sweep_shadow  = get16(&r, apu->sweep_shadow);
+    apu->time          = get64(&r, apu->time);
+}
+
+static void load_serial(const SaveState *ss, Serial *s) {
+    uint8_t scratch[FIELDS_MAX];
+    reader_t r   = open_fields(ss, SECTION_SERIAL, scratch);
+    s->sb        = get8(&r, s->sb);
+    s->sc        = get8(&r, s->sc) & (SERIAL_START | SERIAL_INTERNAL);
+    s->bits_left = get8(&r, s->bits_left);
+    s->incoming  = get8(&r, s->incoming);
+    s->pending   = get8(&r, s->pending) != 0;
+    if (s->bits_left > 8)
+        s->bits_left = 8;
+}
+
+/* the memory sections, all decompressed and checked before any of the machine is
+replaced, so a corrupt file leaves the running game as it was */
+typedef struct memory_t {
+    uint8_t vram[sizeof(((MMU *)0)->vram)];
+    uint8_t wram[sizeof(((MMU *)0)->wram)];
+    uint8_t oam[sizeof(((MMU *)0)->oam)];
+    uint8_t io[sizeof(((MMU *)0)->io)];
+    uint8_t hram[sizeof(((MMU *)0)->hram)];
+    uint8_t ext_ram[];  // mmu_ext_ram_size bytes
+} memory_t;
+
+static memory_t *read_memory(const SaveState *ss, const MMU *mmu) {
+    uint32_t ext_size = mmu_ext_ram_size(mmu);
+    memory_t *m       = malloc(sizeof(memory_t) + ext_size);
+    if (!m)
+        return NULL;
+
+    if (read_section(ss, SECTION_VRAM, m->vram, sizeof(m->vram)) &&
+        read_section(ss, SECTION_WRAM, m->wram, sizeof(m->wram)) &&
+        read_section(ss, SECTION_OAM, m->oam, sizeof(m->oam)) &&
+        read_section(ss, SECTION_IO, m->io, sizeof(m->io)) &&
+        read_section(ss, SECTION_HRAM, m->hram, sizeof(m->hram)) &&
+        read_section(ss, SECTION_ERAM, m->ext_ram, ext_size))
+        return m;
+    free(m);
+    return NULL;
+}
+
+static void load_mmu(const SaveState *ss, const memory_t *m, MMU *mmu) {
+    uint8_t scratch[FIELDS_MAX];
+    reader_t r            = open_fields(ss, SECTION_MMU, scratch);
+    mmu->rom_bank         = get8(&r, mmu->rom_bank);
+    mmu->ram_enable       = get8(&r, mmu->ram_enable);
+    mmu->boot_rom_enabled = get8(&r, mmu->boot_rom_enabled);
+
+    memcpy(mmu->vram, m->vram, sizeof(mmu->vram));
+    memcpy(mmu->wram, m->wram, sizeof(mmu->wram));
+    memcpy(mmu->oam, m->oam, sizeof(mmu->oam));
+    memcpy(mmu->io, m->io, sizeof(mmu->io));
+    memcpy(mmu->hram, m->hram, sizeof(mmu->hram));
+    memcpy(mmu_ext_ram(mmu), m->ext_ram, mmu_ext_ram_size(mmu));
+    mmu_mark_all_dirty(mmu);  // memory changed behind mmu_write's back
+}
+
+bool savestate_load(const SaveState *ss, GB *gb) {
+    if (!savestate_matches_rom(ss, &gb->mmu)) {
+        fprintf(stderr, "Save state belongs to a different ROM (checksum %04X)\n",
+                ss->rom_checksum);
+        return false;
+    }
+
+    /* the field sections can't fail (a missing field keeps its reset value), so once
+    the memories are in hand the load goes through */
+    memory_t *memory = read_memory(ss, &gb->mmu);
+    if (!memory) {
+        fprintf(stderr, "Corrupt save state memory sections\n");
+        return false;
+    }
+
+    /* start from a reset machine so fields the file predates get their reset value.
+    the memories are all required sections, so the MMU itself is left alone (a reset
+    would also wipe the legacy ROM copy). the CPU's host settings aren't part of the
+    state and survive the reset */
+    int accurate        = gb->cpu.accurate;
+    uint64_t halt_until = gb->cpu.halt_until;
+    mbc_reset(&gb->mmu.mbc);
+    cpu_init(&gb->cpu, &gb->mmu, &gb->timer, &gb->ppu);
+    gb->cpu.accurate   = accurate;
+    gb->cpu.halt_until = halt_until;
+    timer_reset(&gb->timer);
+    ppu_reset(&gb->ppu);
+    joypad_reset(&gb->joypad);
+    apu_reset(&gb->apu);
+    serial_reset(&gb->serial);
+
+    load_cpu(ss, &gb->cpu);
+    load_timer(ss, &gb->timer);
+    load_ppu(ss, &gb->ppu);
+    load_joypad(ss, &gb->joypad);
+    load_mbc(ss, &gb->mmu.mbc);
+
+    /* a file from before the APU starts it silent at the loaded time */
+    gb->apu.time = gb->cpu.cycles;
+    load_apu(ss, &gb->apu);
+    apu_output_restart(&gb->apu);
+    load_serial(ss, &gb->serial);
+
+    load_mmu(ss, memory, &gb->mmu);
+    free(memory);
+
+    /* the picture is optional, an older or trimmed file just shows a blank frame */
+    read_section(ss, SECTION_FRAMEBUFFER, gb->ppu.framebuffer, sizeof(gb->ppu.framebuffer));
+    memset(gb->ppu.line_dirty, true, sizeof(gb->ppu.line_dirty));
+    return true;
+}
+
+bool savestate_read_framebuffer(const SaveState *ss, uint8_t framebuffer[LCD_HEIGHT][LCD_WIDTH]) {
+    return read_section(ss, SECTION_FRAMEBUFFER, framebuffer, LCD_HEIGHT * LCD_WIDTH);
+}
+
+void savestate_close(SaveState *ss) {
+    if (ss->data) {
+        munmap((void *)ss->data, ss->size);
+    }
+    memset(ss, 0, sizeof(*ss));
+}
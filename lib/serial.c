@@ -0,0 +1,92 @@
+#include "serial.h"
+
+#include <stddef.h>
+#include <string.h>
+
+#include "cpu.h"
+
+void serial_init(Serial *serial, struct CPU *cpu) {
+    serial->cpu = cpu;
+    serial_reset(serial);
+}
+
+void serial_reset(Serial *serial) {
+    struct CPU *cpu = serial->cpu;
+    memset(serial, 0, offsetof(Serial, transfer));
+    serial->cpu = cpu;
+}
+
+void serial_connect(Serial *serial, serial_transfer_fn transfer, void *user) {
+    serial->transfer = transfer;
+    serial->user     = user;
+}
+
+uint8_t serial_read_sc(const Serial *serial) {
+    return serial->sc | 0x7E; /* unused bits read as 1 */
+}
+
+void serial_write_sc(Serial *serial, uint8_t value) {
+    serial->sc = value & (SERIAL_START | SERIAL_INTERNAL);
+
+    /* only the internal clock starts a transfer on its own. with the external
+    clock the byte waits for a partner that never comes */
+    if ((serial->sc & SERIAL_START) && (serial->sc & SERIAL_INTERNAL)) {
+        int in            = serial->transfer ? serial->transfer(serial->user, serial->sb) : 0xFF;
+        serial->bits_left = 8;
+        serial->pending   = in == SERIAL_PENDING;
+        serial->incoming  = serial->pending ? 0xFF : (uint8_t)in;
+    } else {
+        serial->bits_left = 0;
+        serial->pending   = false;
+    }
+}
+
+static void finish(Serial *serial) {
+    serial->sc &= ~SERIAL_START;
+    serial->completed = true;
+    if (serial->stop)
+        serial->cpu->halt_until = serial->cpu->cycles;  // gb_run stops here, not at the HALT's end
+    cpu_request_interrupt(serial->cpu, 0x08); /* request serial interrupt */
+}
+
+void serial_clock(Serial *serial) {
+    if (!serial->bits_left)
+        return;
+
+    serial->bits_left--;
+    serial->sb = (serial->sb << 1) | ((serial->incoming >> serial->bits_left) & 0x01);
+
+    /* a pending transfer finishes when the answer arrives */
+    if (!serial->bits_left && !serial->pending)
+        finish(serial);
+}
+
+void serial_reply(Serial *serial, uint8_t in) {
+    if (!serial->pending)
+        return;
+
+    /* put the right bits in place of the ones already shifted in */
+    uint8_t shifted  = 8 - serial->bits_left;
+    uint8_t mask     = (1u << shifted) - 1;
+    serial->sb       = (serial->sb & ~mask) | (shifted ? in >> (8 - shifted) : 0);
+    serial->incoming = in;
+    serial->pending  = false;
+
+    if (!serial->bits_left)
+        finish(serial);
+}
+
+uint8_t serial_receive(Serial *serial, uint8_t in, uint8_t elapsed) {
+    uint8_t out = serial->sb;
+
+    /* the byte is only taken if this side is waiting for one on the external clock */
+    if ((serial->sc & SERIAL_START) && !(serial->sc & SERIAL_INTERNAL)) {
+        if (elapsed > 7)
+            elapsed = 7;
+        serial->sb        = elapsed ? (uint8_t)(out << elapsed) | (in >> (8 - elapsed)) : out;
+        serial->incoming  = in;
+        serial->bits_left = 8 - elapsed;
+        serial->pending   = false;
+    }
+    return out;
+}
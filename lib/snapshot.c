@@ -0,0 +1,93 @@
+#include "snapshot.h"
+
+#include <stdint.h>
+#include <string.h>
+
+void gb_regs_save(const GB *gb, gb_regs_t *regs) {
+    const MMU *mmu = &gb->mmu;
+
+    regs->cpu      = gb->cpu;
+    regs->timer    = gb->timer;
+    memcpy(regs->ppu, &gb->ppu, sizeof(regs->ppu));
+    regs->joypad = gb->joypad;
+    memcpy(regs->apu, &gb->apu, sizeof(regs->apu));
+    memcpy(regs->serial, &gb->serial, sizeof(regs->serial));
+    regs->mbc = mmu->mbc;
+
+    memcpy(regs->io, mmu->io, sizeof(regs->io));
+    regs->rom_bank         = mmu->rom_bank;
+    regs->ram_enable       = mmu->ram_enable;
+    regs->boot_rom_enabled = mmu->boot_rom_enabled;
+}
+
+void gb_regs_restore(GB *gb, const gb_regs_t *regs) {
+    MMU *mmu            = &gb->mmu;
+    uint64_t halt_until = gb->cpu.halt_until;
+    int accurate        = gb->cpu.accurate;
+
+    /* the CPU's host settings stay as they are */
+    gb->cpu            = regs->cpu;
+    gb->cpu.halt_until = halt_until;
+    gb->cpu.accurate   = accurate;
+    gb->timer  = regs->timer;
+    memcpy(&gb->ppu, regs->ppu, sizeof(regs->ppu));
+    gb->joypad = regs->joypad;
+    memcpy(&gb->apu, regs->apu, sizeof(regs->apu));
+    memcpy(&gb->serial, regs->serial, sizeof(regs->serial));
+    mmu->mbc = regs->mbc;
+
+    memcpy(mmu->io, regs->io, sizeof(regs->io));
+    mmu->rom_bank         = regs->rom_bank;
+    mmu->ram_enable       = regs->ram_enable;
+    mmu->boot_rom_enabled = regs->boot_rom_enabled;
+
+    /* the copied structs still point into whichever machine was saved */
+    gb_link(gb);
+
+    /* sound already produced past the restored time is gone */
+    apu_output_restart(&gb->apu);
+}
+
+size_t gb_snapshot_size(const GB *gb) {
+    return sizeof(gb_snapshot_t) + mmu_ext_ram_size(&gb->mmu);
+}
+
+size_t gb_snapshot_save(const GB *gb, void *buf) {
+    gb_snapshot_t *s = buf;
+    const MMU *mmu   = &gb->mmu;
+
+    s->magic         = GB_SNAPSHOT_MAGIC;
+    s->size          = (uint32_t)gb_snapshot_size(gb);
+    gb_regs_save(gb, &s->regs);
+
+    memcpy(s->vram, mmu->vram, sizeof(s->vram));
+    memcpy(s->wram, mmu->wram, sizeof(s->wram));
+    memcpy(s->oam, mmu->oam, sizeof(s->oam));
+    memcpy(s->hram, mmu->hram, sizeof(s->hram));
+
+    s->ext_ram_size = mmu_ext_ram_size(mmu);
+    memcpy(s->ext_ram, mmu_ext_ram(mmu), s->ext_ram_size);
+
+    return s->size;
+}
+
+bool gb_snapshot_restore(GB *gb, const void *buf) {
+    const gb_snapshot_t *s = buf;
+    MMU *mmu               = &gb->mmu;
+
+    if (s->magic != GB_SNAPSHOT_MAGIC || s->ext_ram_size != mmu_ext_ram_size(mmu)) {
+        return false;  // not a snapshot, or taken with a different cartridge
+    }
+
+    gb_regs_restore(gb, &s->regs);
+
+    memcpy(mmu->vram, s->vram, sizeof(s->vram));
+    memcpy(mmu->wram, s->wram, sizeof(s->wram));
+    memcpy(mmu->oam, s->oam, sizeof(s->oam));
+    memcpy(mmu->hram, s->hram, sizeof(s->hram));
+    memcpy(mmu_ext_ram(mmu), s->ext_ram, s->ext_ram_size);
+
+    /* memory changed behind mmu_write's back */
+    mmu_mark_all_dirty(mmu);
+    return true;
+}
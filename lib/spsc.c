@@ -0,0 +1,78 @@
+#include "spsc.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+bool spsc_init(SpscQueue *q, size_t elem_size, size_t capacity) {
+    size_t cap = 1;
+    while (cap < capacity)
+        cap <<= 1;
+
+    q->data = malloc(cap * elem_size);
+    if (!q->data) {
+        fprintf(stderr, "Failed to allocate SPSC queue\n");
+        return false;
+    }
+
+    q->elem_size = elem_size;
+    q->capacity  = cap;
+    atomic_init(&q->head, 0);
+    atomic_init(&q->tail, 0);
+    return true;
+}
+
+void spsc_free(SpscQueue *q) {
+    free(q->data);
+    q->data = NULL;
+}
+
+/* copy n elements between a linear buffer and the ring starting at pos,
+in at most two pieces */
+static void ring_copy(SpscQueue *q, size_t pos, void *elems, size_t n, bool to_ring) {
+    size_t start  = pos & (q->capacity - 1);
+    size_t first  = (q->capacity - start < n) ? q->capacity - start : n;
+    uint8_t *ring = q->data + start * q->elem_size;
+    uint8_t *buf  = elems;
+
+    if (to_ring) {
+        memcpy(ring, buf, first * q->elem_size);
+        memcpy(q->data, buf + first * q->elem_size, (n - first) * q->elem_size);
+    } else {
+        memcpy(buf, ring, first * q->elem_size);
+        memcpy(buf + first * q->elem_size, q->data, (n - first) * q->elem_size);
+    }
+}
+
+size_t spsc_push(SpscQueue *q, const void *elems, size_t n) {
+    size_t head = atomic_load_explicit(&q->head, memory_order_relaxed);
+    size_t tail = atomic_load_explicit(&q->tail, memory_order_acquire);
+    size_t room = q->capacity - (head - tail);
+    if (n > room)
+        n = room;
+    if (n == 0)
+        return 0;
+
+    ring_copy(q, head, (void *)elems, n, true);
+    atomic_store_explicit(&q->head, head + n, memory_order_release);
+    return n;
+}
+
+size_t spsc_pop(SpscQueue *q, void *elems, size_t n) {
+    size_t tail  = atomic_load_explicit(&q->tail, memory_order_relaxed);
+    size_t head  = atomic_load_explicit(&q->head, memory_order_acquire);
+    size_t avail = head - tail;
+    if (n > avail)
+        n = avail;
+    if (n == 0)
+        return 0;
+
+    ring_copy(q, tail, elems, n, false);
+    atomic_store_explicit(&q->tail, tail + n, memory_order_release);
+    return n;
+}
+
+size_t spsc_count(SpscQueue *q) {
+    return atomic_load_explicit(&q->head, memory_order_acquire) -
+           atomic_load_explicit(&q->tail, memory_order_acquire);
+}
@@ -0,0 +1,129 @@
+#include "statehash.h"
+
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+
+#define PRIME1 0x9E3779B185EBCA87ull
+#define PRIME2 0xC2B2AE3D27D4EB4Full
+#define SEED 0x27D4EB2F165667C5ull
+
+/* eight bytes per round rather than FNV's one */
+static inline uint64_t mix(uint64_t hash, uint64_t word) {
+    hash ^= word * PRIME2;
+    hash = (hash << 31) | (hash >> 33);
+    return hash * PRIME1;
+}
+
+static inline uint64_t finish(uint64_t hash) {
+    hash ^= hash >> 33;
+    hash *= PRIME2;
+    hash ^= hash >> 29;
+    return hash;
+}
+
+static uint64_t hash_bytes(uint64_t hash, const void *data, size_t size) {
+    const uint8_t *p = data;
+    for (; size >= 8; p += 8, size -= 8) {
+        uint64_t word;
+        memcpy(&word, p, 8);
+        hash = mix(hash, word);
+    }
+    uint64_t tail = 0;
+    memcpy(&tail, p, size);
+    return mix(hash, tail ^ ((uint64_t)size << 56));
+}
+
+// bytes [start, end) of a struct
+static uint64_t hash_range(const void *base, size_t start, size_t end) {
+    return finish(hash_bytes(SEED, (const uint8_t *)base + start, end - start));
+}
+
+static uint64_t hash_memory(const void *data, size_t size) {
+    return finish(hash_bytes(SEED, data, size));
+}
+
+void gb_state_hashes(const GB *gb, uint64_t hash[GB_HASH_PARTS]) {
+    const MMU *mmu        = &gb->mmu;
+
+    hash[GB_HASH_CPU]     = hash_range(&gb->cpu, offsetof(CPU, af), sizeof(CPU));
+    hash[GB_HASH_TIMER]   = hash_range(&gb->timer, offsetof(Timer, div), sizeof(Timer));
+    hash[GB_HASH_PPU]     = hash_range(&gb->ppu, offsetof(PPU, scanline_cycles),
+                                       offsetof(PPU, framebuffer));
+    hash[GB_HASH_JOYPAD]  = hash_range(&gb->joypad, offsetof(Joypad, joyp), sizeof(Joypad));
+    hash[GB_HASH_APU]     = hash_range(&gb->apu, offsetof(APU, regs), offsetof(APU, output));
+    hash[GB_HASH_SERIAL]  = hash_range(&gb->serial, offsetof(Serial, sb),
+                                       offsetof(Serial, transfer));
+    hash[GB_HASH_MBC]     = hash_memory(&mmu->mbc, sizeof(mmu->mbc));
+
+    uint8_t flags[3]      = {mmu->rom_bank, mmu->ram_enable, mmu->boot_rom_enabled};
+    hash[GB_HASH_IO]      = finish(hash_bytes(hash_bytes(SEED, mmu->io, sizeof(mmu->io)), flags,
+                                              sizeof(flags)));
+
+    hash[GB_HASH_VRAM]    = hash_memory(mmu->vram, sizeof(mmu->vram));
+    hash[GB_HASH_WRAM]    = hash_memory(mmu->wram, sizeof(mmu->wram));
+    hash[GB_HASH_OAM]     = hash_memory(mmu->oam, sizeof(mmu->oam));
+    hash[GB_HASH_HRAM]    = hash_memory(mmu->hram, sizeof(mmu->hram));
+    hash[GB_HASH_EXT_RAM] = hash_memory(mmu_ext_ram(mmu), mmu_ext_ram_size(mmu));
+}
+
+/* a page seeded with its number, so the same bytes on two pages don't cancel
+out in the xor. missing pages hash to 0, which the xor leaves out */
+static uint64_t hash_page(MMU *mmu, int page) {
+    size_t size = mmu_page_size(mmu, page);
+    if (!size)
+        return 0;
+    return finish(hash_bytes(SEED + (uint64_t)page * PRIME1, mmu_page(mmu, page), size));
+}
+
+uint64_t gb_state_hash(GB *gb) {
+    MMU *mmu = &gb->mmu;
+
+    /* first call: start tracking, every page needs hashing once */
+    if (!(mmu->dirty_mask & MMU_DIRTY_HASH)) {
+        mmu->dirty_mask |= MMU_DIRTY_HASH;
+        memset(mmu->page_hash, 0, sizeof(mmu->page_hash));
+        mmu->memory_hash = 0;
+        for (int page = 0; page < MMU_PAGE_COUNT; page++) {
+            mmu->dirty[page] |= MMU_DIRTY_HASH;
+        }
+    }
+
+    for (int page = 0; page < MMU_PAGE_COUNT; page++) {
+        if (!(mmu->dirty[page] & MMU_DIRTY_HASH))
+            continue;
+        uint64_t hash = hash_page(mmu, page);
+        mmu->memory_hash ^= mmu->page_hash[page] ^ hash;
+        mmu->page_hash[page] = hash;
+        mmu->dirty[page] &= ~MMU_DIRTY_HASH;
+    }
+
+    /* the register blocks are small enough to hash whole every time */
+    uint64_t hash = SEED;
+    hash = hash_bytes(hash, (const uint8_t *)&gb->cpu + offsetof(CPU, af),
+                      sizeof(CPU) - offsetof(CPU, af));
+    hash = hash_bytes(hash, (const uint8_t *)&gb->timer + offsetof(Timer, div),
+                      sizeof(Timer) - offsetof(Timer, div));
+    hash = hash_bytes(hash, (const uint8_t *)&gb->ppu + offsetof(PPU, scanline_cycles),
+                      offsetof(PPU, framebuffer) - offsetof(PPU, scanline_cycles));
+    hash = hash_bytes(hash, (const uint8_t *)&gb->joypad + offsetof(Joypad, joyp),
+                      sizeof(Joypad) - offsetof(Joypad, joyp));
+    hash = hash_bytes(hash, (const uint8_t *)&gb->apu + offsetof(APU, regs),
+                      offsetof(APU, output) - offsetof(APU, regs));
+    hash = hash_bytes(hash, (const uint8_t *)&gb->serial + offsetof(Serial, sb),
+                      offsetof(Serial, transfer) - offsetof(Serial, sb));
+    hash = hash_bytes(hash, &mmu->mbc, sizeof(mmu->mbc));
+    hash = hash_bytes(hash, mmu->io, sizeof(mmu->io));
+
+    uint8_t flags[3] = {mmu->rom_bank, mmu->ram_enable, mmu->boot_rom_enabled};
+    hash             = hash_bytes(hash, flags, sizeof(flags));
+    return finish(mix(hash, mmu->memory_hash));
+}
+
+const char *gb_hash_part_name(gb_hash_part_t part) {
+    static const char *names[GB_HASH_PARTS] = {
+        "cpu", "timer", "ppu", "joypad", "apu", "serial", "mbc",
+        "io", "vram", "wram", "oam", "hram", "ext ram",
+    };
+    return part < GB_HASH_PARTS ? names[part] : "?";
+}
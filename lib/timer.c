@@ -1,7 +1,9 @@
 #include "timer.h"
 
+#include "apu.h"
 #include "cpu.h"
 #include "mmu.h"
+#include "serial.h"
 
 /* helpers */
 /* map TAC bits 1:0 to DIV bit numbers */
@@ -13,7 +15,7 @@ static inline uint8_t selected_div_bit(const Timer *t) {
 
 static inline void request_interrupt(Timer *t) {
     /* request timer interrupt */
-    t->cpu->ifr |= 0x04; /* set bit 2 of IF register */
+    cpu_request_interrupt(t->cpu, 0x04); /* set bit 2 of IF register */
 }
 
 void timer_init(Timer *timer, struct CPU *cpu, struct MMU *mmu) {
@@ -33,13 +35,42 @@ void timer_reset(Timer *timer) {
     timer->overflow_phase = 0xFF; /* idle */
 }
 
-/* called from advance_cycles in opcodes.h
+/* called from tick with the cycles of a whole instruction (or DMA byte, or HALT tick)
 cycles = 4, 8, 12, 16... */
 void timer_step(Timer *timer, uint8_t cycles) {
+    /* most of the time the whole batch only moves DIV: no overflow in progress,
+    no 512-cycle edge for the serial port or the APU, and no falling edge on the
+    bit TIMA counts (which prev_div_bit already matches). skip the cycle loop.
+    gb_reference always takes the loop */
+    if (!gb_reference && timer->overflow_phase == 0xFF &&
+        (timer->div & 0x01FF) + cycles < 0x0200) {
+        if (!(timer->tac & 0x04)) {
+            timer->div += cycles;
+            return;
+        }
+        uint8_t bit     = selected_div_bit(timer);
+        uint16_t period = (uint16_t)(2u << bit);
+        if (((timer->div >> bit) & 0x01) == timer->prev_div_bit &&
+            (timer->div & (period - 1)) + cycles < period) {
+            timer->div += cycles;
+            timer->prev_div_bit = (timer->div >> bit) & 0x01;
+            return;
+        }
+    }
+
     while (cycles--) {
         /* 1. increment DIV, our system counter */
         timer->div++;
 
+        /* falling edges of the system counter clock the serial port (bit 8, 8192 Hz)
+        and the APU frame sequencer (bit 12, DIV bit 4, 512 Hz) */
+        if (!(timer->div & 0x01FF)) {
+            if (timer->serial)
+                serial_clock(timer->serial);
+            if (!(timer->div & 0x1FFF) && timer->apu)
+                apu_div_event(timer->apu);
+        }
+
         /* 2. falling edge detector (only if TAC is enabled -> bit 2) */
         if (timer->tac & 0x04) {
             uint8_t bit = (timer->div >> selected_div_bit(timer)) &
@@ -84,6 +115,12 @@ void timer_write_div(Timer *t) {
             }
         }
     }
+    /* resetting DIV is a falling edge for the serial clock and the APU as well */
+    if ((t->div & 0x0100) && t->serial)
+        serial_clock(t->serial);
+    if ((t->div & 0x1000) && t->apu)
+        apu_div_event(t->apu);
+
     /* reset DIV register */
     t->div          = 0; /* reset DIV register to 0x00 */
     t->prev_div_bit = 0; /* reset previous DIV bit to 0 */
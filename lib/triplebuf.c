@@ -0,0 +1,92 @@
+#define _POSIX_C_SOURCE 200809L
+
+#include "triplebuf.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#define TRIPLEBUF_FRESH 0x4u  // middle holds a frame the consumer hasn't taken
+#define TRIPLEBUF_INDEX 0x3u
+
+bool triplebuf_init(TripleBuffer *tb, size_t size) {
+    tb->data = calloc(3, size);
+    if (!tb->data) {
+        fprintf(stderr, "Failed to allocate triple buffer\n");
+        return false;
+    }
+
+    /* timed waits run on the monotonic clock, like the pacer's deadlines */
+    pthread_condattr_t attr;
+    pthread_condattr_init(&attr);
+    pthread_condattr_setclock(&attr, CLOCK_MONOTONIC);
+    bool ok = pthread_mutex_init(&tb->lock, NULL) == 0;
+    if (ok && pthread_cond_init(&tb->published, &attr) != 0) {
+        pthread_mutex_destroy(&tb->lock);
+        ok = false;
+    }
+    pthread_condattr_destroy(&attr);
+    if (!ok) {
+        fprintf(stderr, "Failed to set up triple buffer wakeups\n");
+        free(tb->data);
+        tb->data = NULL;
+        return false;
+    }
+
+    tb->size  = size;
+    tb->back  = 0;
+    tb->front = 2;
+    atomic_init(&tb->middle, 1);
+    return true;
+}
+
+void triplebuf_free(TripleBuffer *tb) {
+    pthread_cond_destroy(&tb->published);
+    pthread_mutex_destroy(&tb->lock);
+    free(tb->data);
+    tb->data = NULL;
+}
+
+uint8_t *triplebuf_back(TripleBuffer *tb) { return tb->data + tb->back * tb->size; }
+
+void triplebuf_publish(TripleBuffer *tb) {
+    /* release: the frame's contents are visible before the consumer sees the index */
+    unsigned old = atomic_exchange_explicit(&tb->middle, (unsigned)tb->back | TRIPLEBUF_FRESH,
+                                            memory_order_acq_rel);
+    tb->back     = (int)(old & TRIPLEBUF_INDEX);
+
+    /* the frame is already marked fresh, and a waiting consumer checks that under
+    the lock, so the wakeup can't slip in between its check and its sleep */
+    pthread_mutex_lock(&tb->lock);
+    pthread_cond_signal(&tb->published);
+    pthread_mutex_unlock(&tb->lock);
+}
+
+bool triplebuf_consumed(TripleBuffer *tb) {
+    return !(atomic_load_explicit(&tb->middle, memory_order_relaxed) & TRIPLEBUF_FRESH);
+}
+
+bool triplebuf_acquire(TripleBuffer *tb) {
+    if (triplebuf_consumed(tb))
+        return false;
+
+    /* acquire: pairs with the producer's release in triplebuf_publish */
+    unsigned old = atomic_exchange_explicit(&tb->middle, (unsigned)tb->front, memory_order_acq_rel);
+    tb->front    = (int)(old & TRIPLEBUF_INDEX);
+    return true;
+}
+
+const uint8_t *triplebuf_front(const TripleBuffer *tb) { return tb->data + tb->front * tb->size; }
+
+bool triplebuf_wait(TripleBuffer *tb, double until) {
+    struct timespec ts = {.tv_sec = (time_t)until};
+    ts.tv_nsec         = (long)((until - (double)ts.tv_sec) * 1e9);
+
+    pthread_mutex_lock(&tb->lock);
+    int err = 0;
+    while (triplebuf_consumed(tb) && err == 0)
+        err = pthread_cond_timedwait(&tb->published, &tb->lock, &ts);
+    pthread_mutex_unlock(&tb->lock);
+    return !triplebuf_consumed(tb);
+}
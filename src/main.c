@@ -1,20 +1,202 @@
+#include <pthread.h>
+#include <stdatomic.h>
 #include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
 
-#include "cpu.h"
-#include "joyp.h"
-#include "mbc.h"
-#include "mmu.h"
-#include "ppu.h"
+#include "gb.h"
+#include "pacer.h"
+#include "resampler.h"
+#include "rewind.h"
 #include "rom.h"
-#include "timer.h"
+#include "runahead.h"
+#include "savestate.h"
+#include "spsc.h"
+#include "triplebuf.h"
 #include "utils.h"
 
-// declare the components
-MMU mmu;
-CPU cpu;
-Timer timer;
-PPU ppu;
-Joypad joypad;
+/* the emulator runs on its own thread and publishes finished frames through a
+triple buffer. the main thread owns the window: it polls the keyboard, sends the
+input over a queue and presents whatever frame is newest. a stall on either side
+(vsync, driver, a slow frame) never blocks the other */
+
+// keyboard state, sent to the emulator whenever it changes
+typedef struct host_input_t {
+    uint8_t buttons;   // joypad buttons, active low
+    uint8_t dpad;      // joypad directions, active low
+    bool rewind;       // backspace held
+    bool turbo;        // tab held
+    uint8_t commands;  // one-shot HOST_* actions
+} host_input_t;
+
+#define HOST_SAVE_STATE 0x01
+#define HOST_LOAD_STATE 0x02
+#define HOST_RUNAHEAD 0x04  // cycle run-ahead frames
+
+#define INPUT_QUEUE_SIZE 64
+#define AUDIO_RATE 48000
+#define AUDIO_CHUNK 1024          // frames per audio device buffer (~21 ms)
+#define AUDIO_QUEUE_SIZE 16384    // APU samples, emulator -> main thread
+#define AUDIO_TARGET_QUEUED 2048  // rate control keeps the queue around here (~31 ms)
+#define AUDIO_MAX_QUEUED 8192     // beyond this (fast-forward, stalls) the excess is dropped
+#define FRAME_SECONDS (DMG_FRAME_CYCLES / DMG_CLOCK_HZ)
+#define FRAME_PITCH (LCD_WIDTH * 4)  // RGBA8888
+
+// one published frame
+typedef struct frame_t {
+    uint8_t pixels[LCD_HEIGHT * FRAME_PITCH];  // texture-ready, written by the PPU
+    uint64_t sequence;                         // frames published before this one
+    bool line_dirty[LCD_HEIGHT];               // lines that changed since the previous frame
+} frame_t;
+
+typedef struct Emulator {
+    GB gb;
+    Rewind rewind;
+    bool rewind_enabled;
+    RunAhead runahead;
+    const char* state_path;
+
+    TripleBuffer frames;        // finished framebuffers, emulator -> main thread
+    SpscQueue input;            // host_input_t, main thread -> emulator
+    SpscQueue audio;            // apu_sample_t, emulator -> main thread
+    _Atomic double next_frame;  // host time (pacer_now) the next frame is due by
+    atomic_bool quit;
+} Emulator;
+
+// declare the emulator
+static Emulator emu;
+
+// read the keyboard
+static host_input_t poll_input(void) {
+    host_input_t in = {.buttons = 0x0F, .dpad = 0x0F};
+
+    if (IsKeyDown(KEY_Z))
+        in.buttons &= ~JOYP_A;  // A
+    if (IsKeyDown(KEY_X))
+        in.buttons &= ~JOYP_B;  // B
+    if (IsKeyDown(KEY_ENTER))
+        in.buttons &= ~JOYP_START;  // START
+    if (IsKeyDown(KEY_SPACE))
+        in.buttons &= ~JOYP_SELECT;  // SELECT
+
+    if (IsKeyDown(KEY_RIGHT))
+        in.dpad &= ~JOYP_RIGHT;  // RIGHT
+    if (IsKeyDown(KEY_LEFT))
+        in.dpad &= ~JOYP_LEFT;  // LEFT
+    if (IsKeyDown(KEY_UP))
+        in.dpad &= ~JOYP_UP;  // UP
+    if (IsKeyDown(KEY_DOWN))
+        in.dpad &= ~JOYP_DOWN;  // DOWN
+
+    in.rewind = IsKeyDown(KEY_BACKSPACE);
+    in.turbo  = IsKeyDown(KEY_TAB);
+
+    if (IsKeyPressed(KEY_F2))
+        in.commands |= HOST_RUNAHEAD;
+    if (IsKeyPressed(KEY_F5))
+        in.commands |= HOST_SAVE_STATE;
+    if (IsKeyPressed(KEY_F8))
+        in.commands |= HOST_LOAD_STATE;
+
+    return in;
+}
+
+static bool same_input(const host_input_t* a, const host_input_t* b) {
+    return a->buttons == b->buttons && a->dpad == b->dpad && a->rewind == b->rewind &&
+           a->turbo == b->turbo && a->commands == b->commands;
+}
+
+// hotkeys, run on the emulation thread between frames
+static void run_commands(Emulator* e, uint8_t commands) {
+    // run-ahead: off, 1, 2, 3, 4 frames
+    if (commands & HOST_RUNAHEAD) {
+        runahead_set_frames(&e->runahead, (e->runahead.frames + 1) % (RUNAHEAD_MAX_FRAMES + 1));
+        printf("Run-ahead: %d frame(s)\n", e->runahead.frames);
+    }
+
+    // save state hotkeys
+    if (commands & HOST_SAVE_STATE) {
+        if (savestate_write(&e->gb, e->state_path))
+            printf("State saved: %s\n", e->state_path);
+    }
+    if (commands & HOST_LOAD_STATE) {
+        SaveState state;
+        if (savestate_open(&state, e->state_path)) {
+            if (savestate_load(&state, &e->gb))
+                printf("State loaded: %s\n", e->state_path);
+            savestate_close(&state);
+        }
+    }
+}
+
+static void* emulation_thread(void* arg) {
+    Emulator* e            = arg;
+    GB* gb                 = &e->gb;
+    host_input_t in        = {.buttons = 0x0F, .dpad = 0x0F};
+    uint32_t frame_counter = 0;
+    uint64_t sequence      = 0;
+
+    Pacer pacer;
+    pacer_init(&pacer, gb->cpu.cycles);
+
+    while (!atomic_load(&e->quit)) {
+        // apply everything the main thread sent since the last frame
+        host_input_t msg;
+        while (spsc_pop(&e->input, &msg, 1)) {
+            in = msg;
+            run_commands(e, msg.commands);
+        }
+        joypad_set(&gb->joypad, in.buttons, in.dpad);
+
+        // holding backspace steps back one frame per frame. the restored frame is
+        // re-run (without recording it) to produce its picture
+        bool rewinding = e->rewind_enabled && in.rewind && rewind_pop(&e->rewind);
+
+        // when fast-forwarding, only frames the main thread will get to show are drawn.
+        // the others keep their exact timing but skip rasterisation
+        bool shown = !in.turbo || triplebuf_consumed(&e->frames);
+
+        // run the CPU until a frame has been completed (and the run-ahead frames, if on)
+        if (shown) {
+            // the PPU draws straight into the back buffer, which then goes to the main thread
+            runahead_run_frame(&e->runahead);
+
+            frame_t* frame  = (frame_t*)triplebuf_back(&e->frames);
+            frame->sequence = sequence++;
+            memcpy(frame->line_dirty, gb->ppu.line_dirty, sizeof(frame->line_dirty));
+            memset(gb->ppu.line_dirty, 0, sizeof(gb->ppu.line_dirty));
+
+            triplebuf_publish(&e->frames);
+            gb->ppu.output = ((frame_t*)triplebuf_back(&e->frames))->pixels;
+        } else {
+            gb->ppu.skip_render = true;
+            gb_run_frame(gb);
+            gb->ppu.skip_render = false;
+        }
+
+        if (e->rewind_enabled && !rewinding) {
+            rewind_push(&e->rewind);
+        }
+
+        frame_counter++;
+        if (frame_counter >= FRAMES_PER_RTC_TICK) {
+            frame_counter = 0;
+            mbc_update_rtc(&gb->mmu.mbc);
+        }
+
+        // run in real time (~59.73 frames per second), unless fast-forwarding
+        if (in.turbo) {
+            pacer_resync(&pacer, gb->cpu.cycles);
+        } else {
+            pacer_wait(&pacer, gb->cpu.cycles);
+        }
+
+        // the next frame goes out by the time this one's successor is due
+        atomic_store(&e->next_frame, pacer_deadline(&pacer, gb->cpu.cycles + DMG_FRAME_CYCLES));
+    }
+
+    return NULL;
+}
 
 int main(int argc, char* argv[]) {
     if (argc != 2) {
@@ -31,14 +213,36 @@ int main(int argc, char* argv[]) {
     const char* rom_file = argv[1];
 
     // initialize and reset components
-    mmu_init(&mmu, &cpu, &timer, &ppu, &joypad);
-    cpu_init(&cpu, &mmu, &timer, &ppu);
-    timer_init(&timer, &cpu, &mmu);
-    ppu_init(&ppu, &mmu, &cpu);
-    joypad_init(&joypad, &mmu, &cpu);
+    gb_init(&emu.gb);
 
-    load_boot_rom(&mmu, BOOT_ROM_PATH);
-    load_rom(&mmu, rom_file);
+    load_boot_rom(&emu.gb.mmu, BOOT_ROM_PATH);
+    load_rom(&emu.gb.mmu, rom_file);
+
+    // save states live next to the ROM
+    char state_path[4096];
+    snprintf(state_path, sizeof(state_path), "%s.state", rom_file);
+    emu.state_path = state_path;
+
+    // rewind history (runs without it if the memory isn't there)
+    emu.rewind_enabled =
+        rewind_init(&emu.rewind, &emu.gb, REWIND_BUDGET, REWIND_KEYFRAME_INTERVAL);
+
+    if (!runahead_init(&emu.runahead, &emu.gb, RUNAHEAD_FRAMES) ||
+        !triplebuf_init(&emu.frames, sizeof(frame_t)) ||
+        !spsc_init(&emu.input, sizeof(host_input_t), INPUT_QUEUE_SIZE) ||
+        !spsc_init(&emu.audio, sizeof(apu_sample_t), AUDIO_QUEUE_SIZE)) {
+        exit(1);
+    }
+    apu_set_output(&emu.gb.apu, &emu.audio);
+
+    // the PPU outputs texture-ready RGBA pixels in the display palette
+    uint8_t palette[16];
+    for (int shade = 0; shade < 4; shade++) {
+        memcpy(&palette[shade * 4], &dmg_palette[shade], 4);  // Color is R, G, B, A bytes
+    }
+    ppu_set_palette(&emu.gb.ppu, palette);
+    ppu_set_output(&emu.gb.ppu, PIXEL_RGBA8888, ((frame_t*)triplebuf_back(&emu.frames))->pixels,
+                   FRAME_PITCH);
 
     // raylib init
     SetTraceLogLevel(LOG_WARNING);
@@ -49,38 +253,98 @@ int main(int argc, char* argv[]) {
     Texture2D texture = LoadTextureFromImage(image);
     UnloadImage(image);
 
-    Color display[WIDTH_PX * HEIGHT_PX];
-
-    uint32_t frame_counter = 0;
+    // audio goes out at a common device rate, resampled from the APU's
+    Resampler resampler;
+    if (!resampler_init(&resampler, APU_SAMPLE_RATE, AUDIO_RATE))
+        exit(1);
+    InitAudioDevice();
+    SetAudioStreamBufferSizeDefault(AUDIO_CHUNK);
+    AudioStream stream = LoadAudioStream(AUDIO_RATE, 16, 2);
+    PlayAudioStream(stream);
+    static apu_sample_t audio_in[RESAMPLER_MAX_INPUT];
+    static apu_sample_t audio_out[AUDIO_CHUNK];
 
-    while (!WindowShouldClose()) {
-        // poll keyboard input
-        joypad_update(&joypad);
+    // start emulating
+    atomic_init(&emu.quit, false);
+    atomic_init(&emu.next_frame, pacer_now() + FRAME_SECONDS);
+    pthread_t emulator;
+    if (pthread_create(&emulator, NULL, emulation_thread, &emu) != 0) {
+        fprintf(stderr, "Failed to start the emulation thread\n");
+        exit(1);
+    }
 
-        // run the CPU until a frame has been completed
-        ppu.frame_completed = 0;
+    host_input_t last_input = {.buttons = 0x0F, .dpad = 0x0F};
+    bool have_frame         = false;  // texture holds a frame from the emulator
+    uint64_t last_sequence  = 0;      // and this is the one
 
-        while (!ppu.frame_completed) {
-            cpu_step(&cpu);  // run the CPU. this also ticks all other components
+    while (!WindowShouldClose()) {
+        // send the keyboard state to the emulator when it changes
+        host_input_t in = poll_input();
+        if (!same_input(&in, &last_input) && spsc_push(&emu.input, &in, 1)) {
+            last_input = in;
         }
 
-        frame_counter++;
-        if (frame_counter >= FRAMES_PER_RTC_TICK) {
-            mbc_update_rtc(&mmu.mbc);
+        // keep the audio device fed. the emulator and the device run off different
+        // clocks: rate control stretches the audio slightly to hold the queue at its
+        // target, the queue is trimmed if it still runs away and a short read is
+        // padded with silence
+        size_t queued;
+        while ((queued = spsc_count(&emu.audio)) > AUDIO_MAX_QUEUED) {
+            size_t excess = queued - AUDIO_MAX_QUEUED;
+            spsc_pop(&emu.audio, audio_in,
+                     excess < RESAMPLER_MAX_INPUT ? excess : RESAMPLER_MAX_INPUT);
+        }
+        while (IsAudioStreamProcessed(stream)) {
+            resampler_control(&resampler, spsc_count(&emu.audio), AUDIO_TARGET_QUEUED);
+            size_t need = resampler_input_needed(&resampler, AUDIO_CHUNK);
+            size_t got  = spsc_pop(&emu.audio, audio_in,
+                                   need < RESAMPLER_MAX_INPUT ? need : RESAMPLER_MAX_INPUT);
+            size_t n    = resampler_run(&resampler, audio_in, got, audio_out, AUDIO_CHUNK);
+            memset(audio_out + n, 0, (AUDIO_CHUNK - n) * sizeof(apu_sample_t));
+            UpdateAudioStream(stream, audio_out, AUDIO_CHUNK);
         }
 
-        BeginDrawing();
-        ClearBackground(BLACK);
+        // upload only the lines that changed. if frames were dropped in between, the
+        // dirty lines don't cover everything the texture is missing: upload it all
+        bool redraw = false;
+        if (triplebuf_acquire(&emu.frames)) {
+            const frame_t* frame = (const frame_t*)triplebuf_front(&emu.frames);
+            bool whole           = !have_frame || frame->sequence != last_sequence + 1;
+
+            for (int y = 0; y < LCD_HEIGHT;) {
+                if (!whole && !frame->line_dirty[y]) {
+                    y++;
+                    continue;
+                }
 
-        const uint8_t (*ppu_framebuffer)[LCD_WIDTH] = ppu_get_framebuffer(&ppu);
+                // one upload per run of changed lines
+                int end = y + 1;
+                while (end < LCD_HEIGHT && (whole || frame->line_dirty[end]))
+                    end++;
 
-        for (int y = 0; y < HEIGHT_PX; y++) {
-            for (int x = 0; x < WIDTH_PX; x++) {
-                display[y * WIDTH_PX + x] = dmg_palette[ppu_framebuffer[y][x] & 0x03];
+                Rectangle rows = {0, (float)y, LCD_WIDTH, (float)(end - y)};
+                UpdateTextureRec(texture, rows, frame->pixels + y * FRAME_PITCH);
+                redraw = true;
+                y      = end;
             }
+
+            have_frame    = true;
+            last_sequence = frame->sequence;
         }
 
-        UpdateTexture(texture, display);
+        // nothing changed on screen: don't redraw. sleep until the emulator publishes
+        // its next frame, or at the latest until that frame is due, then poll again
+        if (!redraw) {
+            PollInputEvents();
+            double until = atomic_load(&emu.next_frame);
+            if (until < pacer_now())
+                until = pacer_now() + FRAME_SECONDS;  // running behind, or fast-forwarding
+            triplebuf_wait(&emu.frames, until);
+            continue;
+        }
+
+        BeginDrawing();
+        ClearBackground(BLACK);
 
         DrawTextureEx(texture, (Vector2){0, 0}, 0.0f, DISPLAY_SCALE, WHITE);
 
@@ -89,9 +353,23 @@ int main(int argc, char* argv[]) {
         EndDrawing();
     }
 
+    // stop the emulator before tearing anything down
+    atomic_store(&emu.quit, true);
+    pthread_join(emulator, NULL);
+
+    UnloadAudioStream(stream);
+    CloseAudioDevice();
+    resampler_free(&resampler);
     UnloadTexture(texture);
     CloseWindow();
 
+    if (emu.rewind_enabled)
+        rewind_free(&emu.rewind);
+    runahead_free(&emu.runahead);
+    triplebuf_free(&emu.frames);
+    spsc_free(&emu.input);
+    spsc_free(&emu.audio);
+
     fclose(cpu_log);
     return 0;
 }
@@ -2,6 +2,7 @@
 #define UTILS_HEADER
 
 #include <raylib.h>
+#include <stddef.h>
 #include <stdint.h>
 
 #define BOOT_ROM_PATH "./include/boot/bootix_dmg.bin"
@@ -14,6 +15,13 @@ const int WIDTH_PX = 160;
 
 const uint32_t FRAMES_PER_RTC_TICK = 60;
 
+// rewind history: a few minutes of frames for typical games
+const size_t REWIND_BUDGET = 64 * 1024 * 1024;
+const int REWIND_KEYFRAME_INTERVAL = 60;
+
+// frames of run-ahead at startup (0 = off, up to RUNAHEAD_MAX_FRAMES), F2 cycles it
+const int RUNAHEAD_FRAMES = 0;
+
 Color dmg_palette[4] = {
     RAYWHITE,
     LIGHTGRAY,
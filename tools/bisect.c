@@ -0,0 +1,382 @@
+#define _XOPEN_SOURCE 700
+
+/* divergence bisector. "record" runs a ROM and writes a recording: the hash of
+the whole machine (savestate_hash) every k frames and a save state every s
+hashes. "bisect" takes two recordings, usually made by two builds, finds the
+first hash they disagree on and has each build replay from the nearest save
+state both agree on, hashing at a finer granularity, until the hashes are one
+instruction apart. it prints the exact cycle and keeps both states there.
+usage: gb-bisect record [-b boot_rom] [-t seconds] [-k frames] [-s hashes] <rom> <dir>
+       gb-bisect bisect <dir_a> <dir_b>
+record also takes -f state, -e cycle and -c cycles (start from a state, stop at a
+cycle, hash every c cycles), which is how bisect has each build replay.
+exit status: 0 recorded / no divergence, 1 diverged, 2 bad usage or input */
+
+#include <errno.h>
+#include <limits.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+#include "pacer.h"
+#include "rom.h"
+#include "savestate.h"
+#include "testrom.h"
+
+#define DEFAULT_SECONDS 60.0  // emulated, not wall clock
+#define DEFAULT_FRAMES 1      // frames between hashes
+#define DEFAULT_STATES 60     // hashes between save states
+#define REFINE 64             // each bisect round hashes this many times more often
+#define REFINE_STATES 16      // hashes between save states while bisecting
+#define EXIT_USAGE 2
+
+/* one hash of a recording, a line of <dir>/hashes: "cycle hash pc [s]",
+s when <dir>/<cycle>.state was saved there too */
+typedef struct entry_t {
+    uint64_t cycle;
+    uint64_t hash;
+    uint16_t pc;
+    bool state;
+} entry_t;
+
+/* a recording directory: how it was made (<dir>/info) and its hashes */
+typedef struct Recording {
+    char dir[PATH_MAX];
+    char exe[PATH_MAX];   // the build that wrote it
+    char rom[PATH_MAX];
+    char boot[PATH_MAX];
+    uint64_t granularity;  // cycles between hashes
+
+    entry_t *entries;
+    size_t count;
+} Recording;
+
+static void usage(const char *name) {
+    fprintf(stderr,
+            "usage: %s record [-b boot_rom] [-t seconds] [-k frames] [-s hashes] <rom> <dir>\n"
+            "       %s bisect <dir_a> <dir_b>\n",
+            name, name);
+}
+
+/* absolute path, so the recording still works from another directory */
+static void absolute(const char *path, char out[PATH_MAX]) {
+    if (!realpath(path, out))
+        snprintf(out, PATH_MAX, "%s", path);
+}
+
+static void state_path(const char *dir, uint64_t cycle, char out[PATH_MAX]) {
+    if (snprintf(out, PATH_MAX, "%s/%llu.state", dir, (unsigned long long)cycle) >= PATH_MAX)
+        out[0] = '\0';  // can't be opened, which the caller reports
+}
+
+/* recording --------------------------------------------------------------- */
+static int record(const char *exe, int argc, char *argv[]) {
+    const char *boot_rom = TESTROM_DEFAULT_BOOT;
+    const char *from     = NULL;
+    double seconds       = DEFAULT_SECONDS;
+    uint64_t end         = 0;
+    uint64_t granularity = DEFAULT_FRAMES * DMG_FRAME_CYCLES;
+    long every           = DEFAULT_STATES;
+
+    int opt;
+    while ((opt = getopt(argc, argv, "b:t:k:c:s:f:e:")) != -1) {
+        switch (opt) {
+            case 'b': boot_rom = optarg; break;
+            case 't': seconds = atof(optarg); break;
+            case 'k': granularity = strtoull(optarg, NULL, 0) * DMG_FRAME_CYCLES; break;
+            case 'c': granularity = strtoull(optarg, NULL, 0); break;
+            case 's': every = atol(optarg); break;
+            case 'f': from = optarg; break;
+            case 'e': end = strtoull(optarg, NULL, 0); break;
+            default: usage(exe); return EXIT_USAGE;
+        }
+    }
+    if (optind != argc - 2 || seconds <= 0.0 || !granularity || every <= 0) {
+        usage(exe);
+        return EXIT_USAGE;
+    }
+    const char *rom = argv[optind], *dir = argv[optind + 1];
+
+    static GB gb;
+    gb_init(&gb);
+    load_boot_rom(&gb.mmu, boot_rom);
+    load_rom(&gb.mmu, rom);
+
+    if (from) {
+        SaveState ss;
+        if (!savestate_open(&ss, from))
+            return EXIT_USAGE;
+        bool loaded = savestate_matches_rom(&ss, &gb.mmu) && savestate_load(&ss, &gb);
+        savestate_close(&ss);
+        if (!loaded) {
+            fprintf(stderr, "Failed to load %s for %s\n", from, rom);
+            return EXIT_USAGE;
+        }
+    }
+
+    if (mkdir(dir, 0777) != 0 && errno != EEXIST) {
+        fprintf(stderr, "Failed to create recording directory: %s\n", dir);
+        return EXIT_USAGE;
+    }
+
+    char path[PATH_MAX], full[PATH_MAX];
+    snprintf(path, sizeof(path), "%s/info", dir);
+    FILE *info = fopen(path, "w");
+    if (!info) {
+        fprintf(stderr, "Failed to open %s\n", path);
+        return EXIT_USAGE;
+    }
+    absolute(exe, full);
+    fprintf(info, "exe %s\n", full);
+    absolute(rom, full);
+    fprintf(info, "rom %s\n", full);
+    absolute(boot_rom, full);
+    fprintf(info, "boot %s\n", full);
+    fprintf(info, "granularity %llu\n", (unsigned long long)granularity);
+    fclose(info);
+
+    snprintf(path, sizeof(path), "%s/hashes", dir);
+    FILE *hashes = fopen(path, "w");
+    if (!hashes) {
+        fprintf(stderr, "Failed to open %s\n", path);
+        return EXIT_USAGE;
+    }
+
+    uint64_t start = gb.cpu.cycles;
+    if (!end)
+        end = start + (uint64_t)(seconds * DMG_CLOCK_HZ);
+
+    uint64_t mark = start;
+    long n        = 0;
+    bool ok       = true;
+    while (ok) {
+        if (gb.cpu.cycles >= mark) {
+            bool state = n++ % every == 0;
+            fprintf(hashes, "%llu %016llx %04x%s\n", (unsigned long long)gb.cpu.cycles,
+                    (unsigned long long)savestate_hash(&gb), gb.cpu.pc, state ? " s" : "");
+            if (state) {
+                state_path(dir, gb.cpu.cycles, path);
+                ok = savestate_write(&gb, path);
+            }
+            while (mark <= gb.cpu.cycles) {
+                mark += granularity;
+            }
+        }
+        if (gb.cpu.cycles >= end)
+            break;
+
+        /* the frame flag is cleared after every step, as gb_run_frame does */
+        cpu_step(&gb.cpu);
+        gb.ppu.frame_completed = 0;
+    }
+
+    if (fclose(hashes) != 0)
+        ok = false;
+    mmu_cleanup(&gb.mmu);
+    return ok ? 0 : EXIT_USAGE;
+}
+
+/* reading recordings -------------------------------------------------------- */
+static void recording_free(Recording *r) {
+    free(r->entries);
+    r->entries = NULL;
+    r->count   = 0;
+}
+
+static bool recording_load(Recording *r, const char *dir) {
+    char path[PATH_MAX], line[PATH_MAX];
+
+    recording_free(r);
+    snprintf(r->dir, sizeof(r->dir), "%s", dir);
+
+    snprintf(path, sizeof(path), "%s/info", dir);
+    FILE *f = fopen(path, "r");
+    if (!f) {
+        fprintf(stderr, "Not a recording: %s\n", dir);
+        return false;
+    }
+    r->exe[0] = r->rom[0] = r->boot[0] = '\0';
+    r->granularity                     = 0;
+    while (fgets(line, sizeof(line), f)) {
+        line[strcspn(line, "\n")] = '\0';
+        if (!strncmp(line, "exe ", 4))
+            snprintf(r->exe, sizeof(r->exe), "%s", line + 4);
+        else if (!strncmp(line, "rom ", 4))
+            snprintf(r->rom, sizeof(r->rom), "%s", line + 4);
+        else if (!strncmp(line, "boot ", 5))
+            snprintf(r->boot, sizeof(r->boot), "%s", line + 5);
+        else if (!strncmp(line, "granularity ", 12))
+            r->granularity = strtoull(line + 12, NULL, 10);
+    }
+    fclose(f);
+    if (!r->exe[0] || !r->rom[0] || !r->granularity) {
+        fprintf(stderr, "Incomplete recording info: %s\n", path);
+        return false;
+    }
+
+    snprintf(path, sizeof(path), "%s/hashes", dir);
+    f = fopen(path, "r");
+    if (!f) {
+        fprintf(stderr, "Failed to open %s\n", path);
+        return false;
+    }
+    size_t cap = 0;
+    unsigned long long cycle, hash;
+    unsigned pc;
+    while (fgets(line, sizeof(line), f)) {
+        char flag[2] = "";
+        if (sscanf(line, "%llu %llx %x %1s", &cycle, &hash, &pc, flag) < 3)
+            continue;
+        if (r->count == cap) {
+            cap            = cap ? cap * 2 : 1024;
+            entry_t *grown = realloc(r->entries, cap * sizeof(entry_t));
+            if (!grown) {
+                fclose(f);
+                fprintf(stderr, "Out of memory reading %s\n", path);
+                return false;
+            }
+            r->entries = grown;
+        }
+        r->entries[r->count++] = (entry_t){cycle, hash, (uint16_t)pc, flag[0] == 's'};
+    }
+    fclose(f);
+    return true;
+}
+
+/* have the build that made a recording replay from one of its states */
+static bool replay(const Recording *r, uint64_t from, uint64_t end, uint64_t granularity,
+                   long every, const char *dir) {
+    char state[PATH_MAX], end_arg[32], granularity_arg[32], every_arg[32];
+    state_path(r->dir, from, state);
+    snprintf(end_arg, sizeof(end_arg), "%llu", (unsigned long long)end);
+    snprintf(granularity_arg, sizeof(granularity_arg), "%llu",
+             (unsigned long long)granularity);
+    snprintf(every_arg, sizeof(every_arg), "%ld", every);
+
+    fflush(stdout);
+    pid_t pid = fork();
+    if (pid < 0) {
+        perror("fork");
+        return false;
+    }
+    if (pid == 0) {
+        /* the replaying build's own chatter (ROM header etc.) isn't interesting here */
+        if (!freopen("/dev/null", "w", stdout))
+            _exit(EXIT_USAGE);
+        char *args[] = {(char *)r->exe, "record", "-b", (char *)r->boot, "-f", state,
+                        "-e", end_arg, "-c", granularity_arg, "-s", every_arg,
+                        (char *)r->rom, (char *)dir, NULL};
+        execvp(r->exe, args);
+        fprintf(stderr, "Failed to run %s\n", r->exe);
+        _exit(EXIT_USAGE);
+    }
+
+    int status;
+    if (waitpid(pid, &status, 0) < 0 || !WIFEXITED(status) || WEXITSTATUS(status) != 0) {
+        fprintf(stderr, "Replay with %s failed\n", r->exe);
+        return false;
+    }
+    return true;
+}
+
+static bool same_entry(const entry_t *a, const entry_t *b) {
+    return a->cycle == b->cycle && a->hash == b->hash;
+}
+
+static void print_entry(const char *name, const Recording *r, const entry_t *e) {
+    char state[PATH_MAX] = "";
+    if (e->state)
+        state_path(r->dir, e->cycle, state);
+    printf("  %s cycle %llu PC:%04X hash %016llx %s\n", name, (unsigned long long)e->cycle,
+           e->pc, (unsigned long long)e->hash, state);
+}
+
+static int bisect(const char *exe, int argc, char *argv[]) {
+    if (argc != 4) {
+        usage(exe);
+        return EXIT_USAGE;
+    }
+
+    static Recording a, b;
+    if (!recording_load(&a, argv[2]) || !recording_load(&b, argv[3]))
+        return EXIT_USAGE;
+    if (a.granularity != b.granularity) {
+        fprintf(stderr, "The recordings were made with different granularities\n");
+        return EXIT_USAGE;
+    }
+
+    for (int round = 1;; round++) {
+        size_t n = a.count < b.count ? a.count : b.count, i = 0;
+        while (i < n && same_entry(&a.entries[i], &b.entries[i])) {
+            i++;
+        }
+        if (i == n && round > 1) {
+            fprintf(stderr, "The replays no longer diverge: the difference is in state the "
+                            "save states don't hold\n");
+            return EXIT_USAGE;
+        }
+        if (i == n) {
+            printf("no divergence over %zu hashes", n);
+            if (a.count != b.count)
+                printf(" (one recording is longer)");
+            printf("\n");
+            return 0;
+        }
+        if (i == 0) {
+            printf("the recordings differ from their first hash, they don't start from the "
+                   "same state\n");
+            print_entry("a:", &a, &a.entries[0]);
+            print_entry("b:", &b, &b.entries[0]);
+            return 1;
+        }
+
+        if (a.granularity == 1) {
+            printf("diverged after cycle %llu:\n", (unsigned long long)a.entries[i - 1].cycle);
+            print_entry("both:", &a, &a.entries[i - 1]);
+            print_entry("a:", &a, &a.entries[i]);
+            print_entry("b:", &b, &b.entries[i]);
+            return 1;
+        }
+
+        /* the nearest state both recordings saved at a hash they still agree on */
+        size_t j = i - 1;
+        while (j > 0 && !(a.entries[j].state && b.entries[j].state)) {
+            j--;
+        }
+        if (!a.entries[j].state || !b.entries[j].state) {
+            fprintf(stderr, "No common save state before cycle %llu\n",
+                    (unsigned long long)a.entries[i].cycle);
+            return EXIT_USAGE;
+        }
+
+        uint64_t from = a.entries[j].cycle;
+        uint64_t end  = a.entries[i].cycle > b.entries[i].cycle ? a.entries[i].cycle
+                                                                : b.entries[i].cycle;
+        uint64_t granularity = a.granularity / REFINE ? a.granularity / REFINE : 1;
+        long every           = granularity == 1 ? 1 : REFINE_STATES;  // keep every last state
+        printf("round %d: diverged between cycles %llu and %llu, replaying from %llu every "
+               "%llu cycles\n",
+               round, (unsigned long long)a.entries[i - 1].cycle, (unsigned long long)end,
+               (unsigned long long)from, (unsigned long long)granularity);
+
+        char dir_a[PATH_MAX], dir_b[PATH_MAX];
+        snprintf(dir_a, sizeof(dir_a), "%s/bisect-%d", argv[2], round);
+        snprintf(dir_b, sizeof(dir_b), "%s/bisect-%d", argv[3], round);
+        if (!replay(&a, from, end, granularity, every, dir_a) ||
+            !replay(&b, from, end, granularity, every, dir_b) || !recording_load(&a, dir_a) ||
+            !recording_load(&b, dir_b))
+            return EXIT_USAGE;
+    }
+}
+
+int main(int argc, char *argv[]) {
+    if (argc >= 2 && !strcmp(argv[1], "record"))
+        return record(argv[0], argc - 1, argv + 1);
+    if (argc >= 2 && !strcmp(argv[1], "bisect"))
+        return bisect(argv[0], argc, argv);
+    usage(argv[0]);
+    return EXIT_USAGE;
+}
@@ -0,0 +1,265 @@
+/* gameboy-doctor, in process: runs a ROM from 0x0100 without the boot ROM and
+compares the CPU state before every instruction with a truth log, read straight
+out of gameboy-doctor's zip (or a plain .log) as the emulator goes. the state is
+compared in binary, nothing is formatted unless it diverges, and it stops at the
+first difference with the lines leading up to it.
+usage: gb-doctor <rom> <truth.zip|truth.log>
+exit status: 0 the whole log matched, 1 diverged, 2 bad usage or input */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "gb.h"
+#include "inflate.h"
+#include "rom.h"
+
+#define CONTEXT 8           // matching lines shown before a divergence
+#define TRUTH_LINE_MAX 128  // longer lines aren't truth log lines
+
+// one line of a truth log: the CPU before an instruction
+typedef struct doctor_state_t {
+    uint8_t a, f, b, c, d, e, h, l;
+    uint16_t sp, pc;
+    uint8_t pcmem[4];
+} doctor_state_t;
+
+typedef struct Doctor {
+    GB gb;
+
+    char line[TRUTH_LINE_MAX];  // partial line carried between chunks
+    size_t line_length;
+    uint64_t line_number;
+
+    doctor_state_t truth;  // next line to compare against
+    bool have_truth;
+    bool diverged;
+    bool bad_line;
+
+    doctor_state_t history[CONTEXT];  // last lines that matched
+    uint64_t matched;
+    doctor_state_t got;  // emulator state at the divergence
+} Doctor;
+
+static int8_t hex_value[256];
+
+static void init_hex(void) {
+    memset(hex_value, -1, sizeof(hex_value));
+    for (int i = 0; i < 10; i++) {
+        hex_value['0' + i] = (int8_t)i;
+    }
+    for (int i = 0; i < 6; i++) {
+        hex_value['A' + i] = hex_value['a' + i] = (int8_t)(10 + i);
+    }
+}
+
+static int hex(const char *s, int digits) {
+    int v = 0;
+    for (int i = 0; i < digits; i++) {
+        int d = hex_value[(uint8_t)s[i]];
+        if (d < 0)
+            return -1;
+        v = (v << 4) | d;
+    }
+    return v;
+}
+
+/* the log format is fixed width:
+A:01 F:B0 B:00 C:13 D:00 E:D8 H:01 L:4D SP:FFFE PC:0100 PCMEM:00,C3,13,02 */
+static bool parse(const char *s, size_t length, doctor_state_t *st) {
+    static const int reg_at[8]   = {2, 7, 12, 17, 22, 27, 32, 37};
+    static const int pcmem_at[4] = {62, 65, 68, 71};
+
+    if (length < 73 || s[0] != 'A' || s[40] != 'S' || s[48] != 'P' || s[56] != 'P')
+        return false;
+
+    uint8_t *regs[8] = {&st->a, &st->f, &st->b, &st->c, &st->d, &st->e, &st->h, &st->l};
+    for (int i = 0; i < 8; i++) {
+        int v = hex(s + reg_at[i], 2);
+        if (v < 0)
+            return false;
+        *regs[i] = (uint8_t)v;
+    }
+    for (int i = 0; i < 4; i++) {
+        int v = hex(s + pcmem_at[i], 2);
+        if (v < 0)
+            return false;
+        st->pcmem[i] = (uint8_t)v;
+    }
+    int sp = hex(s + 43, 4), pc = hex(s + 51, 4);
+    if (sp < 0 || pc < 0)
+        return false;
+    st->sp = (uint16_t)sp;
+    st->pc = (uint16_t)pc;
+    return true;
+}
+
+static void format(const doctor_state_t *st, char *out, size_t size) {
+    snprintf(out, size,
+             "A:%02X F:%02X B:%02X C:%02X D:%02X E:%02X H:%02X L:%02X "
+             "SP:%04X PC:%04X PCMEM:%02X,%02X,%02X,%02X",
+             st->a, st->f, st->b, st->c, st->d, st->e, st->h, st->l, st->sp, st->pc,
+             st->pcmem[0], st->pcmem[1], st->pcmem[2], st->pcmem[3]);
+}
+
+/* cpu_trace hook: the state before the next instruction against the truth */
+static void check(void *user, const CPU *cpu) {
+    Doctor *doc = user;
+    MMU *mmu    = cpu->mmu;
+
+    if (!doc->have_truth || doc->diverged)
+        return;
+
+    doctor_state_t got = {
+        .a     = cpu->a,
+        .f     = cpu->f,
+        .b     = cpu->b,
+        .c     = cpu->c,
+        .d     = cpu->d,
+        .e     = cpu->e,
+        .h     = cpu->h,
+        .l     = cpu->l,
+        .sp    = cpu->sp,
+        .pc    = cpu->pc,
+        .pcmem = {mmu_read(mmu, cpu->pc), mmu_read(mmu, (uint16_t)(cpu->pc + 1)),
+                  mmu_read(mmu, (uint16_t)(cpu->pc + 2)),
+                  mmu_read(mmu, (uint16_t)(cpu->pc + 3))},
+    };
+
+    doc->have_truth = false;
+
+    if (memcmp(&got, &doc->truth, sizeof(got)) != 0) {
+        doc->diverged = true;
+        doc->got      = got;
+        return;
+    }
+    doc->history[doc->matched++ % CONTEXT] = got;
+}
+
+/* one line of truth: run the emulator until it has been compared */
+static void truth_line(Doctor *doc, const char *s, size_t length) {
+    doc->line_number++;
+    if (length && s[length - 1] == '\r')
+        length--;
+    if (!length)
+        return;
+
+    if (!parse(s, length, &doc->truth)) {
+        fprintf(stderr, "line %llu: not a truth log line: %.*s\n",
+                (unsigned long long)doc->line_number, (int)length, s);
+        doc->bad_line = true;
+        return;
+    }
+
+    doc->have_truth = true;
+    while (doc->have_truth && !doc->diverged) {
+        cpu_step(&doc->gb.cpu);
+    }
+}
+
+static bool sink(void *user, const uint8_t *data, size_t size) {
+    Doctor *doc = user;
+
+    for (size_t i = 0; i < size && !doc->diverged && !doc->bad_line;) {
+        const uint8_t *nl = memchr(data + i, '\n', size - i);
+        size_t end        = nl ? (size_t)(nl - data) : size;
+        size_t n          = end - i;
+
+        if (!doc->line_length && nl) {
+            truth_line(doc, (const char *)data + i, n);  // whole line in this chunk
+        } else {
+            if (doc->line_length + n >= TRUTH_LINE_MAX)
+                n = TRUTH_LINE_MAX - 1 - doc->line_length;
+            memcpy(doc->line + doc->line_length, data + i, n);
+            doc->line_length += n;
+            if (nl) {
+                truth_line(doc, doc->line, doc->line_length);
+                doc->line_length = 0;
+            }
+        }
+        i = end + 1;
+    }
+    return !doc->diverged && !doc->bad_line;
+}
+
+static void report(const Doctor *doc) {
+    char truth[TRUTH_LINE_MAX], got[TRUTH_LINE_MAX], marks[TRUTH_LINE_MAX];
+
+    printf("diverged at line %llu, cycle %llu\n\n", (unsigned long long)doc->line_number,
+           (unsigned long long)doc->gb.cpu.cycles);
+
+    uint64_t shown = doc->matched < CONTEXT ? doc->matched : CONTEXT;
+    for (uint64_t i = doc->matched - shown; i < doc->matched; i++) {
+        format(&doc->history[i % CONTEXT], truth, sizeof(truth));
+        printf("        %s\n", truth);
+    }
+
+    format(&doc->truth, truth, sizeof(truth));
+    format(&doc->got, got, sizeof(got));
+    size_t n = 0;
+    for (size_t i = 0; truth[i]; i++) {
+        marks[i] = truth[i] != got[i] ? '^' : ' ';
+        if (marks[i] == '^')
+            n = i + 1;
+    }
+    marks[n] = '\0';
+    printf("truth:  %s\ngot:    %s\n        %s\n", truth, got, marks);
+}
+
+int main(int argc, char *argv[]) {
+    if (argc != 3) {
+        fprintf(stderr, "usage: %s <rom> <truth.zip|truth.log>\n", argv[0]);
+        return 2;
+    }
+
+    FILE *f = fopen(argv[2], "rb");
+    if (!f) {
+        fprintf(stderr, "Failed to open truth log: %s\n", argv[2]);
+        return 2;
+    }
+    init_hex();
+
+    /* the state gameboy-doctor starts from: after the boot ROM, LY stuck at 0x90 */
+    static Doctor doc;
+    gb_init(&doc.gb);
+    load_rom(&doc.gb.mmu, argv[1]);
+    doc.gb.cpu.pc      = 0x0100;
+    doc.gb.mmu.ly_stub = true;
+
+    cpu_trace      = check;
+    cpu_trace_user = &doc;
+
+    int magic = fgetc(f);
+    ungetc(magic, f);
+    inflate_result_t result;
+    if (magic == 'P') {
+        result = inflate_zip(f, sink, &doc);
+    } else {
+        result = INFLATE_OK;
+        uint8_t chunk[65536];
+        size_t n;
+        while (result == INFLATE_OK && (n = fread(chunk, 1, sizeof(chunk), f)) > 0) {
+            if (!sink(&doc, chunk, n))
+                result = INFLATE_STOPPED;
+        }
+    }
+    fclose(f);
+    if (result == INFLATE_OK && doc.line_length)
+        truth_line(&doc, doc.line, doc.line_length);  // last line without a newline
+
+    cpu_trace = NULL;
+    mmu_cleanup(&doc.gb.mmu);
+
+    if (doc.diverged) {
+        report(&doc);
+        return 1;
+    }
+    if (doc.bad_line)
+        return 2;
+    if (result != INFLATE_OK) {
+        fprintf(stderr, "%s: %s\n", argv[2], inflate_error(result));
+        return 2;
+    }
+    printf("%llu lines matched\n", (unsigned long long)doc.matched);
+    return 0;
+}
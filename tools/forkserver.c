@@ -0,0 +1,225 @@
+#define _POSIX_C_SOURCE 200809L
+
+#include "forkserver.h"
+
+#include <errno.h>
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+#include "pacer.h"
+
+static volatile sig_atomic_t stopping;
+
+static void stop(int sig) {
+    (void)sig;
+    stopping = 1;
+}
+
+/* a frame's worth of cycles, whether or not the LCD is on */
+static void run_frame(GB *gb) {
+    uint64_t end = gb->cpu.cycles + DMG_FRAME_CYCLES;
+    while (gb->cpu.cycles < end) {
+        gb_run(gb, end - gb->cpu.cycles);
+    }
+}
+
+/* the breakpoint only counts once the cartridge is running */
+static bool at_breakpoint(const GB *gb, int pc) {
+    return gb->cpu.pc == pc && !(gb->mmu.boot_rom_enabled && pc < 0x0100);
+}
+
+bool forkserver_boot(TestRom *t, uint64_t frames, int pc, uint64_t budget) {
+    GB *gb         = &t->gb;
+    uint64_t limit = gb->cpu.cycles + budget;
+
+    if (pc < 0) {
+        for (uint64_t i = 0; i < frames && gb->cpu.cycles < limit; i++) {
+            run_frame(gb);
+        }
+        return true;
+    }
+
+    bool found     = at_breakpoint(gb, pc);
+    gb->breakpoint = pc;
+    while (!found && gb->cpu.cycles < limit) {
+        found = gb_run(gb, limit - gb->cpu.cycles) == GB_STOP_BREAKPOINT &&
+                at_breakpoint(gb, pc);
+    }
+    gb->breakpoint = -1;
+    return found;
+}
+
+/* input byte to the register's active-low halves */
+static void press(GB *gb, uint8_t input) {
+    joypad_set(&gb->joypad, ~input & 0x0F, ~(input >> 4) & 0x0F);
+}
+
+static int hex_digit(char c) {
+    if (c >= '0' && c <= '9')
+        return c - '0';
+    if (c >= 'a' && c <= 'f')
+        return c - 'a' + 10;
+    if (c >= 'A' && c <= 'F')
+        return c - 'A' + 10;
+    return -1;
+}
+
+/* the child's side: run the branch and write the answer to out */
+static void branch(TestRom *t, char *request, FILE *out) {
+    GB *gb = &t->gb;
+    char *save;
+
+    char *verb   = strtok_r(request, " \t\r\n", &save);
+    char *frames = strtok_r(NULL, " \t\r\n", &save);
+    char *inputs = strtok_r(NULL, " \t\r\n", &save);
+    if (!verb || strcmp(verb, "branch") != 0 || !frames || !inputs) {
+        fprintf(out, "error expected: branch <frames> <inputs> [<addr>:<length> ...]\n");
+        return;
+    }
+
+    char *end;
+    unsigned long long n_frames = strtoull(frames, &end, 10);
+    size_t n_inputs             = strcmp(inputs, "-") ? strlen(inputs) / 2 : 0;
+    if (*end || (strcmp(inputs, "-") && strlen(inputs) % 2)) {
+        fprintf(out, "error bad frame count or inputs\n");
+        return;
+    }
+    for (size_t i = 0; i < n_inputs * 2; i++) {
+        if (hex_digit(inputs[i]) < 0) {
+            fprintf(out, "error bad inputs\n");
+            return;
+        }
+    }
+
+    for (unsigned long long f = 0; f < n_frames; f++) {
+        if (n_inputs) {
+            size_t i = f < n_inputs ? f : n_inputs - 1;
+            press(gb, (uint8_t)(hex_digit(inputs[i * 2]) << 4 | hex_digit(inputs[i * 2 + 1])));
+        }
+        run_frame(gb);
+    }
+
+    fprintf(out, "ok %llu %016llx", (unsigned long long)gb->cpu.cycles,
+            (unsigned long long)testrom_hash(t));
+
+    char *extract;
+    while ((extract = strtok_r(NULL, " \t\r\n", &save))) {
+        char *colon         = strchr(extract, ':');
+        unsigned long addr  = strtoul(extract, &end, 16);
+        unsigned long count = colon ? strtoul(colon + 1, NULL, 10) : 0;
+        if (!colon || end != colon || addr > 0xFFFF || !count || addr + count > 0x10000) {
+            fprintf(out, " -");  // keeps the extracts in their places
+            continue;
+        }
+        fputc(' ', out);
+        for (unsigned long i = 0; i < count; i++) {
+            fprintf(out, "%02x", mmu_read(&gb->mmu, (uint16_t)(addr + i)));
+        }
+    }
+    fputc('\n', out);
+}
+
+/* read one line from the connection (the request ends at the newline or EOF) */
+static bool read_request(int fd, char *buf, size_t size) {
+    size_t len = 0;
+    while (len < size - 1) {
+        ssize_t n = read(fd, buf + len, size - 1 - len);
+        if (n < 0 && errno == EINTR)
+            continue;
+        if (n <= 0)
+            break;
+        len += (size_t)n;
+        if (memchr(buf + len - n, '\n', (size_t)n))
+            break;
+    }
+    buf[len] = '\0';
+    return len > 0;
+}
+
+static void serve_child(TestRom *t, int conn) {
+    static char request[FORKSERVER_REQUEST_MAX];
+
+    FILE *out = fdopen(conn, "w");
+    if (!out)
+        _exit(1);
+    if (read_request(conn, request, sizeof(request)))
+        branch(t, request, out);
+    fclose(out);
+    _exit(0);
+}
+
+bool forkserver_serve(TestRom *t, const char *path) {
+    struct sockaddr_un addr = {.sun_family = AF_UNIX};
+    if (strlen(path) >= sizeof(addr.sun_path)) {
+        fprintf(stderr, "Socket path too long: %s\n", path);
+        return false;
+    }
+    strcpy(addr.sun_path, path);
+
+    /* a stale socket from an earlier run goes, anything else at the path stays */
+    struct stat st;
+    if (lstat(path, &st) == 0) {
+        if (!S_ISSOCK(st.st_mode)) {
+            fprintf(stderr, "Not a socket, leaving it alone: %s\n", path);
+            return false;
+        }
+        unlink(path);
+    }
+
+    int listener = socket(AF_UNIX, SOCK_STREAM, 0);
+    if (listener < 0) {
+        perror("socket");
+        return false;
+    }
+    if (bind(listener, (struct sockaddr *)&addr, sizeof(addr)) != 0 ||
+        listen(listener, SOMAXCONN) != 0) {
+        fprintf(stderr, "Failed to listen on %s: %s\n", path, strerror(errno));
+        close(listener);
+        return false;
+    }
+
+    /* children are never waited for, and accept should give up on a stop signal */
+    struct sigaction sa = {.sa_handler = SIG_IGN};
+    sigaction(SIGCHLD, &sa, NULL);
+    sa.sa_handler = stop;
+    sigaction(SIGINT, &sa, NULL);
+    sigaction(SIGTERM, &sa, NULL);
+
+    printf("serving %s at cycle %llu\n", path, (unsigned long long)t->gb.cpu.cycles);
+    fflush(stdout);
+
+    /* a client hanging up before accept or a stop signal is nothing to worry
+    about. anything else (out of descriptors, say) would only fail again */
+    bool ok = true;
+    while (!stopping) {
+        int conn = accept(listener, NULL, NULL);
+        if (conn < 0) {
+            if (errno == EINTR || errno == ECONNABORTED)
+                continue;
+            perror("accept");
+            ok = false;
+            break;
+        }
+
+        pid_t pid = fork();
+        if (pid == 0) {
+            close(listener);
+            serve_child(t, conn);
+        }
+        if (pid < 0) {
+            perror("fork");
+            dprintf(conn, "error fork failed\n");
+        }
+        close(conn);
+    }
+
+    close(listener);
+    unlink(path);
+    return ok;
+}
@@ -0,0 +1,36 @@
+#ifndef FORKSERVER_HEADER
+#define FORKSERVER_HEADER
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "testrom.h"
+
+/* fork server: the machine is booted once to an interesting point, then every
+request is served by a fork() of this process, so the children share the ROM,
+the code and all the memory they don't write, copy-on-write, and nobody runs
+the boot ROM or title screen again.
+
+one request per connection on a local (Unix) socket, one line of text:
+    branch <frames> <inputs> [<addr>:<length> ...]
+- frames: frames to run (DMG_FRAME_CYCLES each, with or without the LCD)
+- inputs: two hex digits per frame, the buttons held during it, "-" for none.
+  bits 0-7: A, B, select, start, right, left, up, down (1 = pressed). the last
+  one keeps being held if there are fewer than frames
+- addr:length: memory to send back, hex address and decimal length
+answered with one line:
+    ok <cycles> <framebuffer hash> [<hex bytes> ...]
+or "error <reason>" */
+
+#define FORKSERVER_REQUEST_MAX (1 << 20)  // longest request line in bytes
+
+// run the machine in t until frames have passed or pc is about to execute
+// (pc < 0: no breakpoint), at most budget cycles. false if the breakpoint wasn't reached
+bool forkserver_boot(TestRom *t, uint64_t frames, int pc, uint64_t budget);
+
+// listen on path and serve requests until SIGINT or SIGTERM. false if the socket
+// couldn't be set up (or something other than a socket is in the way at path),
+// or accept failed for good
+bool forkserver_serve(TestRom *t, const char *path);
+
+#endif
@@ -0,0 +1,182 @@
+#define _POSIX_C_SOURCE 200809L
+
+/* headless test runner: runs a ROM with no window or audio, prints whatever it
+sends over the serial port and stops on a verdict. blargg-style ROMs print
+"Passed" or "Failed"; anything that settles into a JR -2 self-loop without
+printing either is reported as stuck. -m reads mooneye's register signature
+instead. -a runs the M-cycle accurate CPU tier (see opcodes.h). -R runs the
+ROM's code compiled by gb-recomp where it can (see recomp.h).
+-S turns it into a fork server instead (see forkserver.h): it boots the ROM for
+-F frames or up to the -P breakpoint, then serves branch requests on the socket.
+-L runs the ROM linked to a second one over the link cable (see link.h), each on
+its own thread, for the whole budget, and prints a hash of each machine's state:
+the cable is deterministic, so every run prints the same hashes.
+usage: gb-headless [-b boot_rom] [-t seconds] [-a] [-m] [-R compiled.so] <rom>
+       gb-headless [-b boot_rom] [-t seconds] [-a] [-R compiled.so] -S socket [-F frames | -P pc] <rom>
+       gb-headless [-b boot_rom] [-t seconds] [-a] -L other_rom <rom>
+exit status: 0 passed, 1 failed, 2 timed out, 3 stuck in a loop, 4 bad usage
+(-S and -L: 0 or 4) */
+
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+
+#include "forkserver.h"
+#include "link.h"
+#include "pacer.h"
+#include "recomp.h"
+#include "savestate.h"
+#include "testrom.h"
+
+#define DEFAULT_SECONDS 60.0  // emulated, not wall clock
+#define EXIT_USAGE 4
+
+static void usage(const char *name) {
+    fprintf(stderr,
+            "usage: %s [-b boot_rom] [-t seconds] [-a] [-m] [-R compiled.so] <rom>\n"
+            "       %s [-b boot_rom] [-t seconds] [-a] [-R compiled.so] -S socket [-F frames | -P pc] <rom>\n"
+            "       %s [-b boot_rom] [-t seconds] [-a] -L other_rom <rom>\n",
+            name, name, name);
+}
+
+/* boot to the branch point, then fork a child per request until stopped */
+static int serve(TestRom *t, const char *path, uint64_t frames, int pc, uint64_t budget) {
+    if (!forkserver_boot(t, frames, pc, budget)) {
+        fprintf(stderr, "Breakpoint %04X not reached\n", pc);
+        return EXIT_USAGE;
+    }
+    return forkserver_serve(t, path) ? 0 : EXIT_USAGE;
+}
+
+typedef struct linked_side_t {
+    LinkCable *cable;
+    int side;
+    uint64_t cycles;
+} linked_side_t;
+
+static void *run_side(void *arg) {
+    linked_side_t *s = arg;
+    link_run_cycles(s->cable, s->side, s->cycles);
+    return NULL;
+}
+
+/* both machines for the whole budget, one thread each. neither side closes the
+cable until both are through, so the end of the run can't depend on which
+thread finishes first */
+static int run_linked(TestRom *t, const char *path, const char *boot_rom, const char *other,
+                      uint64_t cycles) {
+    static TestRom u;
+    u.echo = false;
+    testrom_init(&u, boot_rom, other);
+    u.gb.cpu.accurate = t->gb.cpu.accurate;
+
+    LinkCable cable;
+    if (!link_init(&cable, &t->gb, &u.gb)) {
+        testrom_free(&u);
+        return EXIT_USAGE;
+    }
+
+    linked_side_t sides[2] = {{&cable, 0, cycles}, {&cable, 1, cycles}};
+    pthread_t threads[2];
+    int started = 0;
+    for (; started < 2; started++) {
+        if (pthread_create(&threads[started], NULL, run_side, &sides[started]) != 0) {
+            fprintf(stderr, "Failed to start the thread for side %d\n", started);
+            break;
+        }
+    }
+    if (started < 2)
+        link_close(&cable, 1);  // side 0 doesn't wait for a side that never runs
+    for (int i = 0; i < started; i++) {
+        pthread_join(threads[i], NULL);
+    }
+    link_close(&cable, 0);
+    link_close(&cable, 1);
+    link_free(&cable);
+
+    if (started == 2) {
+        const char *paths[2] = {path, other};
+        GB *gbs[2]           = {&t->gb, &u.gb};
+        for (int side = 0; side < 2; side++) {
+            printf("%s: %llu cycles, state %016llx\n", paths[side],
+                   (unsigned long long)gbs[side]->cpu.cycles,
+                   (unsigned long long)savestate_hash(gbs[side]));
+        }
+    }
+    testrom_free(&u);
+    return started == 2 ? 0 : EXIT_USAGE;
+}
+
+int main(int argc, char *argv[]) {
+    const char *boot_rom    = TESTROM_DEFAULT_BOOT;
+    double seconds          = DEFAULT_SECONDS;
+    test_detect_t detect    = DETECT_SERIAL;
+    bool accurate           = false;
+    const char *socket_path = NULL;
+    uint64_t frames         = 0;
+    int pc                  = -1;
+    const char *compiled    = NULL;
+    const char *other_rom   = NULL;
+
+    int opt;
+    while ((opt = getopt(argc, argv, "b:t:amR:S:F:P:L:")) != -1) {
+        switch (opt) {
+            case 'b': boot_rom = optarg; break;
+            case 't': seconds = atof(optarg); break;
+            case 'a': accurate = true; break;
+            case 'm': detect = DETECT_MOONEYE; break;
+            case 'R': compiled = optarg; break;
+            case 'L': other_rom = optarg; break;
+            case 'S': socket_path = optarg; break;
+            case 'F': frames = strtoull(optarg, NULL, 0); break;
+            case 'P': pc = (int)(strtoul(optarg, NULL, 16) & 0xFFFF); break;
+            default: usage(argv[0]); return EXIT_USAGE;
+        }
+    }
+    if (optind != argc - 1 || seconds <= 0.0 || (socket_path && other_rom)) {
+        usage(argv[0]);
+        return EXIT_USAGE;
+    }
+
+    static TestRom t;
+    t.echo = !socket_path;  // the server's children keep quiet
+    testrom_init(&t, boot_rom, argv[optind]);
+    t.gb.cpu.accurate = accurate;
+
+    static Recomp recomp;
+    if (compiled) {
+        if (!recomp_load(&recomp, compiled, &t.gb.mmu)) {
+            testrom_free(&t);
+            return EXIT_USAGE;
+        }
+        t.gb.recomp = &recomp;
+    }
+
+    if (other_rom) {
+        int status = run_linked(&t, argv[optind], boot_rom, other_rom,
+                                (uint64_t)(seconds * DMG_CLOCK_HZ));
+        testrom_free(&t);
+        recomp_free(&recomp);
+        return status;
+    }
+
+    if (socket_path) {
+        int status = serve(&t, socket_path, frames, pc, (uint64_t)(seconds * DMG_CLOCK_HZ));
+        testrom_free(&t);
+        recomp_free(&recomp);
+        return status;
+    }
+
+    test_result_t result = testrom_run(&t, detect, (uint64_t)(seconds * DMG_CLOCK_HZ));
+
+    static const char *names[] = {"passed", "failed", "timed out", "stuck in a loop"};
+    if (t.serial_length && t.serial[t.serial_length - 1] != '\n')
+        putchar('\n');
+    printf("%s: %s after %.2f s emulated\n", argv[optind], names[result],
+           t.gb.cpu.cycles / DMG_CLOCK_HZ);
+
+    testrom_free(&t);
+    recomp_free(&recomp);
+    return result;
+}
@@ -0,0 +1,378 @@
+#include "inflate.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+#define WINDOW_SIZE 32768                 // deflate's largest distance
+#define RING_SIZE (WINDOW_SIZE * 2)       // history plus the output not handed out yet
+#define RING_MASK (RING_SIZE - 1)
+#define INPUT_SIZE 65536
+#define FAST_BITS 10                      // codes up to this long decode with one lookup
+#define MAX_BITS 15
+
+/* canonical Huffman code. the fast table is indexed by the next FAST_BITS input
+bits and holds length << 9 | symbol (0 = longer code, decoded the slow way from
+count/symbol like zlib's puff) */
+typedef struct huffman_t {
+    uint16_t fast[1 << FAST_BITS];
+    uint16_t count[MAX_BITS + 1];  // codes of each length
+    uint16_t symbol[288];          // symbols ordered by code
+} huffman_t;
+
+typedef struct inflater_t {
+    FILE *f;
+    uint8_t in[INPUT_SIZE];
+    size_t in_pos, in_len;
+
+    uint64_t bits;  // bit buffer, next bit lowest
+    int bit_count;
+    int padding;  // zero bits added past the end of the input
+    bool truncated;
+
+    uint8_t ring[RING_SIZE];
+    uint64_t out;      // bytes produced
+    uint64_t flushed;  // bytes handed to the sink
+    inflate_sink_fn sink;
+    void *user;
+    bool stopped;
+
+    huffman_t lit, dist;
+} inflater_t;
+
+/* ---- input ---- */
+
+static void refill(inflater_t *s) {
+    while (s->bit_count <= 56) {
+        if (s->in_pos == s->in_len) {
+            s->in_len = fread(s->in, 1, INPUT_SIZE, s->f);
+            s->in_pos = 0;
+        }
+        uint64_t byte = 0;
+        if (s->in_pos < s->in_len)
+            byte = s->in[s->in_pos++];
+        else
+            s->padding += 8;
+        s->bits |= byte << s->bit_count;
+        s->bit_count += 8;
+    }
+}
+
+static inline void drop(inflater_t *s, int n) {
+    s->bits >>= n;
+    s->bit_count -= n;
+    if (s->bit_count < s->padding)
+        s->truncated = true;
+}
+
+static inline uint32_t get_bits(inflater_t *s, int n) {
+    if (s->bit_count < n)
+        refill(s);
+    uint32_t v = (uint32_t)(s->bits & ((1ull << n) - 1));
+    drop(s, n);
+    return v;
+}
+
+/* ---- output ---- */
+
+static void flush(inflater_t *s) {
+    size_t n = (size_t)(s->out - s->flushed);
+    if (!n || s->stopped)
+        return;
+    /* chunks start 32 KB aligned, so they never wrap around the ring */
+    if (!s->sink(s->user, s->ring + (s->flushed & RING_MASK), n))
+        s->stopped = true;
+    s->flushed = s->out;
+}
+
+static inline void put(inflater_t *s, uint8_t byte) {
+    s->ring[s->out++ & RING_MASK] = byte;
+    if (s->out - s->flushed == WINDOW_SIZE)
+        flush(s);
+}
+
+/* ---- Huffman codes ---- */
+
+static bool build(huffman_t *h, const uint8_t *lengths, int n) {
+    memset(h->count, 0, sizeof(h->count));
+    for (int i = 0; i < n; i++) {
+        h->count[lengths[i]]++;
+    }
+
+    /* over-subscribed sets can't be decoded. incomplete ones are allowed (a
+    distance code with a single symbol is) */
+    int left = 1;
+    for (int len = 1; len <= MAX_BITS; len++) {
+        left = (left << 1) - h->count[len];
+        if (left < 0)
+            return false;
+    }
+
+    uint16_t offset[MAX_BITS + 2] = {0};
+    uint16_t next[MAX_BITS + 1]   = {0};
+    for (int len = 1; len <= MAX_BITS; len++) {
+        offset[len + 1] = offset[len] + h->count[len];
+        if (len > 1)
+            next[len] = (next[len - 1] + h->count[len - 1]) << 1;
+    }
+
+    memset(h->fast, 0, sizeof(h->fast));
+    for (int sym = 0; sym < n; sym++) {
+        int len = lengths[sym];
+        if (!len)
+            continue;
+        h->symbol[offset[len]++] = (uint16_t)sym;
+
+        uint32_t code = next[len]++;
+        if (len > FAST_BITS)
+            continue;
+        /* codes are stored first bit first, the table is indexed lowest bit first */
+        uint32_t reversed = 0;
+        for (int i = 0; i < len; i++) {
+            reversed = (reversed << 1) | ((code >> i) & 1);
+        }
+        for (uint32_t i = reversed; i < (1u << FAST_BITS); i += 1u << len) {
+            h->fast[i] = (uint16_t)(len << 9 | sym);
+        }
+    }
+    return true;
+}
+
+static int decode(inflater_t *s, const huffman_t *h) {
+    if (s->bit_count < MAX_BITS)
+        refill(s);
+
+    uint16_t entry = h->fast[s->bits & ((1u << FAST_BITS) - 1)];
+    if (entry) {
+        drop(s, entry >> 9);
+        return entry & 0x1FF;
+    }
+
+    uint64_t bits = s->bits;
+    int code = 0, first = 0, index = 0;
+    for (int len = 1; len <= MAX_BITS; len++) {
+        code |= (int)(bits & 1);
+        bits >>= 1;
+        int count = h->count[len];
+        if (code - count < first) {
+            drop(s, len);
+            return h->symbol[index + (code - first)];
+        }
+        index += count;
+        first = (first + count) << 1;
+        code <<= 1;
+    }
+    return -1;
+}
+
+/* ---- blocks ---- */
+
+static bool stored(inflater_t *s) {
+    drop(s, s->bit_count & 7);  // to a byte boundary
+    uint32_t len  = get_bits(s, 16);
+    uint32_t nlen = get_bits(s, 16);
+    if (len != (~nlen & 0xFFFF))
+        return false;
+
+    while (len-- && !s->truncated && !s->stopped) {
+        put(s, (uint8_t)get_bits(s, 8));
+    }
+    return true;
+}
+
+static bool codes(inflater_t *s) {
+    static const uint16_t length_base[29] = {3,  4,  5,  6,  7,  8,  9,  10,  11,  13,
+                                             15, 17, 19, 23, 27, 31, 35, 43,  51,  59,
+                                             67, 83, 99, 115, 131, 163, 195, 227, 258};
+    static const uint8_t length_extra[29] = {0, 0, 0, 0, 0, 0, 0, 0, 1, 1, 1, 1, 2, 2, 2,
+                                             2, 3, 3, 3, 3, 4, 4, 4, 4, 5, 5, 5, 5, 0};
+    static const uint16_t dist_base[30]   = {1,    2,    3,    4,    5,    7,     9,     13,
+                                             17,   25,   33,   49,   65,   97,    129,   193,
+                                             257,  385,  513,  769,  1025, 1537,  2049,  3073,
+                                             4097, 6145, 8193, 12289, 16385, 24577};
+    static const uint8_t dist_extra[30]   = {0, 0, 0, 0, 1, 1, 2, 2,  3,  3,  4,  4,  5,  5,  6,
+                                             6, 7, 7, 8, 8, 9, 9, 10, 10, 11, 11, 12, 12, 13, 13};
+
+    while (!s->truncated && !s->stopped) {
+        int sym = decode(s, &s->lit);
+        if (sym < 0)
+            return false;
+        if (sym < 256) {
+            put(s, (uint8_t)sym);
+            continue;
+        }
+        if (sym == 256)
+            return true;
+
+        sym -= 257;
+        if (sym >= 29)
+            return false;
+        uint32_t len = length_base[sym] + get_bits(s, length_extra[sym]);
+
+        sym = decode(s, &s->dist);
+        if (sym < 0 || sym >= 30)
+            return false;
+        uint32_t dist = dist_base[sym] + get_bits(s, dist_extra[sym]);
+        if (dist > s->out)
+            return false;
+
+        /* byte by byte: the source may overlap what is being written */
+        while (len--) {
+            put(s, s->ring[(s->out - dist) & RING_MASK]);
+        }
+    }
+    return true;
+}
+
+static bool fixed(inflater_t *s) {
+    static huffman_t lit, dist;
+    static bool built;
+
+    if (!built) {
+        uint8_t lengths[288];
+        memset(lengths, 8, 144);
+        memset(lengths + 144, 9, 112);
+        memset(lengths + 256, 7, 24);
+        memset(lengths + 280, 8, 8);
+        build(&lit, lengths, 288);
+        memset(lengths, 5, 30);
+        build(&dist, lengths, 30);
+        built = true;
+    }
+    s->lit  = lit;
+    s->dist = dist;
+    return codes(s);
+}
+
+static bool dynamic(inflater_t *s) {
+    static const uint8_t order[19] = {16, 17, 18, 0, 8, 7, 9, 6, 10, 5,
+                                      11, 4,  12, 3, 13, 2, 14, 1, 15};
+    uint8_t lengths[288 + 32] = {0};
+
+    int nlen  = get_bits(s, 5) + 257;
+    int ndist = get_bits(s, 5) + 1;
+    int ncode = get_bits(s, 4) + 4;
+    if (nlen > 286 || ndist > 30)
+        return false;
+
+    for (int i = 0; i < ncode; i++) {
+        lengths[order[i]] = (uint8_t)get_bits(s, 3);
+    }
+    if (!build(&s->lit, lengths, 19))
+        return false;
+
+    /* literal/length and distance code lengths, run-length coded */
+    for (int i = 0; i < nlen + ndist;) {
+        int sym = decode(s, &s->lit);
+        if (sym < 0 || s->truncated)
+            return false;
+        if (sym < 16) {
+            lengths[i++] = (uint8_t)sym;
+            continue;
+        }
+
+        uint8_t len = 0;
+        int repeat;
+        if (sym == 16) {
+            if (i == 0)
+                return false;
+            len    = lengths[i - 1];
+            repeat = 3 + get_bits(s, 2);
+        } else if (sym == 17) {
+            repeat = 3 + get_bits(s, 3);
+        } else {
+            repeat = 11 + get_bits(s, 7);
+        }
+        if (i + repeat > nlen + ndist)
+            return false;
+        while (repeat--) {
+            lengths[i++] = len;
+        }
+    }
+    if (!lengths[256])  // no end of block code
+        return false;
+
+    if (!build(&s->lit, lengths, nlen) || !build(&s->dist, lengths + nlen, ndist))
+        return false;
+    return codes(s);
+}
+
+inflate_result_t inflate_stream(FILE *f, inflate_sink_fn sink, void *user) {
+    inflater_t *s = calloc(1, sizeof(inflater_t));
+    if (!s)
+        return INFLATE_NO_MEMORY;
+    s->f    = f;
+    s->sink = sink;
+    s->user = user;
+
+    bool ok = true, last = false;
+    while (ok && !last && !s->truncated && !s->stopped) {
+        last      = get_bits(s, 1);
+        int type  = get_bits(s, 2);
+        switch (type) {
+            case 0: ok = stored(s); break;
+            case 1: ok = fixed(s); break;
+            case 2: ok = dynamic(s); break;
+            default: ok = false; break;
+        }
+    }
+    flush(s);
+
+    inflate_result_t result = s->stopped     ? INFLATE_STOPPED
+                              : !ok          ? INFLATE_BAD_DATA
+                              : s->truncated ? INFLATE_TRUNCATED
+                                             : INFLATE_OK;
+    free(s);
+    return result;
+}
+
+static uint32_t le(const uint8_t *p, int n) {
+    uint32_t v = 0;
+    for (int i = n - 1; i >= 0; i--) {
+        v = (v << 8) | p[i];
+    }
+    return v;
+}
+
+inflate_result_t inflate_zip(FILE *f, inflate_sink_fn sink, void *user) {
+    /* local file header: signature, versions, flags, method, times, crc, sizes,
+    then the name and extra field */
+    uint8_t header[30];
+    if (fread(header, 1, sizeof(header), f) != sizeof(header))
+        return INFLATE_TRUNCATED;
+    if (le(header, 4) != 0x04034B50)
+        return INFLATE_BAD_DATA;
+
+    uint32_t flags  = le(header + 6, 2);
+    uint32_t method = le(header + 8, 2);
+    uint32_t size   = le(header + 18, 4);
+    long skip       = (long)le(header + 26, 2) + (long)le(header + 28, 2);
+    if (fseek(f, skip, SEEK_CUR) != 0)
+        return INFLATE_TRUNCATED;
+
+    if (method == 8)
+        return inflate_stream(f, sink, user);
+    if (method != 0 || (flags & 0x08))  // stored, with the size up front
+        return INFLATE_BAD_DATA;
+
+    uint8_t chunk[WINDOW_SIZE];
+    while (size) {
+        size_t n = size < sizeof(chunk) ? size : sizeof(chunk);
+        if (fread(chunk, 1, n, f) != n)
+            return INFLATE_TRUNCATED;
+        if (!sink(user, chunk, n))
+            return INFLATE_STOPPED;
+        size -= (uint32_t)n;
+    }
+    return INFLATE_OK;
+}
+
+const char *inflate_error(inflate_result_t result) {
+    switch (result) {
+        case INFLATE_OK:        return "ok";
+        case INFLATE_STOPPED:   return "stopped";
+        case INFLATE_BAD_DATA:  return "not a deflate stream or zip member this can read";
+        case INFLATE_TRUNCATED: return "input ends early";
+        case INFLATE_NO_MEMORY: return "out of memory";
+    }
+    return "unknown error";
+}
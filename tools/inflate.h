@@ -0,0 +1,33 @@
+#ifndef INFLATE_HEADER
+#define INFLATE_HEADER
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+
+/* streaming inflate (RFC 1951), enough to read the zip files test suites ship
+their logs in. input is read from a FILE as it is needed and output handed to a
+callback 32 KB at a time, so a multi-gigabyte log never sits in memory or on
+disk whole */
+
+// gets the output in order. return false to stop early
+typedef bool (*inflate_sink_fn)(void *user, const uint8_t *data, size_t size);
+
+typedef enum inflate_result_t {
+    INFLATE_OK,
+    INFLATE_STOPPED,    // the sink returned false
+    INFLATE_BAD_DATA,   // not a deflate stream (or zip member) we understand
+    INFLATE_TRUNCATED,  // input ended in the middle
+    INFLATE_NO_MEMORY,
+} inflate_result_t;
+
+// a raw deflate stream starting at the current position of f
+inflate_result_t inflate_stream(FILE *f, inflate_sink_fn sink, void *user);
+
+// the first member of the zip archive at the current position of f (deflated or stored)
+inflate_result_t inflate_zip(FILE *f, inflate_sink_fn sink, void *user);
+
+const char *inflate_error(inflate_result_t result);
+
+#endif
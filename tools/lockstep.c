@@ -0,0 +1,289 @@
+#define _POSIX_C_SOURCE 200809L
+
+/* lockstep verifier: runs the same ROM on two machines, one on the core's fast
+paths and one on the reference paths (gb_reference), feeding both the same
+input. every N cycles, once both have reached the same cycle, their state
+hashes are compared. on a mismatch both machines go back to the last matching
+check and replay it instruction by instruction, and the first point where
+they differ is reported with both states dumped.
+usage: gb-lockstep [-b boot_rom] [-t seconds] [-n cycles] [-p seed] <rom>
+-p presses pseudo-random buttons at every check, the same ones on both machines
+exit status: 0 the machines agreed, 1 diverged, 2 bad usage */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "pacer.h"
+#include "rom.h"
+#include "snapshot.h"
+#include "statehash.h"
+#include "testrom.h"
+
+#define DEFAULT_SECONDS 60.0              // emulated, not wall clock
+#define DEFAULT_INTERVAL DMG_FRAME_CYCLES  // cycles between checks
+#define ALIGN_LIMIT 1000000                // steps to bring the cycle counters together
+#define DIFF_MAX 16                        // differing bytes listed per part
+#define EXIT_USAGE 2
+
+typedef struct Engine {
+    const char *name;
+    bool reference;  // runs with gb_reference set
+    GB gb;
+    void *good;  // snapshot at the last check that matched
+
+    /* steps in a row that took no cycles (HALT with an interrupt already
+    pending). machines are only comparable at the same cycle after the same
+    number of these */
+    int zero_steps;
+} Engine;
+
+static void usage(const char *name) {
+    fprintf(stderr, "usage: %s [-b boot_rom] [-t seconds] [-n cycles] [-p seed] <rom>\n",
+            name);
+}
+
+static void engine_init(Engine *e, const char *name, bool reference, const char *boot_rom,
+                        const char *rom) {
+    e->name      = name;
+    e->reference = reference;
+    gb_init(&e->gb);
+    load_boot_rom(&e->gb.mmu, boot_rom);
+    load_rom(&e->gb.mmu, rom);
+    e->good = malloc(gb_snapshot_size(&e->gb));
+    if (!e->good) {
+        fprintf(stderr, "Failed to allocate snapshot\n");
+        exit(EXIT_USAGE);
+    }
+}
+
+static void engine_free(Engine *e) {
+    free(e->good);
+    mmu_cleanup(&e->gb.mmu);
+}
+
+/* one instruction (or HALT stretch). the frame flag is cleared after every
+step, as gb_run_frame does, so the fast paths that stop at frame ends see them */
+static void step(Engine *e) {
+    uint64_t cycles = e->gb.cpu.cycles;
+
+    gb_reference    = e->reference;
+    cpu_step(&e->gb.cpu);
+    e->gb.ppu.frame_completed = 0;
+    gb_reference              = false;
+
+    e->zero_steps             = e->gb.cpu.cycles == cycles ? e->zero_steps + 1 : 0;
+}
+
+/* step whichever machine is behind until both have run the same number of
+cycles (and zero-cycle steps). false if they never meet */
+static bool align(Engine *fast, Engine *ref) {
+    for (int i = 0; i < ALIGN_LIMIT; i++) {
+        uint64_t a = fast->gb.cpu.cycles, b = ref->gb.cpu.cycles;
+        if (a == b && fast->zero_steps == ref->zero_steps)
+            return true;
+        if (a == b)
+            step(fast->zero_steps < ref->zero_steps ? fast : ref);
+        else
+            step(a < b ? fast : ref);
+    }
+    return false;
+}
+
+static bool same_state(Engine *fast, Engine *ref) {
+    return fast->gb.cpu.cycles == ref->gb.cpu.cycles &&
+           gb_state_hash(&fast->gb) == gb_state_hash(&ref->gb);
+}
+
+static void dump_cpu(const Engine *e) {
+    const CPU *cpu = &e->gb.cpu;
+    printf("%-9s A:%02X F:%02X B:%02X C:%02X D:%02X E:%02X H:%02X L:%02X SP:%04X PC:%04X "
+           "IME:%d IF:%02X IE:%02X HALT:%d cycle %llu\n",
+           e->name, cpu->a, cpu->f, cpu->b, cpu->c, cpu->d, cpu->e, cpu->h, cpu->l, cpu->sp,
+           cpu->pc, cpu->ime, cpu->ifr, cpu->ier, cpu->halt, (unsigned long long)cpu->cycles);
+}
+
+static void dump_devices(const Engine *e) {
+    const Timer *t  = &e->gb.timer;
+    const PPU *ppu  = &e->gb.ppu;
+    const Serial *s = &e->gb.serial;
+    printf("%-9s DIV:%04X TIMA:%02X TMA:%02X TAC:%02X  LY:%3d mode %d dot %3d  "
+           "SB:%02X SC:%02X bits %d\n",
+           e->name, t->div, t->tima, t->tma, t->tac, ppu->current_scanline, ppu->mode,
+           ppu->scanline_cycles, s->sb, s->sc, s->bits_left);
+}
+
+/* the first differing bytes of one part, at their bus address (or struct offset) */
+static void dump_bytes(const char *part, unsigned base, const uint8_t *a, const uint8_t *b,
+                       size_t size) {
+    int shown = 0;
+    for (size_t i = 0; i < size; i++) {
+        if (a[i] == b[i])
+            continue;
+        if (shown == DIFF_MAX) {
+            printf("  %-7s ...\n", part);
+            return;
+        }
+        printf("  %-7s %04X: fast %02X  reference %02X\n", part, (unsigned)(base + i), a[i],
+               b[i]);
+        shown++;
+    }
+}
+
+static void dump_part(gb_hash_part_t part, const GB *a, const GB *b) {
+    const char *name = gb_hash_part_name(part);
+    switch (part) {
+        case GB_HASH_APU:
+            dump_bytes(name, 0, (const uint8_t *)&a->apu, (const uint8_t *)&b->apu,
+                       offsetof(APU, output));
+            break;
+        case GB_HASH_JOYPAD:
+            dump_bytes(name, 0, (const uint8_t *)&a->joypad, (const uint8_t *)&b->joypad,
+                       sizeof(Joypad));
+            break;
+        case GB_HASH_MBC:
+            dump_bytes(name, 0, (const uint8_t *)&a->mmu.mbc, (const uint8_t *)&b->mmu.mbc,
+                       sizeof(MBC));
+            break;
+        case GB_HASH_IO:
+            dump_bytes(name, 0xFF00, a->mmu.io, b->mmu.io, sizeof(a->mmu.io));
+            break;
+        case GB_HASH_VRAM:
+            dump_bytes(name, 0x8000, a->mmu.vram, b->mmu.vram, sizeof(a->mmu.vram));
+            break;
+        case GB_HASH_WRAM:
+            dump_bytes(name, 0xC000, a->mmu.wram, b->mmu.wram, sizeof(a->mmu.wram));
+            break;
+        case GB_HASH_OAM:
+            dump_bytes(name, 0xFE00, a->mmu.oam, b->mmu.oam, sizeof(a->mmu.oam));
+            break;
+        case GB_HASH_HRAM:
+            dump_bytes(name, 0xFF80, a->mmu.hram, b->mmu.hram, sizeof(a->mmu.hram));
+            break;
+        case GB_HASH_EXT_RAM:
+            dump_bytes(name, 0xA000, mmu_ext_ram(&a->mmu), mmu_ext_ram(&b->mmu),
+                       mmu_ext_ram_size(&a->mmu));
+            break;
+        default: break;  // registers, already printed
+    }
+}
+
+static void report(const Engine *fast, const Engine *ref, uint16_t pc, uint8_t opcode,
+                   bool halted) {
+    uint64_t a[GB_HASH_PARTS], b[GB_HASH_PARTS];
+    gb_state_hashes(&fast->gb, a);
+    gb_state_hashes(&ref->gb, b);
+
+    if (halted)
+        printf("diverged at cycle %llu, halted at %04X\n\n",
+               (unsigned long long)fast->gb.cpu.cycles, pc);
+    else
+        printf("diverged at cycle %llu, after the instruction at %04X (opcode %02X)\n\n",
+               (unsigned long long)fast->gb.cpu.cycles, pc, opcode);
+    dump_cpu(fast);
+    dump_cpu(ref);
+    dump_devices(fast);
+    dump_devices(ref);
+
+    printf("\ndiffering parts:");
+    for (int i = 0; i < GB_HASH_PARTS; i++) {
+        if (a[i] != b[i])
+            printf(" %s", gb_hash_part_name(i));
+    }
+    printf("\n");
+    for (int i = 0; i < GB_HASH_PARTS; i++) {
+        if (a[i] != b[i])
+            dump_part(i, &fast->gb, &ref->gb);
+    }
+}
+
+/* the last check matched and this one didn't: replay the stretch in between one
+instruction at a time, comparing wherever the cycle counters meet */
+static void pinpoint(Engine *fast, Engine *ref, uint64_t check) {
+    gb_snapshot_restore(&fast->gb, fast->good);
+    gb_snapshot_restore(&ref->gb, ref->good);
+    fast->zero_steps = ref->zero_steps = 0;
+
+    uint16_t pc    = fast->gb.cpu.pc;
+    uint8_t opcode = 0;
+    bool halted    = false;
+    while (fast->gb.cpu.cycles < check) {
+        pc     = fast->gb.cpu.pc;
+        opcode = mmu_read(&fast->gb.mmu, pc);
+        halted = fast->gb.cpu.halt;
+        step(fast);
+        if (!align(fast, ref) || !same_state(fast, ref)) {
+            report(fast, ref, pc, opcode, halted);
+            return;
+        }
+    }
+    printf("diverged at the check at cycle %llu but not when replayed from the one before\n",
+           (unsigned long long)check);
+}
+
+int main(int argc, char *argv[]) {
+    const char *boot_rom = TESTROM_DEFAULT_BOOT;
+    double seconds       = DEFAULT_SECONDS;
+    long interval        = DEFAULT_INTERVAL;
+    bool mash            = false;
+    unsigned seed        = 0;
+
+    int opt;
+    while ((opt = getopt(argc, argv, "b:t:n:p:")) != -1) {
+        switch (opt) {
+            case 'b': boot_rom = optarg; break;
+            case 't': seconds = atof(optarg); break;
+            case 'n': interval = atol(optarg); break;
+            case 'p':
+                mash = true;
+                seed = (unsigned)strtoul(optarg, NULL, 0);
+                break;
+            default: usage(argv[0]); return EXIT_USAGE;
+        }
+    }
+    if (optind != argc - 1 || seconds <= 0.0 || interval <= 0) {
+        usage(argv[0]);
+        return EXIT_USAGE;
+    }
+
+    static Engine fast, ref;
+    engine_init(&fast, "fast", false, boot_rom, argv[optind]);
+    engine_init(&ref, "reference", true, boot_rom, argv[optind]);
+    gb_snapshot_save(&fast.gb, fast.good);
+    gb_snapshot_save(&ref.gb, ref.good);
+
+    uint64_t limit  = (uint64_t)(seconds * DMG_CLOCK_HZ);
+    uint64_t checks = 0;
+    bool diverged   = false;
+    srand(seed);
+
+    while (fast.gb.cpu.cycles < limit) {
+        uint64_t check = fast.gb.cpu.cycles + (uint64_t)interval;
+        while (fast.gb.cpu.cycles < check) {
+            step(&fast);
+        }
+        if (!align(&fast, &ref) || !same_state(&fast, &ref)) {
+            pinpoint(&fast, &ref, fast.gb.cpu.cycles);
+            diverged = true;
+            break;
+        }
+        checks++;
+
+        if (mash) {
+            uint8_t buttons = (uint8_t)(rand() & 0x0F), dpad = (uint8_t)(rand() & 0x0F);
+            joypad_set(&fast.gb.joypad, buttons, dpad);
+            joypad_set(&ref.gb.joypad, buttons, dpad);
+        }
+        gb_snapshot_save(&fast.gb, fast.good);
+        gb_snapshot_save(&ref.gb, ref.good);
+    }
+
+    if (!diverged)
+        printf("%s: %llu checks matched over %.2f s emulated\n", argv[optind],
+               (unsigned long long)checks, fast.gb.cpu.cycles / DMG_CLOCK_HZ);
+
+    engine_free(&fast);
+    engine_free(&ref);
+    return diverged ? 1 : 0;
+}
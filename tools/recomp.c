@@ -0,0 +1,539 @@
+#define _POSIX_C_SOURCE 200809L
+
+/* static recompiler (see recomp.h). walks a ROM from 0100 and the interrupt
+vectors, following jumps, calls and RSTs into the bank that LD A,n / LD (nn),A
+selected when it can tell, splits what it reaches into basic blocks and groups
+them into functions: the blocks reached from a CALL or RST target (or a vector)
+without leaving its 16 KB region. it then writes one C function per function
+for the runtime to enter at any of its blocks. the C is built against the
+emulator's own headers and opcodes.c, so it only fits the build it came from:
+  cc -O2 -shared -fPIC -fvisibility=hidden -Iinclude -Ilib out.c -o out.so
+and then gb-headless -R out.so rom.gb
+usage: gb-recomp <rom> <out.c>
+exit status: 0 written, 1 the ROM couldn't be read or the output written, 2 bad usage */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "mbc.h"
+#include "recomp.h"
+
+#define BANK_SIZE 0x4000
+#define UNKNOWN (-1)  // bank at 4000-7FFF, or the value in A: not worked out
+#define EXIT_USAGE 2
+
+/* per byte of the image */
+#define SEEN 0x01    // an instruction starts here
+#define LEADER 0x02  // a basic block starts here
+#define ENTRY 0x04   // a function starts here
+
+/* what one instruction does to the flow of control and to what the walk knows */
+typedef struct Insn {
+    uint32_t offset;  // in the image
+    uint16_t addr;    // on the bus
+    uint8_t op, cb;   // opcode, and the second byte of a CB-prefixed one
+    int length;
+    int target;      // jump, branch or call target address, -1 for none
+    bool call;       // target is a function that comes back (CALL, RST)
+    bool next;       // may carry on at the following instruction
+    bool ends;       // control may go elsewhere: the block ends here
+    bool rom_write;  // may write 0000-7FFF, i.e. switch banks
+    int select;      // bank a constant write selects, UNKNOWN if none or not known
+    int a;           // A afterwards if known
+} Insn;
+
+typedef struct Block {
+    Insn *insn;
+    size_t count, cap;
+    int64_t succ[2];  // offsets control may go to inside the region, -1 for none
+} Block;
+
+typedef struct Rom {
+    const char *path;
+    uint8_t *data;
+    uint32_t size;
+    MBC mbc;  // as reset, to work out what a write to it selects
+
+    uint8_t *flags;   // SEEN, LEADER, ENTRY
+    int16_t *bank;    // at each leader: the bank known to be at 4000-7FFF
+    int32_t *owner;   // at each leader: the function (entry offset) its block belongs to
+    uint32_t *work;   // leaders still to walk
+    size_t work_count;
+} Rom;
+
+static void usage(const char *name) {
+    fprintf(stderr, "usage: %s <rom> <out.c>\n", name);
+}
+
+static int length(uint8_t op) {
+    switch (op) {
+        case 0x01: case 0x08: case 0x11: case 0x21: case 0x31: case 0xC2: case 0xC3: case 0xC4:
+        case 0xCA: case 0xCC: case 0xCD: case 0xD2: case 0xD4: case 0xDA: case 0xDC: case 0xEA:
+        case 0xFA:
+            return 3;
+        case 0x06: case 0x0E: case 0x10: case 0x16: case 0x18: case 0x1E: case 0x20: case 0x26:
+        case 0x28: case 0x2E: case 0x30: case 0x36: case 0x38: case 0x3E: case 0xC6: case 0xCB:
+        case 0xCE: case 0xD6: case 0xDE: case 0xE0: case 0xE6: case 0xE8: case 0xEE: case 0xF0:
+        case 0xF6: case 0xF8: case 0xFE:
+            return 2;
+        default: return 1;
+    }
+}
+
+/* the opcodes decode_and_execute has no case for (STOP among them) */
+static bool valid(uint8_t op) {
+    switch (op) {
+        case 0x10: case 0xD3: case 0xDB: case 0xDD: case 0xE3: case 0xE4: case 0xEB: case 0xEC:
+        case 0xED: case 0xF4: case 0xFC: case 0xFD:
+            return false;
+        default: return true;
+    }
+}
+
+/* whether an instruction leaves something other than A's old value in A */
+static bool writes_a(uint8_t op, uint8_t cb) {
+    if (op == 0xCB)
+        return (cb & 7) == 7 && (cb < 0x40 || cb >= 0x80);  // not BIT n,A
+    if (op >= 0x78 && op <= 0xB7)
+        return true;  // LD A,r and the ALU ops but CP
+    switch (op) {
+        case 0x07: case 0x0A: case 0x0F: case 0x17: case 0x1A: case 0x1F: case 0x27: case 0x2A:
+        case 0x2F: case 0x3A: case 0x3C: case 0x3D: case 0x3E: case 0xC6: case 0xCE: case 0xD6:
+        case 0xDE: case 0xE6: case 0xEE: case 0xF0: case 0xF1: case 0xF2: case 0xF6: case 0xFA:
+            return true;
+        default: return false;
+    }
+}
+
+/* whether an instruction may write to 0000-7FFF: any write through a register
+pair or the stack, and constant addresses below 8000 */
+static bool writes_rom(uint8_t op, uint8_t cb, uint16_t nn) {
+    if (op == 0xCB)
+        return (cb & 7) == 6 && (cb < 0x40 || cb >= 0x80);  // (HL), but not BIT n,(HL)
+    if (op >= 0x70 && op <= 0x77)
+        return op != 0x76;
+    if ((op & 0xC7) == 0xC7 || (op & 0xCF) == 0xC5)
+        return true;  // RST, PUSH
+    switch (op) {
+        case 0x02: case 0x12: case 0x22: case 0x32: case 0x34: case 0x35: case 0x36: case 0xC4:
+        case 0xCC: case 0xCD: case 0xD4: case 0xDC:
+            return true;
+        case 0x08: return nn < 0x8000 || nn == 0xFFFF;  // the high byte wraps to 0000
+        case 0xEA: return nn < 0x8000;
+        default:   return false;
+    }
+}
+
+static uint16_t address_of(uint32_t offset) {
+    return offset < BANK_SIZE ? (uint16_t)offset : (uint16_t)(BANK_SIZE + offset % BANK_SIZE);
+}
+
+/* where an address reads from with bank at 4000-7FFF and bank 0 below, -1 if not
+ROM or not known */
+static int64_t resolve(const Rom *rom, int addr, int bank) {
+    if (addr < 0 || addr >= 0x8000)
+        return -1;
+    if (addr < BANK_SIZE)
+        return addr < (int)rom->size ? addr : -1;
+    if (bank == UNKNOWN)
+        return -1;
+    uint32_t offset = (uint32_t)bank * BANK_SIZE + (uint32_t)(addr - BANK_SIZE);
+    return offset < rom->size ? (int64_t)offset : -1;
+}
+
+/* the bank a write of value to addr (below 8000) leaves at 4000-7FFF, starting
+from reset: the emulator's own MBC decides */
+static int selects(const Rom *rom, uint16_t addr, uint8_t value) {
+    MBC mbc = rom->mbc;
+    mbc_write_control(&mbc, addr, value);
+    return mbc_get_current_rom_bank(&mbc);
+}
+
+/* false if there is no instruction the emulator runs at offset, or it doesn't fit
+in the image or its region */
+static bool decode(const Rom *rom, uint32_t offset, int a, Insn *in) {
+    uint32_t region_end = (offset / BANK_SIZE + 1) * BANK_SIZE;
+    uint8_t op          = rom->data[offset];
+    int len             = length(op);
+    if (!valid(op) || offset + len > rom->size || offset + len > region_end)
+        return false;
+
+    const uint8_t *p = &rom->data[offset];
+    uint16_t nn      = len == 3 ? (uint16_t)(p[1] | p[2] << 8) : 0;
+    memset(in, 0, sizeof(*in));
+    in->offset = offset;
+    in->addr   = address_of(offset);
+    in->op     = op;
+    in->cb     = op == 0xCB ? p[1] : 0;
+    in->length = len;
+    in->target = -1;
+    in->next   = true;
+    in->select = UNKNOWN;
+
+    uint16_t after = in->addr + len;
+    if (op == 0x18 || (op & 0xE7) == 0x20) {  // JR, JR cc
+        in->target = (uint16_t)(after + (int8_t)p[1]);
+        in->next   = op != 0x18;
+        in->ends   = true;
+    } else if (op == 0xC3 || (op & 0xE7) == 0xC2) {  // JP, JP cc
+        in->target = nn;
+        in->next   = op != 0xC3;
+        in->ends   = true;
+    } else if (op == 0xCD || (op & 0xE7) == 0xC4) {  // CALL, CALL cc
+        in->target = nn;
+        in->call = in->ends = true;
+    } else if ((op & 0xC7) == 0xC7) {  // RST
+        in->target = op & 0x38;
+        in->call = in->ends = true;
+    } else if (op == 0xC9 || op == 0xD9 || op == 0xE9) {  // RET, RETI, JP (HL)
+        in->next = false;
+        in->ends = true;
+    } else if ((op & 0xE7) == 0xC0 || op == 0x76) {  // RET cc, HALT
+        in->ends = true;
+    }
+
+    in->rom_write = writes_rom(op, in->cb, nn);
+    in->a         = op == 0x3E ? p[1] : op == 0xAF ? 0 : writes_a(op, in->cb) ? UNKNOWN : a;
+    if (op == 0xEA && nn < 0x8000 && a != UNKNOWN)
+        in->select = selects(rom, nn, (uint8_t)a);
+    return true;
+}
+
+/* where control goes after in when it carries on, -1 if not into known ROM */
+static int64_t next_of(const Rom *rom, const Insn *in, int bank) {
+    uint32_t offset = in->offset + in->length;
+    if (offset % BANK_SIZE && offset < rom->size)
+        return offset;
+    return resolve(rom, in->addr + in->length, bank);  // into the next region
+}
+
+/* ---- discovery: every leader, function entry and instruction reachable ---- */
+
+/* a leader only where there is an instruction to compile: a branch into data or
+an opcode the emulator doesn't run is left to the interpreter, which then has no
+block to enter and no label to jump to */
+static void add_leader(Rom *rom, int64_t offset, int bank, bool entry) {
+    Insn in;
+    if (offset < 0 || !decode(rom, (uint32_t)offset, UNKNOWN, &in))
+        return;
+    if (offset >= BANK_SIZE)
+        bank = (int)(offset / BANK_SIZE);  // code up there is in its own bank
+    if (entry)
+        rom->flags[offset] |= ENTRY;
+    if (rom->flags[offset] & LEADER)
+        return;
+    rom->flags[offset] |= LEADER;
+    rom->bank[offset] = (int16_t)bank;
+    if (!(rom->flags[offset] & SEEN))
+        rom->work[rom->work_count++] = (uint32_t)offset;
+}
+
+/* straight-line code from a leader until control may go elsewhere, queueing
+every place it may go */
+static void walk(Rom *rom, uint32_t start) {
+    int bank        = rom->bank[start];
+    int a           = UNKNOWN;
+    uint32_t offset = start;
+
+    for (;;) {
+        if (offset != start && (rom->flags[offset] & SEEN)) {
+            add_leader(rom, offset, bank, false);  // ran into code already walked
+            return;
+        }
+        Insn in;
+        if (!decode(rom, offset, a, &in))
+            return;
+        rom->flags[offset] |= SEEN;
+
+        if (in.target >= 0)
+            add_leader(rom, resolve(rom, in.target, bank), bank, in.call);
+        if (in.op == 0xEA && in.rom_write) {
+            bank = in.select;
+            /* switching its own bank out: what follows comes from the new one */
+            if (offset >= BANK_SIZE) {
+                add_leader(rom, resolve(rom, in.addr + in.length, bank), bank, false);
+                return;
+            }
+        }
+        int64_t next = next_of(rom, &in, bank);
+        if (in.ends || next != offset + in.length) {
+            if (in.next)
+                add_leader(rom, next, bank, false);
+            return;
+        }
+        offset = (uint32_t)next;
+        a      = in.a;
+    }
+}
+
+/* ---- blocks and functions ---- */
+
+static void block_push(Block *b, const Insn *in) {
+    if (b->count == b->cap) {
+        b->cap  = b->cap ? b->cap * 2 : 64;
+        b->insn = realloc(b->insn, b->cap * sizeof(Insn));
+        if (!b->insn) {
+            fprintf(stderr, "Failed to allocate a block\n");
+            exit(1);
+        }
+    }
+    b->insn[b->count++] = *in;
+}
+
+static bool same_region(int64_t a, int64_t b) {
+    return a >= 0 && b >= 0 && a / BANK_SIZE == b / BANK_SIZE;
+}
+
+/* the block at a leader: its instructions up to the end of the walk there or
+the next leader, and where it may go on to within its region */
+static void block_at(const Rom *rom, uint32_t start, Block *b) {
+    int bank        = rom->bank[start];
+    int a           = UNKNOWN;
+    uint32_t offset = start;
+    b->count        = 0;
+    b->succ[0] = b->succ[1] = -1;
+
+    for (;;) {
+        Insn in;
+        if (!decode(rom, offset, a, &in) || !(rom->flags[offset] & SEEN))
+            return;
+        block_push(b, &in);
+        if (in.op == 0xEA && in.rom_write)
+            bank = in.select;
+
+        int64_t next = next_of(rom, &in, bank);
+        if (in.ends) {
+            if (in.target >= 0 && !in.call)
+                b->succ[0] = resolve(rom, in.target, bank);
+            if (in.next)
+                b->succ[1] = next;
+            break;
+        }
+        if (next != offset + in.length || (rom->flags[next] & LEADER)) {
+            b->succ[0] = next;
+            break;
+        }
+        offset = (uint32_t)next;
+        a      = in.a;
+    }
+    for (int i = 0; i < 2; i++) {
+        if (!same_region(b->succ[i], start))
+            b->succ[i] = -1;
+    }
+}
+
+/* the unowned blocks reachable from entry without leaving its region */
+static void claim(Rom *rom, uint32_t entry, Block *b, uint32_t *stack) {
+    size_t top = 0;
+    if (rom->owner[entry] >= 0)
+        return;
+    rom->owner[entry] = (int32_t)entry;
+    stack[top++]      = entry;
+    while (top) {
+        block_at(rom, stack[--top], b);
+        for (int i = 0; i < 2; i++) {
+            int64_t s = b->succ[i];
+            if (s >= 0 && (rom->flags[s] & LEADER) && rom->owner[s] < 0) {
+                rom->owner[s] = (int32_t)entry;
+                stack[top++]  = (uint32_t)s;
+            }
+        }
+    }
+}
+
+/* ---- output ---- */
+
+/* jumps to whichever of the block's successors the function has, by pc */
+static void emit_dispatch(FILE *out, const Rom *rom, const Block *b, uint32_t fn) {
+    int cases = 0;
+    for (int i = 0; i < 2; i++) {
+        int64_t s = b->succ[i];
+        if (s >= 0 && rom->owner[s] == (int32_t)fn && (i == 0 || s != b->succ[0]))
+            cases++;
+    }
+    if (cases) {
+        fprintf(out, "    switch (cpu->pc) {\n");
+        for (int i = 0; i < 2; i++) {
+            int64_t s = b->succ[i];
+            if (s >= 0 && rom->owner[s] == (int32_t)fn && (i == 0 || s != b->succ[0]))
+                fprintf(out, "        case 0x%04X: goto b_%06X;\n", address_of((uint32_t)s),
+                        (unsigned)s);
+        }
+        fprintf(out, "    }\n");
+    }
+    fprintf(out, "    return;\n");
+}
+
+static void emit_block(FILE *out, const Rom *rom, const Block *b, uint32_t fn) {
+    const Insn *last = &b->insn[b->count - 1];
+    fprintf(out, "b_%06X:\n", (unsigned)b->insn[0].offset);
+
+    for (size_t i = 0; i < b->count; i++) {
+        const Insn *in = &b->insn[i];
+        fprintf(out, "    /* %04X:", in->addr);
+        for (int k = 0; k < in->length; k++) {
+            fprintf(out, " %02X", rom->data[in->offset + k]);
+        }
+        fprintf(out, " */\n");
+
+        /* the fetch, then the opcode's own code with any operands still read from pc */
+        if (in->op == 0xCB) {
+            fprintf(out, "    cpu->pc = 0x%04X;\n    decode_cb(cpu, 0x%02X);\n",
+                    (uint16_t)(in->addr + 2), in->cb);
+        } else {
+            fprintf(out, "    cpu->pc = 0x%04X;\n    decode_and_execute(cpu, 0x%02X);\n",
+                    (uint16_t)(in->addr + 1), in->op);
+        }
+        fprintf(out, "    if (recomp_next(gb, end))\n        return;\n");
+
+        /* a HALT bug or a call's bank can't be followed from here */
+        if (in->op == 0x76 || in->call) {
+            fprintf(out, "    return;\n");
+            return;
+        }
+        if (in->rom_write && in != last)
+            fprintf(out, "    if (!recomp_mapped(gb, 0x%06X))\n        return;\n",
+                    (unsigned)(in->offset + in->length));
+    }
+
+    if (last->rom_write)
+        fprintf(out, "    return;\n");  // the bank may have changed under the successors
+    else
+        emit_dispatch(out, rom, b, fn);
+}
+
+static bool emit(FILE *out, Rom *rom, Block *b) {
+    size_t functions = 0, blocks = 0, insns = 0;
+
+    fprintf(out, "/* generated by gb-recomp from %s. build with\n", rom->path);
+    fprintf(out, "   cc -O2 -shared -fPIC -fvisibility=hidden -Iinclude -Ilib <this>.c -o <this>.so\n");
+    fprintf(out, "against the same tree as the emulator that loads it (see recomp.h) */\n\n");
+    fprintf(out, "#define OPCODES_RECOMP\n#include \"opcodes.c\"\n#include \"recomp.h\"\n");
+
+    for (uint32_t fn = 0; fn < rom->size; fn++) {
+        if (!(rom->flags[fn] & LEADER) || rom->owner[fn] != (int32_t)fn)
+            continue;
+        functions++;
+
+        fprintf(out, "\n/* %s at %06X (%04X) */\n", rom->flags[fn] & ENTRY ? "function" : "code",
+                (unsigned)fn, address_of(fn));
+        fprintf(out, "static void f_%06X(GB *gb, uint64_t end) {\n", (unsigned)fn);
+        fprintf(out, "    CPU *cpu = &gb->cpu;\n\n    switch (cpu->pc) {\n");
+        for (uint32_t o = fn / BANK_SIZE * BANK_SIZE; o < rom->size && o / BANK_SIZE == fn / BANK_SIZE;
+             o++) {
+            if ((rom->flags[o] & LEADER) && rom->owner[o] == (int32_t)fn)
+                fprintf(out, "        case 0x%04X: goto b_%06X;\n", address_of(o), (unsigned)o);
+        }
+        fprintf(out, "    }\n    return;\n\n");
+
+        for (uint32_t o = fn / BANK_SIZE * BANK_SIZE; o < rom->size && o / BANK_SIZE == fn / BANK_SIZE;
+             o++) {
+            if (!(rom->flags[o] & LEADER) || rom->owner[o] != (int32_t)fn)
+                continue;
+            block_at(rom, o, b);
+            if (!b->count)
+                continue;
+            emit_block(out, rom, b, fn);
+            blocks++;
+            insns += b->count;
+        }
+        fprintf(out, "}\n");
+    }
+
+    fprintf(out, "\nstatic const RecompBlock blocks[] = {\n");
+    for (uint32_t o = 0; o < rom->size; o++) {
+        if (!(rom->flags[o] & LEADER) || rom->owner[o] < 0)
+            continue;
+        block_at(rom, o, b);
+        if (b->count)
+            fprintf(out, "    {0x%06X, f_%06X},\n", (unsigned)o, (unsigned)rom->owner[o]);
+    }
+    fprintf(out, "};\n\n");
+    fprintf(out, "__attribute__((visibility(\"default\"))) const RecompTable recomp_table = {\n");
+    fprintf(out, "    RECOMP_VERSION, sizeof(GB), 0x%016llXull, %zu, blocks,\n};\n",
+            (unsigned long long)recomp_rom_hash(rom->data, rom->size), blocks);
+
+    printf("%s: %zu functions, %zu blocks, %zu instructions\n", rom->path, functions, blocks,
+           insns);
+    return !ferror(out);
+}
+
+static bool load(Rom *rom, const char *path) {
+    FILE *f = fopen(path, "rb");
+    if (!f) {
+        fprintf(stderr, "Failed to open ROM: %s\n", path);
+        return false;
+    }
+    fseek(f, 0, SEEK_END);
+    long size = ftell(f);
+    fseek(f, 0, SEEK_SET);
+    if (size < 0x150 || size > 0x800000) {
+        fprintf(stderr, "Not a ROM image: %s\n", path);
+        fclose(f);
+        return false;
+    }
+
+    rom->path  = path;
+    rom->size  = (uint32_t)size;
+    rom->data  = malloc(rom->size);
+    rom->flags = calloc(rom->size, 1);
+    rom->bank  = malloc(rom->size * sizeof(int16_t));
+    rom->owner = malloc(rom->size * sizeof(int32_t));
+    rom->work  = malloc(rom->size * sizeof(uint32_t));
+    bool ok    = rom->data && rom->flags && rom->bank && rom->owner && rom->work &&
+              fread(rom->data, 1, rom->size, f) == rom->size;
+    fclose(f);
+    if (!ok) {
+        fprintf(stderr, "Failed to read ROM: %s\n", path);
+        return false;
+    }
+    for (uint32_t i = 0; i < rom->size; i++) {
+        rom->owner[i] = -1;
+    }
+    mbc_init(&rom->mbc, rom->data[0x147], rom->data[0x148], rom->data[0x149]);
+    return true;
+}
+
+int main(int argc, char *argv[]) {
+    if (argc != 3) {
+        usage(argv[0]);
+        return EXIT_USAGE;
+    }
+
+    static Rom rom;
+    if (!load(&rom, argv[1]))
+        return 1;
+
+    /* with no banking, 4000-7FFF always holds bank 1 */
+    int start_bank = rom.size <= 2 * BANK_SIZE ? 1 : UNKNOWN;
+    add_leader(&rom, 0x0100, start_bank, true);
+    for (int vector = 0x40; vector <= 0x60; vector += 8) {
+        add_leader(&rom, vector, start_bank, true);
+    }
+    while (rom.work_count) {
+        walk(&rom, rom.work[--rom.work_count]);
+    }
+
+    /* functions first, by address, then whatever only they lead to */
+    Block b = {0};
+    for (uint32_t o = 0; o < rom.size; o++) {
+        if (rom.flags[o] & ENTRY)
+            claim(&rom, o, &b, rom.work);
+    }
+    for (uint32_t o = 0; o < rom.size; o++) {
+        if (rom.flags[o] & LEADER)
+            claim(&rom, o, &b, rom.work);
+    }
+
+    FILE *out = fopen(argv[2], "w");
+    if (!out) {
+        fprintf(stderr, "Failed to open %s\n", argv[2]);
+        return 1;
+    }
+    bool ok = emit(out, &rom, &b);
+    ok      = fclose(out) == 0 && ok;
+    if (!ok)
+        fprintf(stderr, "Failed to write %s\n", argv[2]);
+    return ok ? 0 : 1;
+}
@@ -0,0 +1,127 @@
+#define _POSIX_C_SOURCE 200809L
+
+/* resampler benchmark: cost of turning the APU's 65536 Hz output into 48 kHz,
+fed in the same 1024-frame chunks the frontend asks for, plus a quick quality
+check on a 1 kHz tone. usage: resampler-bench [seconds of audio] */
+
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+
+#include "resampler.h"
+
+#define OUT_RATE 48000
+#define CHUNK 1024
+#define RUNS 5
+
+static double now_seconds(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+/* left: 1 kHz sine, right: 440 Hz square, both at half scale */
+static void generate(apu_sample_t *in, size_t frames) {
+    const double pi = 3.14159265358979323846;
+    for (size_t i = 0; i < frames; i++) {
+        double t    = (double)i / APU_SAMPLE_RATE;
+        in[i].left  = (int16_t)lround(16384.0 * sin(2.0 * pi * 1000.0 * t));
+        in[i].right = fmod(t * 440.0, 1.0) < 0.5 ? 16384 : -16384;
+    }
+}
+
+/* resample everything, chunk by chunk, with rate control fed a fill level that
+wanders around its target like the real ring's does. returns output frames */
+static size_t run(Resampler *rs, const apu_sample_t *in, size_t in_frames, apu_sample_t *out,
+                  size_t out_cap, bool wobble) {
+    size_t used = 0, produced = 0, chunk = 0;
+
+    while (used < in_frames && produced + CHUNK <= out_cap) {
+        if (wobble)
+            resampler_control(rs, 2048 + (chunk++ % 64) * 32 - 1024, 2048);
+
+        size_t need = resampler_input_needed(rs, CHUNK);
+        if (need > in_frames - used)
+            need = in_frames - used;
+        produced += resampler_run(rs, in + used, need, out + produced, CHUNK);
+        used += need;
+    }
+    return produced;
+}
+
+/* power of the 1 kHz component against everything else (SINAD), over whole cycles */
+static double sinad_db(const apu_sample_t *out, size_t frames) {
+    const double pi = 3.14159265358979323846;
+    size_t start    = 4800;  // skip the filter's warm-up
+    size_t n        = (frames - start) / 48 * 48;
+    double c = 0.0, s = 0.0, total = 0.0;
+
+    for (size_t i = 0; i < n; i++) {
+        double v = out[start + i].left;
+        double w = 2.0 * pi * 1000.0 * (double)i / OUT_RATE;
+        c += v * cos(w);
+        s += v * sin(w);
+        total += v * v;
+    }
+    double tone = 2.0 * (c * c + s * s) / n;
+    return 10.0 * log10(tone / (total - tone));
+}
+
+int main(int argc, char *argv[]) {
+    double seconds = argc > 1 ? atof(argv[1]) : 10.0;
+    if (seconds <= 0.0) {
+        fprintf(stderr, "usage: %s [seconds of audio]\n", argv[0]);
+        return 1;
+    }
+
+    size_t in_frames  = (size_t)(seconds * APU_SAMPLE_RATE);
+    size_t out_cap    = (size_t)(seconds * OUT_RATE * (1.0 + RESAMPLER_MAX_ADJUST)) + 2 * CHUNK;
+    apu_sample_t *in  = malloc(in_frames * sizeof(apu_sample_t));
+    apu_sample_t *out = malloc(out_cap * sizeof(apu_sample_t));
+    if (!in || !out) {
+        fprintf(stderr, "Failed to allocate %.1f seconds of audio\n", seconds);
+        return 1;
+    }
+    generate(in, in_frames);
+
+#if defined(__SSE2__)
+    const char *path = "SSE2";
+#elif defined(__ARM_NEON) && defined(__aarch64__)
+    const char *path = "NEON";
+#else
+    const char *path = "scalar";
+#endif
+
+    printf("%d Hz -> %d Hz, %d taps x %d phases, %s, %.1f s of audio\n", APU_SAMPLE_RATE,
+           OUT_RATE, RESAMPLER_TAPS, RESAMPLER_PHASES, path, seconds);
+
+    for (int wobble = 0; wobble <= 1; wobble++) {
+        double best     = 1e9;
+        size_t produced = 0;
+
+        for (int r = 0; r < RUNS; r++) {
+            Resampler rs;
+            if (!resampler_init(&rs, APU_SAMPLE_RATE, OUT_RATE))
+                return 1;
+
+            double t0 = now_seconds();
+            produced  = run(&rs, in, in_frames, out, out_cap, wobble);
+            double t  = now_seconds() - t0;
+            if (t < best)
+                best = t;
+            resampler_free(&rs);
+        }
+
+        double per_second = best / seconds * 1e3;
+        printf("%-14s %8.3f ms per second of audio (%.0fx real time), %zu frames out\n",
+               wobble ? "rate control:" : "fixed ratio:", per_second, 1e3 / per_second,
+               produced);
+        if (!wobble)
+            printf("%-14s %8.1f dB SINAD on the 1 kHz tone\n", "", sinad_db(out, produced));
+    }
+
+    free(in);
+    free(out);
+    return 0;
+}
@@ -0,0 +1,455 @@
+#define _POSIX_C_SOURCE 200809L
+
+/* parallel test-suite runner: every ROM in a manifest, headless, one process per
+ROM and as many at once as there are cores. a ROM that crashes the core or hangs
+it only takes its own process down.
+
+manifest lines: <detect> <budget> [accurate] [<hash>] <rom>
+- detect: serial, mooneye or hash (see testrom.h)
+- budget: emulated seconds the ROM gets to reach its verdict
+- accurate: run on the M-cycle accurate CPU tier (see opcodes.h)
+- hash: for hash tests only, the expected framebuffer hash in hex ("-" to just
+  print it: the test is reported as INFO and doesn't fail the run)
+- rom: path relative to the ROM directory, up to the end of the line (blargg's
+  file names have spaces and commas in them)
+- lines starting with # are comments
+
+usage: gb-suite [-j jobs] [-x junit.xml] [-b boot_rom] <manifest> <rom_dir>
+exit status: 0 if everything passed (INFO aside), 1 otherwise, 2 bad usage or manifest */
+
+#include <errno.h>
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/wait.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "pacer.h"
+#include "testrom.h"
+
+#define MAX_TESTS 1024
+#define PATH_LEN 512
+#define DETAIL_LEN 160
+#define WALL_MARGIN 10  // wall clock seconds on top of the budget before a ROM counts as hung
+
+typedef enum status_t {
+    STATUS_PASS,
+    STATUS_FAIL,
+    STATUS_TIMEOUT,
+    STATUS_LOOP,
+    STATUS_CRASH,
+    STATUS_INFO,  // a hash test with no hash to compare to: reported, neither pass nor fail
+    STATUS_COUNT,
+} status_t;
+
+static const char *status_names[] = {"PASS", "FAIL", "TIMEOUT", "LOOP", "CRASH", "INFO"};
+
+typedef struct test_case_t {
+    char rom[PATH_LEN];  // relative to the ROM directory
+    test_detect_t detect;
+    double budget;  // emulated seconds
+    bool accurate;  // M-cycle accurate CPU tier
+    uint64_t expected_hash;
+    bool has_hash;
+
+    status_t status;
+    double emulated;  // seconds
+    double wall;      // seconds
+    char detail[DETAIL_LEN];
+} test_case_t;
+
+// what a child sends back: one write, well under PIPE_BUF
+typedef struct child_report_t {
+    test_result_t result;
+    uint64_t cycles;
+    uint64_t hash;
+    uint8_t regs[6];         // B C D E H L
+    char last_line[DETAIL_LEN];  // last line of serial output
+} child_report_t;
+
+typedef struct slot_t {
+    pid_t pid;
+    int fd;
+    int test;
+    double start;
+} slot_t;
+
+static double now_seconds(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+/* ---- manifest ---- */
+
+static char *skip_space(char *s) {
+    while (*s == ' ' || *s == '\t')
+        s++;
+    return s;
+}
+
+static char *next_token(char **s) {
+    char *start = skip_space(*s);
+    char *end   = start;
+    while (*end && *end != ' ' && *end != '\t')
+        end++;
+    if (*end)
+        *end++ = '\0';
+    *s = end;
+    return start;
+}
+
+static int load_manifest(const char *path, test_case_t *tests) {
+    FILE *f = fopen(path, "r");
+    if (!f) {
+        fprintf(stderr, "Failed to open manifest: %s\n", path);
+        return -1;
+    }
+
+    char line[1024];
+    int n = 0, number = 0;
+    while (fgets(line, sizeof(line), f)) {
+        number++;
+        line[strcspn(line, "\r\n")] = '\0';
+        char *s = skip_space(line);
+        if (!*s || *s == '#')
+            continue;
+
+        if (n == MAX_TESTS) {
+            fprintf(stderr, "%s: more than %d tests\n", path, MAX_TESTS);
+            fclose(f);
+            return -1;
+        }
+        test_case_t *tc = &tests[n];
+        memset(tc, 0, sizeof(*tc));
+
+        char *detect = next_token(&s);
+        char *budget = next_token(&s);
+        s            = skip_space(s);
+        if (!strncmp(s, "accurate", 8) && (s[8] == ' ' || s[8] == '\t')) {
+            tc->accurate = true;
+            s += 8;
+        }
+        if (!strcmp(detect, "serial")) {
+            tc->detect = DETECT_SERIAL;
+        } else if (!strcmp(detect, "mooneye")) {
+            tc->detect = DETECT_MOONEYE;
+        } else if (!strcmp(detect, "hash")) {
+            tc->detect = DETECT_HASH;
+            char *hash = next_token(&s);
+            tc->has_hash = strcmp(hash, "-") != 0;
+            if (tc->has_hash)
+                tc->expected_hash = strtoull(hash, NULL, 16);
+        } else {
+            fprintf(stderr, "%s:%d: unknown detection '%s'\n", path, number, detect);
+            fclose(f);
+            return -1;
+        }
+
+        tc->budget = atof(budget);
+        char *rom  = skip_space(s);
+        size_t len = strlen(rom);
+        while (len && (rom[len - 1] == ' ' || rom[len - 1] == '\t'))
+            rom[--len] = '\0';
+        if (tc->budget <= 0.0 || !len || len >= PATH_LEN) {
+            fprintf(stderr, "%s:%d: expected <detect> <budget> [accurate] [<hash>] <rom>\n", path, number);
+            fclose(f);
+            return -1;
+        }
+        memcpy(tc->rom, rom, len + 1);
+        n++;
+    }
+    fclose(f);
+    return n;
+}
+
+/* ---- one test, in its own process ---- */
+
+static void last_line(const char *text, size_t length, char *out) {
+    while (length && (text[length - 1] == '\n' || text[length - 1] == ' '))
+        length--;
+    size_t start = length;
+    while (start && text[start - 1] != '\n')
+        start--;
+
+    size_t n = length - start < DETAIL_LEN - 1 ? length - start : DETAIL_LEN - 1;
+    memcpy(out, text + start, n);
+    out[n] = '\0';
+}
+
+static void run_child(const test_case_t *tc, const char *rom_dir, const char *boot_rom, int fd) {
+    /* the core reports on stdout as it loads, keep the scoreboard clean */
+    if (!freopen("/dev/null", "w", stdout))
+        _exit(EXIT_FAILURE);
+    alarm((unsigned)tc->budget + WALL_MARGIN);
+
+    char rom[PATH_LEN * 2];
+    snprintf(rom, sizeof(rom), "%s/%s", rom_dir, tc->rom);
+
+    static TestRom t;
+    testrom_init(&t, boot_rom, rom);
+    t.gb.cpu.accurate = tc->accurate;
+
+    child_report_t report = {0};
+    report.result = testrom_run(&t, tc->detect, (uint64_t)(tc->budget * DMG_CLOCK_HZ));
+    report.cycles = t.gb.cpu.cycles;
+    report.hash   = testrom_hash(&t);
+
+    const CPU *cpu = &t.gb.cpu;
+    uint8_t regs[] = {cpu->b, cpu->c, cpu->d, cpu->e, cpu->h, cpu->l};
+    memcpy(report.regs, regs, sizeof(regs));
+    last_line(t.serial, t.serial_length, report.last_line);
+
+    ssize_t written = write(fd, &report, sizeof(report));
+    _exit(written == (ssize_t)sizeof(report) ? EXIT_SUCCESS : EXIT_FAILURE);
+}
+
+static void judge(test_case_t *tc, const child_report_t *r) {
+    tc->emulated = r->cycles / DMG_CLOCK_HZ;
+
+    if (tc->detect == DETECT_HASH) {
+        if (!tc->has_hash) {
+            tc->status = STATUS_INFO;
+            snprintf(tc->detail, DETAIL_LEN, "framebuffer hash %016llx, nothing to compare to",
+                     (unsigned long long)r->hash);
+            return;
+        }
+        tc->status = r->hash == tc->expected_hash ? STATUS_PASS : STATUS_FAIL;
+        if (tc->status == STATUS_FAIL)
+            snprintf(tc->detail, DETAIL_LEN, "framebuffer hash %016llx, expected %016llx",
+                     (unsigned long long)r->hash, (unsigned long long)tc->expected_hash);
+        return;
+    }
+
+    switch (r->result) {
+        case TEST_PASSED:  tc->status = STATUS_PASS; break;
+        case TEST_FAILED:  tc->status = STATUS_FAIL; break;
+        case TEST_TIMEOUT: tc->status = STATUS_TIMEOUT; break;
+        case TEST_LOOP:    tc->status = STATUS_LOOP; break;
+    }
+    if (tc->status == STATUS_PASS)
+        return;
+
+    if (tc->detect == DETECT_MOONEYE)
+        snprintf(tc->detail, DETAIL_LEN, "B C D E H L = %02X %02X %02X %02X %02X %02X",
+                 r->regs[0], r->regs[1], r->regs[2], r->regs[3], r->regs[4], r->regs[5]);
+    else
+        snprintf(tc->detail, DETAIL_LEN, "%s", r->last_line);
+}
+
+static void collect(test_case_t *tc, const slot_t *slot, int status) {
+    child_report_t report;
+    ssize_t got = read(slot->fd, &report, sizeof(report));
+    close(slot->fd);
+    tc->wall = now_seconds() - slot->start;
+
+    if (WIFEXITED(status) && WEXITSTATUS(status) == 0 && got == (ssize_t)sizeof(report)) {
+        judge(tc, &report);
+        return;
+    }
+
+    tc->status = STATUS_CRASH;
+    if (WIFSIGNALED(status) && WTERMSIG(status) == SIGALRM)
+        snprintf(tc->detail, DETAIL_LEN, "still running after %.0f s of wall clock",
+                 tc->budget + WALL_MARGIN);
+    else if (WIFSIGNALED(status))
+        snprintf(tc->detail, DETAIL_LEN, "killed by signal %d", WTERMSIG(status));
+    else
+        snprintf(tc->detail, DETAIL_LEN, "exited with status %d", WEXITSTATUS(status));
+}
+
+static bool spawn(slot_t *slot, test_case_t *tests, int test, const char *rom_dir,
+                  const char *boot_rom) {
+    int fds[2];
+    if (pipe(fds) != 0) {
+        perror("pipe");
+        return false;
+    }
+
+    fflush(stdout);
+    pid_t pid = fork();
+    if (pid < 0) {
+        perror("fork");
+        close(fds[0]);
+        close(fds[1]);
+        return false;
+    }
+    if (pid == 0) {
+        close(fds[0]);
+        run_child(&tests[test], rom_dir, boot_rom, fds[1]);
+    }
+
+    close(fds[1]);
+    *slot = (slot_t){.pid = pid, .fd = fds[0], .test = test, .start = now_seconds()};
+    return true;
+}
+
+/* ---- reports ---- */
+
+static void xml_text(FILE *f, const char *s) {
+    for (; *s; s++) {
+        switch (*s) {
+            case '&': fputs("&amp;", f); break;
+            case '<': fputs("&lt;", f); break;
+            case '>': fputs("&gt;", f); break;
+            case '"': fputs("&quot;", f); break;
+            default:
+                if ((unsigned char)*s >= 0x20 || *s == '\t')
+                    fputc(*s, f);
+        }
+    }
+}
+
+static bool write_junit(const char *path, const test_case_t *tests, int n, double wall) {
+    FILE *f = fopen(path, "w");
+    if (!f) {
+        fprintf(stderr, "Failed to write JUnit report: %s\n", path);
+        return false;
+    }
+
+    int failures = 0, errors = 0;
+    for (int i = 0; i < n; i++) {
+        failures += tests[i].status != STATUS_PASS && tests[i].status != STATUS_CRASH &&
+                    tests[i].status != STATUS_INFO;
+        errors += tests[i].status == STATUS_CRASH;
+    }
+
+    fprintf(f, "<?xml version=\"1.0\" encoding=\"UTF-8\"?>\n");
+    fprintf(f, "<testsuites tests=\"%d\" failures=\"%d\" errors=\"%d\" time=\"%.3f\">\n", n,
+            failures, errors, wall);
+    fprintf(f, "  <testsuite name=\"dmg\" tests=\"%d\" failures=\"%d\" errors=\"%d\" time=\"%.3f\">\n",
+            n, failures, errors, wall);
+
+    for (int i = 0; i < n; i++) {
+        const test_case_t *tc = &tests[i];
+
+        /* classname from the directory (dots), name from the file */
+        char classname[PATH_LEN];
+        const char *name = strrchr(tc->rom, '/');
+        size_t dir_len   = name ? (size_t)(name - tc->rom) : 0;
+        name             = name ? name + 1 : tc->rom;
+        memcpy(classname, tc->rom, dir_len);
+        classname[dir_len] = '\0';
+        for (char *c = classname; *c; c++) {
+            if (*c == '/')
+                *c = '.';
+        }
+
+        fprintf(f, "    <testcase classname=\"");
+        xml_text(f, dir_len ? classname : "roms");
+        fprintf(f, "\" name=\"");
+        xml_text(f, name);
+        fprintf(f, "\" time=\"%.3f\"", tc->wall);
+
+        if (tc->status == STATUS_PASS) {
+            fprintf(f, "/>\n");
+            continue;
+        }
+        if (tc->status == STATUS_INFO) {
+            fprintf(f, ">\n      <skipped message=\"");
+            xml_text(f, tc->detail);
+            fprintf(f, "\"/>\n    </testcase>\n");
+            continue;
+        }
+        const char *tag = tc->status == STATUS_CRASH ? "error" : "failure";
+        fprintf(f, ">\n      <%s message=\"%s\">", tag, status_names[tc->status]);
+        xml_text(f, tc->detail);
+        fprintf(f, "</%s>\n    </testcase>\n", tag);
+    }
+
+    fprintf(f, "  </testsuite>\n</testsuites>\n");
+    return fclose(f) == 0;
+}
+
+static void usage(const char *name) {
+    fprintf(stderr, "usage: %s [-j jobs] [-x junit.xml] [-b boot_rom] <manifest> <rom_dir>\n",
+            name);
+}
+
+int main(int argc, char *argv[]) {
+    const char *boot_rom = TESTROM_DEFAULT_BOOT;
+    const char *junit    = NULL;
+    long jobs            = sysconf(_SC_NPROCESSORS_ONLN);
+
+    int opt;
+    while ((opt = getopt(argc, argv, "j:x:b:")) != -1) {
+        switch (opt) {
+            case 'j': jobs = atol(optarg); break;
+            case 'x': junit = optarg; break;
+            case 'b': boot_rom = optarg; break;
+            default: usage(argv[0]); return 2;
+        }
+    }
+    if (optind != argc - 2 || jobs < 1) {
+        usage(argv[0]);
+        return 2;
+    }
+    const char *rom_dir = argv[optind + 1];
+
+    static test_case_t tests[MAX_TESTS];
+    int n = load_manifest(argv[optind], tests);
+    if (n < 0)
+        return 2;
+    if (jobs > n)
+        jobs = n > 0 ? n : 1;
+
+    /* keep every core busy: start a ROM whenever one finishes */
+    slot_t *slots = calloc(jobs, sizeof(slot_t));
+    if (!slots) {
+        fprintf(stderr, "Failed to allocate %ld job slots\n", jobs);
+        return 2;
+    }
+    double start = now_seconds();
+    int next = 0, running = 0;
+
+    while (next < n || running) {
+        for (long s = 0; s < jobs && next < n; s++) {
+            if (slots[s].pid)
+                continue;
+            if (!spawn(&slots[s], tests, next, rom_dir, boot_rom))
+                return 2;
+            next++;
+            running++;
+        }
+
+        int status;
+        pid_t pid = wait(&status);
+        if (pid < 0) {
+            if (errno == EINTR)
+                continue;
+            perror("wait");
+            return 2;
+        }
+        for (long s = 0; s < jobs; s++) {
+            if (slots[s].pid == pid) {
+                collect(&tests[slots[s].test], &slots[s], status);
+                slots[s].pid = 0;
+                running--;
+                break;
+            }
+        }
+    }
+    double wall = now_seconds() - start;
+    free(slots);
+
+    /* scoreboard, in manifest order */
+    int counts[STATUS_COUNT] = {0};
+    double emulated          = 0.0;
+    for (int i = 0; i < n; i++) {
+        const test_case_t *tc = &tests[i];
+        counts[tc->status]++;
+        emulated += tc->emulated;
+        printf("%-7s %7.2f s  %s%s%s\n", status_names[tc->status], tc->emulated, tc->rom,
+               tc->detail[0] ? "  " : "", tc->detail);
+    }
+    printf("\n%d/%d passed (%d failed, %d timed out, %d looping, %d crashed, %d unchecked) in "
+           "%.2f s, %ld jobs, %.1f s emulated\n",
+           counts[STATUS_PASS], n, counts[STATUS_FAIL], counts[STATUS_TIMEOUT],
+           counts[STATUS_LOOP], counts[STATUS_CRASH], counts[STATUS_INFO], wall, jobs, emulated);
+
+    if (junit && !write_junit(junit, tests, n, wall))
+        return 2;
+    return counts[STATUS_PASS] + counts[STATUS_INFO] == n ? 0 : 1;
+}
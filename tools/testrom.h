@@ -0,0 +1,51 @@
+#ifndef TESTROM_HEADER
+#define TESTROM_HEADER
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include "gb.h"
+
+/* shared by the headless tools: run a test ROM with no window or audio and tell
+how it ended. test ROMs report in one of three ways:
+- blargg: prints "Passed" or "Failed" over the serial port
+- mooneye: executes LD B,B when done, with the Fibonacci numbers 3 5 8 13 21 34
+  in B C D E H L on success (0x42 in all of them on failure)
+- everything else (dmg-acid2...): only draws a picture, compared by hash */
+
+#define TESTROM_DEFAULT_BOOT "./include/boot/bootix_dmg.bin"
+#define TESTROM_SERIAL_MAX 4096  // serial text kept for the verdict
+
+typedef enum test_detect_t {
+    DETECT_SERIAL,
+    DETECT_MOONEYE,
+    DETECT_HASH,  // runs the whole budget, the caller compares testrom_hash
+} test_detect_t;
+
+typedef enum test_result_t {
+    TEST_PASSED,
+    TEST_FAILED,
+    TEST_TIMEOUT,  // budget ran out without a verdict
+    TEST_LOOP,     // parked in a JR -2 loop without a verdict
+} test_result_t;
+
+typedef struct TestRom {
+    GB gb;
+    bool echo;  // copy serial output to stdout as it arrives
+
+    char serial[TESTROM_SERIAL_MAX + 1];  // everything sent so far, NUL terminated
+    size_t serial_length;
+} TestRom;
+
+// reset, load both ROMs and hook up the serial port. exits on a missing ROM, like load_rom
+void testrom_init(TestRom *t, const char *boot_rom, const char *rom);
+void testrom_free(TestRom *t);
+
+// run for up to cycles T-cycles or until the ROM gives its verdict
+test_result_t testrom_run(TestRom *t, test_detect_t detect, uint64_t cycles);
+
+// FNV-1a over the framebuffer's shades, independent of palette and pixel format
+uint64_t testrom_hash(const TestRom *t);
+
+#endif